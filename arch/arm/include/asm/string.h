@@ -1,6 +1,18 @@
 #ifndef __ASM_ARM_STRING_H
 #define __ASM_ARM_STRING_H
 
+#ifdef CONFIG_MEMCPY_SELECT
+/*
+ * Copies of at least these sizes are handed by memcpy() to the medium
+ * and large variants picked at boot (see lib/memcpy_select.c).  They
+ * must be valid ARM immediates.
+ */
+#define MEMCPY_MEDIUM_MIN	256
+#define MEMCPY_LARGE_MIN	4096
+#endif
+
+#ifndef __ASSEMBLY__
+
 /*
  * We don't do inline string functions, since the
  * optimised inline asm versions are not small.
@@ -38,4 +50,6 @@ extern void __memzero(void *ptr, __kernel_size_t n);
 		(__p);							\
 	})
 
+#endif /* __ASSEMBLY__ */
+
 #endif
@@ -0,0 +1,38 @@
+/*
+ *  linux/arch/arm/lib/memcpy_variants.c
+ *
+ *  memcpy() implementations offered to the boot-time selection in
+ *  lib/memcpy_select.c.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/memcopy.h>
+
+extern void *__memcpy_ldm(void *, const void *, size_t);
+extern void *__memcpy_pld(void *, const void *, size_t);
+
+memcpy_fn_t *__memcpy_select[MEMCPY_NR_CLASSES] = {
+	[MEMCPY_MEDIUM]	= __memcpy_ldm,
+	[MEMCPY_LARGE]	= __memcpy_ldm,
+};
+
+/*
+ * HAVE_MEMCPY_SELECT is only selected for ARMv7, whose cores keep enough
+ * line fills in flight for the deep-preload copy to be worth trying.
+ */
+static struct memcpy_variant arm_memcpy_variants[] __initdata = {
+	{ "ldm",	__memcpy_ldm },
+	{ "pld",	__memcpy_pld },
+};
+
+const struct memcpy_variant * __init arch_memcpy_variants(int *nr)
+{
+	*nr = ARRAY_SIZE(arm_memcpy_variants);
+	return arm_memcpy_variants;
+}
@@ -33,6 +33,7 @@ struct driver_private {
 	struct klist_node knode_bus;
 	struct module_kobject *mkobj;
 	struct device_driver *driver;
+	atomic_t async_probes;	/* scheduled by driver_attach(), not done */
 };
 #define to_driver(obj) container_of(obj, struct driver_private, kobj)
 
@@ -110,6 +111,7 @@ extern int cpu_dev_init(void);
 
 extern int bus_add_device(struct device *dev);
 extern void bus_probe_device(struct device *dev);
+extern int device_attach_async(struct device *dev);
 extern void bus_remove_device(struct device *dev);
 
 extern int bus_add_driver(struct device_driver *drv);
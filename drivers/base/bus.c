@@ -511,6 +511,8 @@ void bus_probe_device(struct device *dev)
 	int ret;
 
 	if (bus && bus->p->drivers_autoprobe) {
+		if (dev->async_probe && !device_attach_async(dev))
+			return;
 		ret = device_attach(dev);
 		WARN_ON(ret < 0);
 	}
@@ -24,6 +24,8 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/init.h>
+#include <linux/slab.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -211,6 +213,68 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 	return ret;
 }
 
+/*
+ * At boot, the drivers and devices that ask for it, with drv->probe_async
+ * or dev->async_probe, are probed from the async threads: the initcall
+ * that registers the driver or the device goes on while a probe sleeps,
+ * waiting for the hardware to power up, and independent probes run in
+ * parallel.  do_initcalls() waits for them at the end of each initcall
+ * level, so the code of the next level finds the devices bound as it
+ * would with serial probing.  Once the system is running probes are
+ * synchronous again: loading a module binds its devices before returning.
+ *
+ * Such a probe must not depend on other devices than its parents having
+ * been probed, and must not call async_synchronize_full().
+ */
+static bool async_probe_enabled = true;
+
+static int __init noasyncprobe_setup(char *str)
+{
+	async_probe_enabled = false;
+	return 1;
+}
+__setup("noasyncprobe", noasyncprobe_setup);
+
+static bool probe_async_now(void)
+{
+	return async_probe_enabled && system_state == SYSTEM_BOOTING;
+}
+
+struct async_probe {
+	struct device_driver	*drv;
+	struct device		*dev;
+};
+
+/* scheduled and running, a probe can schedule more */
+static atomic_t async_probe_count = ATOMIC_INIT(0);
+
+static void async_probe_done(struct device *dev)
+{
+	put_device(dev);
+	if (atomic_dec_and_test(&async_probe_count))
+		wake_up(&probe_waitqueue);
+}
+
+/**
+ * wait_for_async_probes
+ * Wait for the probes started from async threads to be completed.
+ */
+void wait_for_async_probes(void)
+{
+	wait_event(probe_waitqueue, atomic_read(&async_probe_count) == 0);
+}
+
+/* initcall_debug timing, the initcalls don't include async probes */
+static void async_probe_report(struct device *dev, const char *drv_name,
+			       int ret, ktime_t calltime)
+{
+	ktime_t delta = ktime_sub(ktime_get(), calltime);
+
+	printk("async probe of %s by %s %s after %Ld usecs\n",
+	       dev_name(dev), drv_name, ret > 0 ? "bound" : "not bound",
+	       (unsigned long long)ktime_to_ns(delta) >> 10);
+}
+
 static int __device_attach(struct device_driver *drv, void *data)
 {
 	struct device *dev = data;
@@ -258,6 +322,88 @@ int device_attach(struct device *dev)
 }
 EXPORT_SYMBOL_GPL(device_attach);
 
+static void __device_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device *dev = data;
+	ktime_t calltime = { .tv64 = 0 };
+	int ret;
+
+	if (initcall_debug)
+		calltime = ktime_get();
+
+	if (dev->parent && dev->bus->need_parent_lock)
+		device_lock(dev->parent);
+	ret = device_attach(dev);
+	if (dev->parent && dev->bus->need_parent_lock)
+		device_unlock(dev->parent);
+
+	if (initcall_debug)
+		async_probe_report(dev, dev->driver ? dev->driver->name : "-",
+				   ret, calltime);
+	async_probe_done(dev);
+}
+
+/**
+ * device_attach_async - attach a device to a driver from an async thread.
+ * @dev: device.
+ *
+ * Returns 0 if the attach was scheduled, -EAGAIN if the device has to be
+ * attached synchronously: the system is past booting, or noasyncprobe.
+ */
+int device_attach_async(struct device *dev)
+{
+	if (!probe_async_now())
+		return -EAGAIN;
+
+	atomic_inc(&async_probe_count);
+	async_schedule(__device_attach_async, get_device(dev));
+	return 0;
+}
+
+static void __driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct async_probe *ap = data;
+	struct device_driver *drv = ap->drv;
+	struct device *dev = ap->dev;
+	ktime_t calltime = { .tv64 = 0 };
+	int ret = 0;
+
+	if (initcall_debug)
+		calltime = ktime_get();
+
+	if (dev->parent && dev->bus->need_parent_lock)
+		device_lock(dev->parent);
+	device_lock(dev);
+	if (!dev->driver)
+		ret = driver_probe_device(drv, dev);
+	device_unlock(dev);
+	if (dev->parent && dev->bus->need_parent_lock)
+		device_unlock(dev->parent);
+
+	if (initcall_debug)
+		async_probe_report(dev, drv->name, ret, calltime);
+	kfree(ap);
+	/* driver_detach() may free drv once this is 0 */
+	if (atomic_dec_and_test(&drv->p->async_probes))
+		wake_up(&probe_waitqueue);
+	async_probe_done(dev);
+}
+
+static int driver_attach_async(struct device_driver *drv, struct device *dev)
+{
+	struct async_probe *ap;
+
+	ap = kmalloc(sizeof(*ap), GFP_KERNEL);
+	if (!ap)
+		return -ENOMEM;
+	ap->drv = drv;
+	ap->dev = get_device(dev);
+	atomic_inc(&drv->p->async_probes);
+	atomic_inc(&async_probe_count);
+	async_schedule(__driver_attach_async, ap);
+	return 0;
+}
+
 static int __driver_attach(struct device *dev, void *data)
 {
 	struct device_driver *drv = data;
@@ -275,6 +421,16 @@ static int __driver_attach(struct device *dev, void *data)
 	if (!driver_match_device(drv, dev))
 		return 0;
 
+	/*
+	 * Never for the drivers of platform_driver_probe(), which have
+	 * suppress_bind_attrs set: it unregisters the driver if no device
+	 * is bound when driver_register() returns.
+	 */
+	if ((drv->probe_async || dev->async_probe) &&
+	    !drv->suppress_bind_attrs && probe_async_now() &&
+	    !driver_attach_async(drv, dev))
+		return 0;
+
 	if (dev->parent)	/* Needed for USB */
 		device_lock(dev->parent);
 	device_lock(dev);
@@ -295,6 +451,10 @@ static int __driver_attach(struct device *dev, void *data)
  * match the driver with each one.  If driver_probe_device()
  * returns 0 and the @dev->driver is set, we've found a
  * compatible pair.
+ *
+ * At boot, the devices are probed from async threads if @drv->probe_async
+ * or the device's async_probe is set, and may not be bound yet when this
+ * returns, unless @drv->suppress_bind_attrs is set.
  */
 int driver_attach(struct device_driver *drv)
 {
@@ -367,6 +527,15 @@ void driver_detach(struct device_driver *drv)
 	struct device_private *dev_prv;
 	struct device *dev;
 
+	/*
+	 * Let the async probes of this driver finish first: driver_attach()
+	 * schedules them for the devices with async_probe set too, whatever
+	 * the driver asked for, and they must not outlive the driver.  Only
+	 * its own, an async probe may unregister another driver.
+	 */
+	wait_event(probe_waitqueue,
+		   atomic_read(&drv->p->async_probes) == 0);
+
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
 		if (list_empty(&drv->p->klist_devices.k_list)) {
@@ -521,7 +521,11 @@ int __init_or_module platform_driver_probe(struct platform_driver *drv,
 {
 	int retval, code;
 
-	/* make sure driver won't have bind/unbind attributes */
+	/*
+	 * make sure driver won't have bind/unbind attributes, nor async
+	 * probes: the devices have to be bound when platform_driver_register
+	 * returns
+	 */
 	drv->driver.suppress_bind_attrs = true;
 
 	/* temporary section violation during probe() */
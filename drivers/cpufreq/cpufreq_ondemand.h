@@ -0,0 +1,95 @@
+/*
+ *  drivers/cpufreq/cpufreq_ondemand.h
+ *
+ *  Frequency selection of the ondemand governor for one sampling window.
+ *  It has no kernel dependencies so that tools/cpufreq/odreplay.c can
+ *  run the same code on recorded load traces.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _CPUFREQ_ONDEMAND_H
+#define _CPUFREQ_ONDEMAND_H
+
+/* Load averages are kept as percent << OD_LOAD_SHIFT. */
+#define OD_LOAD_SHIFT		10
+
+/*
+ * Fold the load of the last window (percent) into the moving average
+ * @avg.  The last window gets the weight 1/@windows, so the average
+ * covers about @windows windows; with @windows <= 1 it is just @load.
+ */
+static inline unsigned int od_load_avg(unsigned int avg, unsigned int load,
+				       unsigned int windows)
+{
+	unsigned int next = load << OD_LOAD_SHIFT;
+
+	if (windows <= 1)
+		return next;
+	if (next >= avg)
+		return avg + (next - avg) / windows;
+	return avg - (avg - next) / windows;
+}
+
+/* Load average @avg times frequency @freq, in the units of load_freq. */
+static inline unsigned int od_avg_load_freq(unsigned int avg,
+					    unsigned int freq)
+{
+	return ((unsigned long long)avg * freq) >> OD_LOAD_SHIFT;
+}
+
+enum { OD_HOLD, OD_UP, OD_DOWN };
+
+/*
+ * @load_freq is the load of the busiest CPU in the last window times
+ * its average frequency, @avg_load_freq the same from its load history.
+ *
+ * Going up only needs the last window to cross up_threshold, so the
+ * history never delays a ramp.  Going down also needs the history to
+ * fit the lower frequency without crossing up_threshold there, so a
+ * quiet window in a busy stretch does not drop the frequency only for
+ * the next window to raise it again.  The target of a decrease still
+ * comes from the last window, so that once the load has really gone the
+ * frequency drops in one step rather than down a staircase.  With a
+ * history of one window both loads are the same and the check always
+ * passes.
+ *
+ * Returns OD_UP for policy->max, OD_DOWN with the target in @freq_next,
+ * or OD_HOLD.
+ */
+static inline int od_next_freq(unsigned int load_freq,
+			       unsigned int avg_load_freq,
+			       unsigned int cur, unsigned int min,
+			       unsigned int up_threshold,
+			       unsigned int down_differential,
+			       unsigned int *freq_next)
+{
+	unsigned int down_threshold = up_threshold - down_differential;
+	unsigned int next;
+
+	if (load_freq > up_threshold * cur)
+		return OD_UP;
+
+	/* if we cannot reduce the frequency anymore, break out early */
+	if (cur == min)
+		return OD_HOLD;
+
+	/*
+	 * The optimal frequency is the frequency that is the lowest that
+	 * can support the current CPU usage without triggering the up
+	 * policy. To be safe, we focus 10 points under the threshold.
+	 */
+	if (load_freq >= down_threshold * cur)
+		return OD_HOLD;
+
+	next = load_freq / down_threshold;
+	if (avg_load_freq > up_threshold * (next > min ? next : min))
+		return OD_HOLD;
+
+	*freq_next = next;
+	return OD_DOWN;
+}
+
+#endif /* _CPUFREQ_ONDEMAND_H */
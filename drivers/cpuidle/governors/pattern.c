@@ -0,0 +1,193 @@
+/*
+ * pattern.c - the pattern idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos_params.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+
+#include "pattern.h"
+
+/*
+ * Concepts and ideas behind the pattern governor
+ *
+ * Like menu, the pattern governor picks the deepest state whose target
+ * residency fits the predicted idle duration and whose exit latency
+ * fits the pm_qos latency requirement.  It differs in how it predicts.
+ *
+ * The time to the next timer event is exact when the timer is what
+ * ends the idle period.  On a mostly idle system that is the common
+ * case, and the timer is then used unscaled.
+ *
+ * When interrupts keep ending idle periods early, the timer only gives
+ * an upper bound.  menu scales it by a running average of
+ * measured / expected per order of magnitude.  That fits a random
+ * interrupt load, but not a periodic device interrupt: an audio or
+ * display interrupt every couple of milliseconds, while the next timer
+ * is 100ms away, averages out to a factor that is right for neither.
+ * So the governor also keeps the last few idle durations and, when
+ * they repeat (small standard deviation once outliers are dropped),
+ * predicts their average instead if that is shorter.
+ *
+ * On Tegra the difference matters most between LP3, which costs nothing
+ * to leave, and LP2, which power gates the CPU and takes milliseconds to
+ * come back from: an LP2 entry that is cut short both wastes the energy
+ * of the power gate cycle and adds its exit latency to the interrupt
+ * that woke us.
+ */
+
+struct pattern_cpu {
+	int			last_state_idx;
+	int			needs_update;
+	struct pattern_device	data;
+};
+
+static DEFINE_PER_CPU(struct pattern_cpu, pattern_cpus);
+
+static void pattern_reflect_update(struct cpuidle_device *dev);
+
+/**
+ * pattern_select - selects the next idle state to enter
+ * @dev: the CPU
+ */
+static int pattern_select(struct cpuidle_device *dev)
+{
+	struct pattern_cpu *pc = &__get_cpu_var(pattern_cpus);
+	struct pattern_device *data = &pc->data;
+	int latency_req = pm_qos_requirement(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int predicted_us;
+	struct timespec t;
+	int i, idx;
+
+	if (pc->needs_update) {
+		pattern_reflect_update(dev);
+		pc->needs_update = 0;
+	}
+
+	idx = 0;
+	data->exit_us = 0;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0))
+		goto out;
+
+	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	if (t.tv_sec >= PATTERN_MAX_US / USEC_PER_SEC)
+		predicted_us = pattern_predict(data, PATTERN_MAX_US,
+					       nr_iowait_cpu());
+	else
+		predicted_us = pattern_predict(data,
+				t.tv_sec * USEC_PER_SEC +
+				t.tv_nsec / NSEC_PER_USEC, nr_iowait_cpu());
+
+	/*
+	 * We want to default to C1 (hlt), not to busy polling
+	 * unless the timer is happening really really soon.
+	 */
+	if (data->expected_us > 5)
+		idx = CPUIDLE_DRIVER_STATE_START;
+
+	/* find the deepest idle state that satisfies our constraints */
+	for (i = CPUIDLE_DRIVER_STATE_START; i < dev->state_count; i++) {
+		struct cpuidle_state *s = &dev->states[i];
+
+		if (s->target_residency > predicted_us)
+			break;
+		if (s->exit_latency > latency_req)
+			break;
+		/* don't make the wakeup wait longer than we slept */
+		if (s->exit_latency > predicted_us)
+			break;
+		data->exit_us = s->exit_latency;
+		idx = i;
+	}
+
+out:
+	pc->last_state_idx = idx;
+	return idx;
+}
+
+/**
+ * pattern_reflect - records that data structures need update
+ * @dev: the CPU
+ *
+ * NOTE: it's important to be fast here because this operation will add to
+ *       the overall exit latency.
+ */
+static void pattern_reflect(struct cpuidle_device *dev)
+{
+	__get_cpu_var(pattern_cpus).needs_update = 1;
+}
+
+/**
+ * pattern_reflect_update - folds the last idle period into the history
+ * @dev: the CPU
+ */
+static void pattern_reflect_update(struct cpuidle_device *dev)
+{
+	struct pattern_cpu *pc = &__get_cpu_var(pattern_cpus);
+	struct pattern_device *data = &pc->data;
+	struct cpuidle_state *target = &dev->states[pc->last_state_idx];
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+
+	/*
+	 * This idle state doesn't support residency measurements, so
+	 * assume we slept for the whole expected time.
+	 */
+	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID)))
+		measured_us = data->expected_us;
+
+	pattern_update(data, measured_us);
+}
+
+/**
+ * pattern_enable_device - scans a CPU's states and does setup
+ * @dev: the CPU
+ */
+static int pattern_enable_device(struct cpuidle_device *dev)
+{
+	struct pattern_cpu *pc = &per_cpu(pattern_cpus, dev->cpu);
+
+	pc->last_state_idx = 0;
+	pc->needs_update = 0;
+	pattern_init(&pc->data);
+
+	return 0;
+}
+
+static struct cpuidle_governor pattern_governor = {
+	.name =		"pattern",
+	.rating =	30,
+	.enable =	pattern_enable_device,
+	.select =	pattern_select,
+	.reflect =	pattern_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_pattern - initializes the governor
+ */
+static int __init init_pattern(void)
+{
+	return cpuidle_register_governor(&pattern_governor);
+}
+
+/**
+ * exit_pattern - exits the governor
+ */
+static void __exit exit_pattern(void)
+{
+	cpuidle_unregister_governor(&pattern_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_pattern);
+module_exit(exit_pattern);
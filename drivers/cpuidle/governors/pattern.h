@@ -0,0 +1,240 @@
+/*
+ * pattern.h - idle duration prediction of the pattern idle governor
+ *
+ * This is the part of pattern.c that does not depend on the rest of
+ * the kernel, so that tools/cpuidle/idlesim.c can drive it with a
+ * simulated cpuidle driver.  All times are in microseconds.
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#ifndef _CPUIDLE_PATTERN_H
+#define _CPUIDLE_PATTERN_H
+
+#define PATTERN_BUCKETS		12
+#define PATTERN_INTERVALS	8
+#define PATTERN_RESOLUTION	1024
+#define PATTERN_DECAY		8
+#define PATTERN_MAX_INTERESTING	50000
+/* Longer predictions make no difference to the choice of state. */
+#define PATTERN_MAX_US		(1U << 20)
+#define PATTERN_NONE		(~0U)
+
+struct pattern_device {
+	unsigned int	expected_us;	/* until the next timer event */
+	unsigned int	predicted_us;
+	unsigned int	exit_us;	/* exit latency of the chosen state */
+	unsigned int	bucket;
+
+	/*
+	 * Running averages, scaled by PATTERN_RESOLUTION * PATTERN_DECAY,
+	 * of measured / expected per bucket, and of how many wakeups came
+	 * before the timer, i.e. from an interrupt.
+	 */
+	unsigned int	correction_factor[PATTERN_BUCKETS];
+	unsigned int	early_wakeups;
+
+	unsigned int	intervals[PATTERN_INTERVALS];
+	unsigned int	interval_ptr;
+};
+
+/*
+ * Start out with no history: long intervals, unity correction factors
+ * and no early wakeups.
+ */
+static inline void pattern_init(struct pattern_device *data)
+{
+	unsigned int i;
+
+	for (i = 0; i < PATTERN_BUCKETS; i++)
+		data->correction_factor[i] = 0;
+	for (i = 0; i < PATTERN_INTERVALS; i++)
+		data->intervals[i] = PATTERN_MAX_US;
+	data->interval_ptr = 0;
+	data->early_wakeups = 0;
+	data->exit_us = 0;
+	data->expected_us = 0;
+	data->predicted_us = 0;
+	data->bucket = 0;
+}
+
+/*
+ * Like menu, keep separate statistics per order of magnitude of the
+ * time to the next timer, and for when IO is outstanding.
+ */
+static inline unsigned int pattern_bucket(unsigned int duration, int iowait)
+{
+	unsigned int bucket = iowait ? PATTERN_BUCKETS / 2 : 0;
+
+	if (duration < 10)
+		return bucket;
+	if (duration < 100)
+		return bucket + 1;
+	if (duration < 1000)
+		return bucket + 2;
+	if (duration < 10000)
+		return bucket + 3;
+	if (duration < 100000)
+		return bucket + 4;
+	return bucket + 5;
+}
+
+/*
+ * The time to the next timer event, scaled by how much of it we have
+ * been getting lately in this bucket.  Sets data->expected_us and
+ * data->bucket.
+ */
+static inline unsigned int pattern_correct(struct pattern_device *data,
+					   unsigned int expected_us,
+					   int iowait)
+{
+	unsigned int factor;
+
+	if (expected_us > PATTERN_MAX_US)
+		expected_us = PATTERN_MAX_US;
+	data->expected_us = expected_us;
+	data->bucket = pattern_bucket(expected_us, iowait);
+
+	/* start out with a unity factor */
+	factor = data->correction_factor[data->bucket];
+	if (factor == 0)
+		factor = PATTERN_RESOLUTION * PATTERN_DECAY;
+
+	/* expected_us < 2^20 and factor / DECAY <= 2^10: no overflow */
+	return (expected_us * (factor / PATTERN_DECAY) +
+		PATTERN_RESOLUTION / 2) / PATTERN_RESOLUTION;
+}
+
+/*
+ * Look for a repeating pattern in the last PATTERN_INTERVALS idle
+ * durations: if they are close together (standard deviation at most a
+ * sixth of the average, or under 20us), the average is a good guess of
+ * the next one.  Outliers are dropped one at a time, largest first, as
+ * long as three quarters of the samples are left.  A long interval
+ * cut short by an unrelated interrupt then doesn't hide a pattern.
+ *
+ * Works on the sums to avoid divisions: with n samples, sum s and sum
+ * of squares q, n^2 * variance = n * q - s^2.
+ */
+static inline unsigned int pattern_typical_interval(struct pattern_device *data)
+{
+	unsigned int thresh = PATTERN_NONE;
+	unsigned int i, n, max, value;
+	unsigned long long sum, sumsq, var;
+
+	for (;;) {
+		n = 0;
+		max = 0;
+		sum = 0;
+		sumsq = 0;
+		for (i = 0; i < PATTERN_INTERVALS; i++) {
+			value = data->intervals[i];
+			if (value > thresh)
+				continue;
+			n++;
+			sum += value;
+			sumsq += (unsigned long long)value * value;
+			if (value > max)
+				max = value;
+		}
+		if (!n)
+			return PATTERN_NONE;
+
+		var = n * sumsq - sum * sum;
+		if ((sum * sum > 36 * var &&
+		     n * 4 >= PATTERN_INTERVALS * 3) ||
+		    var <= 400ULL * n * n)
+			return (unsigned int)sum / n;
+
+		if (n * 4 <= PATTERN_INTERVALS * 3)
+			return PATTERN_NONE;
+		thresh = max - 1;
+	}
+}
+
+/*
+ * Predict the next idle duration and store it in data->predicted_us.
+ *
+ * Most wakeups coming from the timer means the time to the next timer
+ * is the best guess.  Otherwise interrupts wake us early: use the
+ * corrected estimate, or a repeating pattern of idle durations if it
+ * promises less, as a periodic interrupt does.
+ */
+static inline unsigned int pattern_predict(struct pattern_device *data,
+					   unsigned int expected_us,
+					   int iowait)
+{
+	unsigned int predicted, typical;
+
+	predicted = pattern_correct(data, expected_us, iowait);
+
+	if (data->early_wakeups < PATTERN_RESOLUTION * PATTERN_DECAY / 4) {
+		predicted = data->expected_us;
+	} else {
+		typical = pattern_typical_interval(data);
+		if (typical < predicted)
+			predicted = typical;
+	}
+
+	data->predicted_us = predicted;
+	return predicted;
+}
+
+/*
+ * Account for an idle period of @measured_us, ended by an exit
+ * latency of data->exit_us, that followed the last prediction.
+ */
+static inline void pattern_update(struct pattern_device *data,
+				  unsigned int measured_us)
+{
+	unsigned int factor, early;
+
+	/*
+	 * We correct for the exit latency; we are assuming here that the
+	 * exit latency happens after the event that we're interested in.
+	 */
+	if (measured_us > data->exit_us)
+		measured_us -= data->exit_us;
+	else
+		measured_us = 0;
+
+	/* update our correction ratio */
+	factor = data->correction_factor[data->bucket];
+	if (factor == 0)
+		factor = PATTERN_RESOLUTION * PATTERN_DECAY;
+	factor -= factor / PATTERN_DECAY;
+
+	if (data->expected_us > 0 && measured_us < data->expected_us &&
+	    measured_us < PATTERN_MAX_INTERESTING)
+		factor += PATTERN_RESOLUTION * measured_us / data->expected_us;
+	else
+		/*
+		 * we were idle so long that we count it as a perfect
+		 * prediction
+		 */
+		factor += PATTERN_RESOLUTION;
+
+	/*
+	 * We don't want 0 as factor; we always want at least
+	 * a tiny bit of estimated time.
+	 */
+	data->correction_factor[data->bucket] = factor ? factor : 1;
+
+	/*
+	 * A wakeup more than 1/8 short of the timer, and by more than the
+	 * timer slack, came from an interrupt.
+	 */
+	early = measured_us + data->expected_us / 8 + 50 < data->expected_us;
+	data->early_wakeups -= data->early_wakeups / PATTERN_DECAY;
+	if (early)
+		data->early_wakeups += PATTERN_RESOLUTION;
+
+	if (measured_us > PATTERN_MAX_US)
+		measured_us = PATTERN_MAX_US;
+	data->intervals[data->interval_ptr++] = measured_us;
+	if (data->interval_ptr >= PATTERN_INTERVALS)
+		data->interval_ptr = 0;
+}
+
+#endif /* _CPUIDLE_PATTERN_H */
@@ -737,6 +737,7 @@ static struct i2c_driver akm8975_driver = {
 	.id_table = akm8975_id,
 	.driver = {
 		.name = "akm8975",
+		.probe_async = true,
 	},
 };
 
@@ -1152,6 +1152,7 @@ static struct i2c_driver ld_isl29030_i2c_driver = {
 	.driver = {
 		.name = LD_ISL29030_NAME,
 		.owner = THIS_MODULE,
+		.probe_async = true,
 	},
 };
 
@@ -1830,7 +1830,7 @@ static struct mapped_device *alloc_dev(int minor)
 	add_disk(md->disk);
 	format_dev_t(md->name, MKDEV(_major, minor));
 
-	md->wq = create_singlethread_workqueue("kdmflush");
+	md->wq = create_singlethread_rescuer_workqueue("kdmflush");
 	if (!md->wq)
 		goto bad_thread;
 
@@ -1400,6 +1400,7 @@ MODULE_DEVICE_TABLE(i2c, kxtf9_id);
 static struct i2c_driver kxtf9_driver = {
 	.driver = {
 		   .name = NAME,
+		   .probe_async = true,
 		   },
 	.probe = kxtf9_probe,
 	.remove = __devexit_p(kxtf9_remove),
@@ -179,6 +179,9 @@ static char mv643xx_eth_driver_version[] = "1.4";
 #define DEFAULT_TX_QUEUE_SIZE	256
 #define SKB_DMA_REALIGN		((PAGE_SIZE - NET_SKB_PAD) % SMP_CACHE_BYTES)
 
+/* skbs allocated for rx refill, or freed on tx reclaim, at a time */
+#define SKB_BATCH		16
+
 
 /*
  * RX/TX descriptors.
@@ -404,7 +407,6 @@ struct mv643xx_eth_private {
 	u8 work_rx_refill;
 
 	int skb_size;
-	struct sk_buff_head rx_recycle;
 
 	/*
 	 * RX state.
@@ -649,22 +651,29 @@ err:
 static int rxq_refill(struct rx_queue *rxq, int budget)
 {
 	struct mv643xx_eth_private *mp = rxq_to_mp(rxq);
-	int refilled;
+	struct sk_buff *skbs[SKB_BATCH];
+	int refilled, allocated, used;
 
 	refilled = 0;
+	allocated = used = 0;
 	while (refilled < budget && rxq->rx_desc_count < rxq->rx_ring_size) {
 		struct sk_buff *skb;
 		int rx;
 		struct rx_desc *rx_desc;
 
-		skb = __skb_dequeue(&mp->rx_recycle);
-		if (skb == NULL)
-			skb = dev_alloc_skb(mp->skb_size);
-
-		if (skb == NULL) {
-			mp->oom = 1;
-			goto oom;
+		if (used == allocated) {
+			allocated = min(budget - refilled,
+					rxq->rx_ring_size - rxq->rx_desc_count);
+			allocated = min(allocated, SKB_BATCH);
+			allocated = netdev_alloc_skb_bulk(mp->dev, mp->skb_size,
+							  skbs, allocated);
+			used = 0;
+			if (!allocated) {
+				mp->oom = 1;
+				goto oom;
+			}
 		}
+		skb = skbs[used++];
 
 		if (SKB_DMA_REALIGN)
 			skb_reserve(skb, SKB_DMA_REALIGN);
@@ -921,11 +930,13 @@ static int txq_reclaim(struct tx_queue *txq, int budget, int force)
 {
 	struct mv643xx_eth_private *mp = txq_to_mp(txq);
 	struct netdev_queue *nq = netdev_get_tx_queue(mp->dev, txq->index);
-	int reclaimed;
+	struct sk_buff *skbs[SKB_BATCH];
+	int reclaimed, freed;
 
 	__netif_tx_lock(nq, smp_processor_id());
 
 	reclaimed = 0;
+	freed = 0;
 	while (reclaimed < budget && txq->tx_desc_count > 0) {
 		int tx_index;
 		struct tx_desc *desc;
@@ -967,17 +978,18 @@ static int txq_reclaim(struct tx_queue *txq, int budget, int force)
 		}
 
 		if (skb != NULL) {
-			if (skb_queue_len(&mp->rx_recycle) <
-					mp->rx_ring_size &&
-			    skb_recycle_check(skb, mp->skb_size))
-				__skb_queue_head(&mp->rx_recycle, skb);
-			else
-				dev_kfree_skb(skb);
+			skbs[freed++] = skb;
+			if (freed == SKB_BATCH) {
+				dev_kfree_skb_bulk(skbs, freed);
+				freed = 0;
+			}
 		}
 	}
 
 	__netif_tx_unlock(nq);
 
+	dev_kfree_skb_bulk(skbs, freed);
+
 	if (reclaimed < budget)
 		mp->work_tx &= ~(1 << txq->index);
 
@@ -2337,8 +2349,6 @@ static int mv643xx_eth_open(struct net_device *dev)
 
 	napi_enable(&mp->napi);
 
-	skb_queue_head_init(&mp->rx_recycle);
-
 	mp->int_mask = INT_EXT;
 
 	for (i = 0; i < mp->rxq_count; i++) {
@@ -2433,8 +2443,6 @@ static int mv643xx_eth_stop(struct net_device *dev)
 	mib_counters_update(mp);
 	del_timer_sync(&mp->mib_counters_timer);
 
-	skb_queue_purge(&mp->rx_recycle);
-
 	for (i = 0; i < mp->rxq_count; i++)
 		rxq_deinit(mp->rxq + i);
 	for (i = 0; i < mp->txq_count; i++)
@@ -48,11 +48,13 @@
  * 3) ep->lock (spinlock)
  *
  * The acquire order is the one listed above, from 1 to 3.
- * We need a spinlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
- * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
+ * The poll callback, that might be triggered from a wake_up() that in
+ * turn might be called from IRQ context, takes none of them: it chains
+ * the item on ep->pending with cmpxchg(), and the ready list is fed
+ * from there by whoever scans it.  A busy descriptor set doesn't have
+ * all its wakeups serialize on one lock that way.  ep->lock protects
+ * the ready list, it is only taken from process context.
+ * During the event transfer loop (from kernel to
  * user space) we could end up sleeping due a copy_to_user(), so
  * we need a lock that will allow us to sleep. This lock is a
  * mutex (ep->mtx). It is acquired during the event transfer loop,
@@ -88,7 +90,12 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLEXCLUSIVE | EPOLLONESHOT | EPOLLET)
+
+/* The only bits EPOLLEXCLUSIVE can be combined with */
+#define EP_EXCLUSIVE_OK_BITS (POLLIN | POLLOUT | POLLRDNORM | POLLWRNORM | \
+			      POLLRDBAND | POLLWRBAND | POLLERR | POLLHUP | \
+			      POLLRDHUP | POLLPRI | EPOLLET | EPOLLEXCLUSIVE)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -138,8 +145,8 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Link in the "struct eventpoll"->pending chain, EP_UNACTIVE_PTR
+	 * when the item is not on it.
 	 */
 	struct epitem *next;
 
@@ -168,7 +175,7 @@ struct epitem {
  * interface.
  */
 struct eventpoll {
-	/* Protect the this structure access */
+	/* Protects the ready list */
 	spinlock_t lock;
 
 	/*
@@ -192,11 +199,10 @@ struct eventpoll {
 	struct rb_root rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transfering ready events to userspace w/out
-	 * holding ->lock.
+	 * Items that had events, chained by the poll callback without any
+	 * lock and moved to the ready list by ep_splice_pending().
 	 */
-	struct epitem *ovflist;
+	struct epitem *pending;
 
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
@@ -453,6 +459,80 @@ static void ep_unregister_pollwait(struct eventpoll *ep, struct epitem *epi)
 	}
 }
 
+/*
+ * Chain an item that has events on ep->pending, unless it already is.
+ * Lockless: the item is claimed by moving its ->next off EP_UNACTIVE_PTR,
+ * then pushed.  Items only ever leave the chain all at once, in
+ * ep_splice_pending(), so the push can't suffer from ABA.
+ */
+static void ep_chain_pending(struct eventpoll *ep, struct epitem *epi)
+{
+	struct epitem *head;
+
+	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
+		return;
+
+	do {
+		head = ACCESS_ONCE(ep->pending);
+		epi->next = head;
+	} while (cmpxchg(&ep->pending, head, epi) != head);
+}
+
+/*
+ * Move the pending items to the tail of the ready list, in the order
+ * their events came in, skipping those that are already on it.
+ * Must be called with "mtx" and "lock" held.
+ */
+static void ep_splice_pending(struct eventpoll *ep)
+{
+	struct epitem *epi, *nepi, *head = NULL;
+
+	/* The chain is LIFO, reverse it */
+	for (epi = xchg(&ep->pending, NULL); epi; epi = nepi) {
+		nepi = epi->next;
+		epi->next = head;
+		head = epi;
+	}
+
+	for (epi = head; epi; epi = nepi) {
+		nepi = epi->next;
+		/* From here on, a new event chains the item again */
+		epi->next = EP_UNACTIVE_PTR;
+		if (!ep_is_linked(&epi->rdllink))
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+	}
+}
+
+/* Tells if there are events for epoll_wait() to look at, without locks */
+static inline int ep_events_available(struct eventpoll *ep)
+{
+	return !list_empty(&ep->rdllist) || ACCESS_ONCE(ep->pending);
+}
+
+/*
+ * Wake up one epoll_wait() caller, and the ->poll() waiters, after the
+ * caller made events available.  Returns nonzero if anyone was waiting.
+ * Not under "lock": the ->poll() wakeup can recurse into another
+ * epoll's poll callback.
+ */
+static int ep_wake_up(struct eventpoll *ep)
+{
+	int woken = 0;
+
+	/* Pairs with set_current_state() in ep_poll() */
+	smp_mb();
+	if (waitqueue_active(&ep->wq)) {
+		wake_up(&ep->wq);
+		woken = 1;
+	}
+	if (waitqueue_active(&ep->poll_wait)) {
+		ep_poll_safewake(&ep->poll_wait);
+		woken = 1;
+	}
+
+	return woken;
+}
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -471,9 +551,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 			      void *priv,
 			      int depth)
 {
-	int error, pwake = 0;
-	unsigned long flags;
-	struct epitem *epi, *nepi;
+	int error, wake = 0;
 	LIST_HEAD(txlist);
 
 	/*
@@ -484,68 +562,49 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 
 	/*
 	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * empty list. The poll callback never touches the ready list,
+	 * events happening while looping w/out locks are chained on
+	 * ep->pending, so the "sproc" callback can requeue items on
+	 * ep->rdllist in a lockless way.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
+	spin_lock(&ep->lock);
+	ep_splice_pending(ep);
 	list_splice_init(&ep->rdllist, &txlist);
-	ep->ovflist = NULL;
-	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock(&ep->lock);
 
 	/*
 	 * Now call the callback function.
 	 */
 	error = (*sproc)(ep, &txlist, priv);
 
-	spin_lock_irqsave(&ep->lock, flags);
+	spin_lock(&ep->lock);
 	/*
 	 * During the time we spent inside the "sproc" callback, some
-	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
-	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(&epi->rdllink))
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
+	 * other events might have been chained by the poll callback.
+	 * We insert them inside the main ready-list here; those that
+	 * the "txlist" still contains are left to the list_splice()
+	 * below.
 	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
+	ep_splice_pending(ep);
 
 	/*
 	 * Quickly re-inject items left on "txlist".
 	 */
 	list_splice(&txlist, &ep->rdllist);
 
-	if (!list_empty(&ep->rdllist)) {
-		/*
-		 * Wake up (if active) both the eventpoll wait list and
-		 * the ->poll() wait list (delayed after we release the lock).
-		 */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
-		if (waitqueue_active(&ep->poll_wait))
-			pwake++;
-	}
-	spin_unlock_irqrestore(&ep->lock, flags);
+	/*
+	 * Let another epoll_wait() caller (if any) pick up what is left,
+	 * once we release the locks.
+	 */
+	if (!list_empty(&ep->rdllist))
+		wake = 1;
+	spin_unlock(&ep->lock);
 
 	mutex_unlock(&ep->mtx);
 
 	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	if (wake)
+		ep_wake_up(ep);
 
 	return error;
 }
@@ -556,7 +615,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
@@ -577,10 +635,16 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
+	/*
+	 * With the poll hooks gone, the item can't be chained anymore; if
+	 * it is, flush the chain to the ready list, and unlink it there.
+	 */
+	spin_lock(&ep->lock);
+	if (epi->next != EP_UNACTIVE_PTR)
+		ep_splice_pending(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock(&ep->lock);
 
 	/* At this point it is safe to free the eventpoll item */
 	kmem_cache_free(epi_cache, epi);
@@ -761,7 +825,7 @@ static int ep_alloc(struct eventpoll **pep)
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT;
-	ep->ovflist = EP_UNACTIVE_PTR;
+	ep->pending = NULL;
 	ep->user = user;
 
 	*pep = ep;
@@ -806,24 +870,28 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  * This is the callback that is passed to the wait queue wakeup
  * machanism. It is called by the stored file descriptors when they
  * have events to report.
+ *
+ * For an EPOLLEXCLUSIVE item, whose wait queue entry is exclusive, the
+ * return value tells the wakeup whether it woke up someone: if not, it
+ * goes on to the next exclusive entry, likely another epoll instance.
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
-	unsigned long flags;
+	int ewake = 0;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
-
-	spin_lock_irqsave(&ep->lock, flags);
+	unsigned int events = ACCESS_ONCE(epi->event.events);
 
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
 	 * descriptor to be disabled. This condition is likely the effect of the
 	 * EPOLLONESHOT bit that disables the descriptor when an event is received,
-	 * until the next EPOLL_CTL_MOD will be issued.
+	 * until the next EPOLL_CTL_MOD will be issued.  The mask is read
+	 * without locks: ep_modify() polls the file after changing it, so
+	 * an event seen with the old mask is not lost.
 	 */
-	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+	if (!(events & ~EP_PRIVATE_BITS))
+		goto out;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -831,44 +899,27 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * callback. We need to be able to handle both cases here, hence the
 	 * test for "key" != NULL before the event match test.
 	 */
-	if (key && !((unsigned long) key & epi->event.events))
-		goto out_unlock;
+	if (key && !((unsigned long) key & events))
+		goto out;
 
 	/*
-	 * If we are trasfering events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happens during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * Chain the item for the next scan of the ready list, which may
+	 * be in progress: the item is then both on the chain and on the
+	 * scan's list, and the end of the scan sorts that out.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-		}
-		goto out_unlock;
-	}
-
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink))
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	ep_chain_pending(ep, epi);
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
-	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
+	ewake = ep_wake_up(ep);
 
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+out:
+	if (!(events & EPOLLEXCLUSIVE))
+		ewake = 1;
 
-	return 1;
+	return ewake;
 }
 
 /*
@@ -885,7 +936,10 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -919,8 +973,7 @@ static void ep_rbtree_insert(struct eventpoll *ep, struct epitem *epi)
 static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 		     struct file *tfile, int fd)
 {
-	int error, revents, pwake = 0;
-	unsigned long flags;
+	int error, revents, wake = 0;
 	struct epitem *epi;
 	struct ep_pqueue epq;
 
@@ -974,26 +1027,21 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	ep_rbtree_insert(ep, epi);
 
 	/* We have to drop the new item inside our item list to keep track of it */
-	spin_lock_irqsave(&ep->lock, flags);
+	spin_lock(&ep->lock);
 
 	/* If the file is already "ready" we drop it inside the ready list */
 	if ((revents & event->events) && !ep_is_linked(&epi->rdllink)) {
 		list_add_tail(&epi->rdllink, &ep->rdllist);
-
-		/* Notify waiting tasks that events are available */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
-		if (waitqueue_active(&ep->poll_wait))
-			pwake++;
+		wake = 1;
 	}
 
-	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock(&ep->lock);
 
 	atomic_inc(&ep->user->epoll_watches);
 
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	/* Notify waiting tasks that events are available */
+	if (wake)
+		ep_wake_up(ep);
 
 	return 0;
 
@@ -1002,14 +1050,14 @@ error_unregister:
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue, and chained the item.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
+	spin_lock(&ep->lock);
+	if (epi->next != EP_UNACTIVE_PTR)
+		ep_splice_pending(ep);
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock(&ep->lock);
 
 	kmem_cache_free(epi_cache, epi);
 
@@ -1022,16 +1070,18 @@ error_unregister:
  */
 static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_event *event)
 {
-	int pwake = 0;
+	int wake = 0;
 	unsigned int revents;
 
 	/*
 	 * Set the new event interest mask before calling f_op->poll();
 	 * otherwise we might miss an event that happens between the
-	 * f_op->poll() call and the new event set registering.
+	 * f_op->poll() call and the new event set registering.  The poll
+	 * callback reads the mask without locks, hence the barrier.
 	 */
 	epi->event.events = event->events;
 	epi->event.data = event->data; /* protected by mtx */
+	smp_mb();
 
 	/*
 	 * Get current event bits. We can safely use the file* here because
@@ -1044,22 +1094,17 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 * list, push it inside.
 	 */
 	if (revents & event->events) {
-		spin_lock_irq(&ep->lock);
+		spin_lock(&ep->lock);
 		if (!ep_is_linked(&epi->rdllink)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
-
-			/* Notify waiting tasks that events are available */
-			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
-			if (waitqueue_active(&ep->poll_wait))
-				pwake++;
+			wake = 1;
 		}
-		spin_unlock_irq(&ep->lock);
+		spin_unlock(&ep->lock);
 	}
 
-	/* We have to call this outside the lock */
-	if (pwake)
-		ep_poll_safewake(&ep->poll_wait);
+	/* Notify waiting tasks that events are available */
+	if (wake)
+		ep_wake_up(ep);
 
 	return 0;
 }
@@ -1113,7 +1158,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * poll callback chains them on ep->pending.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
 			}
@@ -1138,7 +1183,6 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		   int maxevents, long timeout)
 {
 	int res, eavail;
-	unsigned long flags;
 	long jtimeout;
 	wait_queue_t wait;
 
@@ -1151,17 +1195,15 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		MAX_SCHEDULE_TIMEOUT : (timeout * HZ + 999) / 1000;
 
 retry:
-	spin_lock_irqsave(&ep->lock, flags);
-
 	res = 0;
-	if (list_empty(&ep->rdllist)) {
+	if (!ep_events_available(ep)) {
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
 		 * ep_poll_callback() when events will become available.
 		 */
 		init_waitqueue_entry(&wait, current);
-		__add_wait_queue_exclusive(&ep->wq, &wait);
+		add_wait_queue_exclusive(&ep->wq, &wait);
 
 		for (;;) {
 			/*
@@ -1170,25 +1212,21 @@ retry:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (!list_empty(&ep->rdllist) || !jtimeout)
+			if (ep_events_available(ep) || !jtimeout)
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
 				break;
 			}
 
-			spin_unlock_irqrestore(&ep->lock, flags);
 			jtimeout = schedule_timeout(jtimeout);
-			spin_lock_irqsave(&ep->lock, flags);
 		}
-		__remove_wait_queue(&ep->wq, &wait);
+		remove_wait_queue(&ep->wq, &wait);
 
 		set_current_state(TASK_RUNNING);
 	}
 	/* Is it worth to try to dig for events ? */
-	eavail = !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
-
-	spin_unlock_irqrestore(&ep->lock, flags);
+	eavail = ep_events_available(ep);
 
 	/*
 	 * Try to transfer events to user space. In case we get 0 events and
@@ -1342,6 +1380,20 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (file == tfile || !is_file_epoll(file))
 		goto error_tgt_fput;
 
+	/*
+	 * EPOLLEXCLUSIVE is set once and for all when the item is added,
+	 * with the wait queue entry: not on epoll files, whose wakeups
+	 * can't tell whether they woke anyone, and not with EPOLLONESHOT,
+	 * which would disable the one instance that was woken.
+	 */
+	if (ep_op_has_event(op) && (epds.events & EPOLLEXCLUSIVE)) {
+		if (op == EPOLL_CTL_MOD)
+			goto error_tgt_fput;
+		if (is_file_epoll(tfile) ||
+		    (epds.events & ~EP_EXCLUSIVE_OK_BITS))
+			goto error_tgt_fput;
+	}
+
 	/*
 	 * At this point it is safe to assume that the "private_data" contains
 	 * our own data structure.
@@ -1393,8 +1445,10 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 		break;
 	case EPOLL_CTL_MOD:
 		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
+			if (!(epi->event.events & EPOLLEXCLUSIVE)) {
+				epds.events |= POLLERR | POLLHUP;
+				error = ep_modify(ep, epi, &epds);
+			}
 		} else
 			error = -ENOENT;
 		break;
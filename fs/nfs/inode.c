@@ -1459,7 +1459,7 @@ static int nfsiod_start(void)
 {
 	struct workqueue_struct *wq;
 	dprintk("RPC:       creating workqueue nfsiod\n");
-	wq = create_singlethread_workqueue("nfsiod");
+	wq = create_singlethread_rescuer_workqueue("nfsiod");
 	if (wq == NULL)
 		return -ENOMEM;
 	nfsiod_workqueue = wq;
@@ -8,6 +8,7 @@
 #include <linux/mempolicy.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/ksm.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -324,6 +325,7 @@ struct mem_size_stats {
 	unsigned long private_dirty;
 	unsigned long referenced;
 	unsigned long swap;
+	unsigned long ksm;
 	u64 pss;
 };
 
@@ -358,6 +360,8 @@ static int smaps_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
 		/* Accumulate the size in pages that have been accessed. */
 		if (pte_young(ptent) || PageReferenced(page))
 			mss->referenced += PAGE_SIZE;
+		if (PageKsm(page))
+			mss->ksm += PAGE_SIZE;
 		mapcount = page_mapcount(page);
 		if (mapcount >= 2) {
 			if (pte_dirty(ptent))
@@ -421,6 +425,14 @@ static int show_smap(struct seq_file *m, void *v)
 		   mss.swap >> 10,
 		   vma_kernel_pagesize(vma) >> 10,
 		   vma_mmu_pagesize(vma) >> 10);
+#ifdef CONFIG_KSM
+	seq_printf(m, "KSM:            %8lu kB\n", mss.ksm >> 10);
+	if (vma->vm_flags & VM_MERGEABLE)
+		seq_printf(m,
+			   "KSM_Merged:     %8lu\n"
+			   "KSM_Skip:       %8u\n",
+			   vma->ksm_merged, vma->ksm_skip);
+#endif
 
 	if (m->count < m->size)  /* vma is copied successfully */
 		m->version = (vma != get_gate_vma(task)) ? vma->vm_start : 0;
@@ -581,21 +581,30 @@
 #define INITCALLS							\
 	*(.initcallearly.init)						\
 	VMLINUX_SYMBOL(__early_initcall_end) = .;			\
+	VMLINUX_SYMBOL(__initcall0_start) = .;				\
   	*(.initcall0.init)						\
   	*(.initcall0s.init)						\
+	VMLINUX_SYMBOL(__initcall1_start) = .;				\
   	*(.initcall1.init)						\
   	*(.initcall1s.init)						\
+	VMLINUX_SYMBOL(__initcall2_start) = .;				\
   	*(.initcall2.init)						\
   	*(.initcall2s.init)						\
+	VMLINUX_SYMBOL(__initcall3_start) = .;				\
   	*(.initcall3.init)						\
   	*(.initcall3s.init)						\
+	VMLINUX_SYMBOL(__initcall4_start) = .;				\
   	*(.initcall4.init)						\
   	*(.initcall4s.init)						\
+	VMLINUX_SYMBOL(__initcall5_start) = .;				\
   	*(.initcall5.init)						\
   	*(.initcall5s.init)						\
+	VMLINUX_SYMBOL(__initcallrootfs_start) = .;			\
 	*(.initcallrootfs.init)						\
+	VMLINUX_SYMBOL(__initcall6_start) = .;				\
   	*(.initcall6.init)						\
   	*(.initcall6s.init)						\
+	VMLINUX_SYMBOL(__initcall7_start) = .;				\
   	*(.initcall7.init)						\
   	*(.initcall7s.init)
 
@@ -65,6 +65,8 @@ struct bus_type {
 
 	const struct dev_pm_ops *pm;
 
+	bool need_parent_lock;	/* probe with the parent locked (USB) */
+
 	struct bus_type_private *p;
 };
 
@@ -126,7 +128,9 @@ struct device_driver {
 	struct module		*owner;
 	const char		*mod_name;	/* used for built-in modules */
 
-	bool suppress_bind_attrs;	/* disables bind/unbind via sysfs */
+	bool suppress_bind_attrs;	/* disables bind/unbind via sysfs,
+					   and async probes */
+	bool probe_async;		/* may probe from async threads at boot */
 
 	int (*probe) (struct device *dev);
 	int (*remove) (struct device *dev);
@@ -150,6 +154,7 @@ extern struct device_driver *driver_find(const char *name,
 					 struct bus_type *bus);
 extern int driver_probe_done(void);
 extern void wait_for_device_probe(void);
+extern void wait_for_async_probes(void);
 
 
 /* sysfs interface for exporting driver attributes */
@@ -394,6 +399,8 @@ struct device {
 					   device */
 	void		*platform_data;	/* Platform specific data, device
 					   core doesn't touch it */
+	bool		async_probe;	/* may probe from async threads at
+					   boot, see driver_attach() */
 	struct dev_pm_info	power;
 
 #ifdef CONFIG_NUMA
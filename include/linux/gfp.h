@@ -276,6 +276,21 @@ __alloc_pages(gfp_t gfp_mask, unsigned int order,
 	return __alloc_pages_nodemask(gfp_mask, order, zonelist, NULL);
 }
 
+unsigned long __alloc_pages_bulk_nodemask(gfp_t gfp_mask,
+			unsigned long nr_pages, struct zonelist *zonelist,
+			nodemask_t *nodemask, struct list_head *list);
+
+/*
+ * Allocate up to @nr_pages order-0 pages from the local node onto @list,
+ * returns how many.  Unlike alloc_pages(), ignores the task's mempolicy.
+ */
+static inline unsigned long alloc_pages_bulk(gfp_t gfp_mask,
+			unsigned long nr_pages, struct list_head *list)
+{
+	return __alloc_pages_bulk_nodemask(gfp_mask, nr_pages,
+			node_zonelist(numa_node_id(), gfp_mask), NULL, list);
+}
+
 static inline struct page *alloc_pages_node(int nid, gfp_t gfp_mask,
 						unsigned int order)
 {
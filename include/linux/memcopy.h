@@ -223,4 +223,28 @@ static __always_inline void mem_copy_bwd(unsigned long dstp,
 } 
 #endif 
  
+#ifdef CONFIG_MEMCPY_SELECT
+typedef void *(memcpy_fn_t)(void *, const void *, size_t);
+
+struct memcpy_variant {
+	const char	*name;
+	memcpy_fn_t	*copy;
+};
+
+/*
+ * memcpy() jumps through __memcpy_select[] for copies of at least
+ * MEMCPY_MEDIUM_MIN and MEMCPY_LARGE_MIN bytes (see <asm/string.h>);
+ * lib/memcpy_select.c fills it in at boot.
+ */
+enum {
+	MEMCPY_MEDIUM,
+	MEMCPY_LARGE,
+	MEMCPY_NR_CLASSES,
+};
+
+extern memcpy_fn_t *__memcpy_select[MEMCPY_NR_CLASSES];
+extern const struct memcpy_variant *arch_memcpy_variants(int *nr);
+extern void *memcpy_wordcopy(void *dest, const void *src, size_t count);
+#endif
+
 #endif 
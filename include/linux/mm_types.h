@@ -21,6 +21,7 @@
 #define AT_VECTOR_SIZE (2*(AT_VECTOR_SIZE_ARCH + AT_VECTOR_SIZE_BASE + 1))
 
 struct address_space;
+struct futex_hash_bucket;
 
 #define USE_SPLIT_PTLOCKS	(NR_CPUS >= CONFIG_SPLIT_PTLOCK_CPUS)
 
@@ -180,6 +181,17 @@ struct vm_area_struct {
 	void * vm_private_data;		/* was vm_pte (shared mem) */
 	unsigned long vm_truncate_count;/* truncate_count or restart_addr */
 
+#ifdef CONFIG_SWAP
+	/* last swap fault address, readahead window and hits, see swap_state.c */
+	atomic_long_t swap_readahead_info;
+#endif
+#ifdef CONFIG_KSM
+	/* ksmd's merge history and scan back-off for this area, see ksm.c */
+	unsigned long ksm_merged;	/* pages merged here by ksmd */
+	unsigned long ksm_merged_seen;	/* ksm_merged when last scanned */
+	unsigned short ksm_idle;	/* scans in a row that merged nothing */
+	unsigned short ksm_skip;	/* scans still to skip */
+#endif
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
 #endif
@@ -287,6 +299,16 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_KSM
+	/* protected by ksm_thread_mutex, see ksm.c */
+	unsigned long ksm_rmap_items;	/* pages ksmd is tracking */
+	unsigned long ksm_merging_pages;	/* of those, mapping ksm pages */
+#endif
+#ifdef CONFIG_FUTEX
+	/* hash table of the private futexes, NULL to use the global one */
+	struct futex_hash_bucket *futex_hash;
+	unsigned int futex_hashmask;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -186,6 +186,8 @@ struct netif_rx_stats
 	unsigned time_squeeze;
 	unsigned cpu_collision;
 	unsigned received_rps;
+	unsigned skb_recycled;	/* freed skbs kept for receive */
+	unsigned skb_reused;	/* receive skbs taken from those */
 };
 
 DECLARE_PER_CPU(struct netif_rx_stats, netdev_rx_stat);
@@ -1246,6 +1248,8 @@ struct softnet_data
 	struct Qdisc		*output_queue;
 	struct list_head	poll_list;
 	struct sk_buff		*completion_queue;
+	/* packets taken off input_pkt_queue in one go by process_backlog */
+	struct sk_buff_head	process_queue;
 
 	/* Elements below can be accessed between CPUs for RPS */
 	struct call_single_data	csd ____cacheline_aligned_in_smp;
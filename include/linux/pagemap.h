@@ -218,6 +218,24 @@ static inline struct page *page_cache_alloc_cold(struct address_space *x)
 	return __page_cache_alloc(mapping_gfp_mask(x)|__GFP_COLD);
 }
 
+#ifdef CONFIG_NUMA
+extern unsigned long __page_cache_alloc_bulk(gfp_t gfp, unsigned long nr,
+					     struct list_head *list);
+#else
+static inline unsigned long __page_cache_alloc_bulk(gfp_t gfp,
+				unsigned long nr, struct list_head *list)
+{
+	return alloc_pages_bulk(gfp, nr, list);
+}
+#endif
+
+/* Allocates up to @nr pages onto @list, returns how many it got */
+static inline unsigned long page_cache_alloc_cold_bulk(
+		struct address_space *x, unsigned long nr, struct list_head *list)
+{
+	return __page_cache_alloc_bulk(mapping_gfp_mask(x)|__GFP_COLD, nr, list);
+}
+
 typedef int filler_t(void *, struct page *);
 
 extern struct page * find_get_page(struct address_space *mapping,
@@ -433,6 +451,8 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 				pgoff_t index, gfp_t gfp_mask);
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t index, gfp_t gfp_mask);
+unsigned add_to_page_cache_lru_batch(struct page **pages, unsigned nr,
+				struct address_space *mapping, gfp_t gfp_mask);
 extern void remove_from_page_cache(struct page *page);
 extern void __remove_from_page_cache(struct page *page);
 
@@ -534,6 +534,9 @@ extern int	       skb_cow_data(struct sk_buff *skb, int tailbits,
 extern int	       skb_pad(struct sk_buff *skb, int pad);
 #define dev_kfree_skb(a)	consume_skb(a)
 #define dev_consume_skb(a)	kfree_skb_clean(a)
+extern void	      dev_kfree_skb_recycle(struct sk_buff *skb);
+extern void	      dev_kfree_skb_bulk(struct sk_buff **skbs,
+					 unsigned int n);
 extern void	      skb_over_panic(struct sk_buff *skb, int len,
 				     void *here);
 extern void	      skb_under_panic(struct sk_buff *skb, int len,
@@ -1544,6 +1547,27 @@ static inline struct sk_buff *netdev_alloc_skb(struct net_device *dev,
 	return __netdev_alloc_skb(dev, length, GFP_ATOMIC);
 }
 
+extern unsigned int __netdev_alloc_skb_bulk(struct net_device *dev,
+		unsigned int length, gfp_t gfp_mask,
+		struct sk_buff **skbs, unsigned int n);
+
+/**
+ *	netdev_alloc_skb_bulk - allocate skbuffs for rx on a specific device
+ *	@dev: network device to receive on
+ *	@length: length to allocate for each
+ *	@skbs: array to store the skbuffs in
+ *	@n: number of skbuffs wanted
+ *
+ *	Like netdev_alloc_skb() @n times, with the per-CPU recycled skbs
+ *	taken in one go.  Returns the number of skbuffs allocated, fewer
+ *	than @n if there is no free memory.
+ */
+static inline unsigned int netdev_alloc_skb_bulk(struct net_device *dev,
+		unsigned int length, struct sk_buff **skbs, unsigned int n)
+{
+	return __netdev_alloc_skb_bulk(dev, length, GFP_ATOMIC, skbs, n);
+}
+
 extern struct page *__netdev_alloc_page(struct net_device *dev, gfp_t gfp_mask);
 
 /**
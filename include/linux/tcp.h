@@ -96,6 +96,7 @@ enum {
 #define TCP_QUICKACK		12	/* Block/reenable quick acks */
 #define TCP_CONGESTION		13	/* Congestion control algorithm */
 #define TCP_MD5SIG		14	/* TCP MD5 Signature (RFC2385) */
+#define TCP_FASTOPEN		23	/* Enable fast open on listeners */
 
 #define TCPI_OPT_TIMESTAMPS	1
 #define TCPI_OPT_SACK		2
@@ -237,6 +238,13 @@ struct tcp_request_sock {
 #endif
 	u32			 	rcv_isn;
 	u32			 	snt_isn;
+	u32				rcv_nxt;	/* what the SYN-ACK acks: past
+							 * the data of a fast open SYN
+							 */
+	u8				fastopen_cookie_req; /* SYN-ACK gives a
+							      * fast open cookie
+							      */
+	struct sock			*listener;	/* of a fast open child */
 };
 
 static inline struct tcp_request_sock *tcp_rsk(const struct request_sock *req)
@@ -379,6 +387,16 @@ struct tcp_sock {
 
 	int			linger2;
 
+/* TCP fast open */
+	struct tcp_fastopen_request *fastopen_req; /* connecting from sendmsg() */
+	struct request_sock *fastopen_rsk; /* passive fast open child, until
+					    * its SYN-ACK is acked
+					    */
+	u8	syn_fastopen : 1,	/* SYN had the fast open option */
+		syn_data : 1;		/* SYN had data */
+	u16	fastopen_max_qlen;	/* listener: pending children, 0 is off */
+	atomic_t fastopen_qlen;		/* listener: children with fastopen_rsk */
+
 /* Receiver side RTT estimation */
 	struct {
 		u32	rtt;
@@ -0,0 +1,59 @@
+#ifndef __LINUX_VMPRESSURE_H
+#define __LINUX_VMPRESSURE_H
+
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+#include <linux/gfp.h>
+#include <linux/types.h>
+#include <linux/cgroup.h>
+
+struct vmpressure {
+	/* pages scanned and reclaimed in the current window */
+	unsigned long scanned;
+	unsigned long reclaimed;
+	/* keeps scanned and reclaimed in sync */
+	spinlock_t sr_lock;
+
+	/* the registered vmpressure_events, under events_lock */
+	struct list_head events;
+	struct mutex events_lock;
+
+	struct work_struct work;
+};
+
+struct mem_cgroup;
+
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+extern void vmpressure(gfp_t gfp, struct mem_cgroup *mem,
+		       unsigned long scanned, unsigned long reclaimed);
+extern void vmpressure_prio(gfp_t gfp, struct mem_cgroup *mem, int prio);
+
+extern void vmpressure_init(struct vmpressure *vmpr);
+extern void vmpressure_cleanup(struct vmpressure *vmpr);
+
+/* provided by the memory controller */
+extern struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *mem);
+extern struct vmpressure *cgroup_to_vmpressure(struct cgroup *cgrp);
+extern struct vmpressure *vmpressure_parent(struct vmpressure *vmpr);
+
+extern int vmpressure_register_event(struct cgroup *cgrp, struct cftype *cft,
+				     struct eventfd_ctx *eventfd,
+				     const char *args);
+extern int vmpressure_unregister_event(struct cgroup *cgrp,
+				       struct cftype *cft,
+				       struct eventfd_ctx *eventfd);
+#else
+static inline void vmpressure(gfp_t gfp, struct mem_cgroup *mem,
+			      unsigned long scanned, unsigned long reclaimed)
+{
+}
+
+static inline void vmpressure_prio(gfp_t gfp, struct mem_cgroup *mem,
+				   int prio)
+{
+}
+#endif /* CONFIG_CGROUP_MEM_RES_CTLR */
+
+#endif /* __LINUX_VMPRESSURE_H */
@@ -25,10 +25,18 @@ typedef void (*work_func_t)(struct work_struct *work);
 struct work_struct {
 	atomic_long_t data;
 #define WORK_STRUCT_PENDING 0		/* T if work item pending execution */
-#define WORK_STRUCT_FLAG_MASK (3UL)
+#define WORK_STRUCT_DELAYED 1		/* T if waiting for an active slot */
+#define WORK_STRUCT_LINKED 2		/* T if the next work is linked */
+#define WORK_STRUCT_COLOR_SHIFT 3	/* flush color, see flush_workqueue() */
+#define WORK_STRUCT_COLOR_BITS 2
+#define WORK_STRUCT_FLAG_BITS (WORK_STRUCT_COLOR_SHIFT + WORK_STRUCT_COLOR_BITS)
+#define WORK_STRUCT_FLAG_MASK ((1UL << WORK_STRUCT_FLAG_BITS) - 1)
 #define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
 	struct list_head entry;
 	work_func_t func;
+#ifdef CONFIG_WORKQUEUE_TRACER
+	u64 queued_at;			/* for the queue-to-execute latency */
+#endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
@@ -166,11 +174,11 @@ struct execute_work {
 
 extern struct workqueue_struct *
 __create_workqueue_key(const char *name, int singlethread,
-		       int freezeable, int rt, struct lock_class_key *key,
-		       const char *lock_name);
+		       int freezeable, int rt, int rescuer,
+		       struct lock_class_key *key, const char *lock_name);
 
 #ifdef CONFIG_LOCKDEP
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define __create_workqueue(name, singlethread, freezeable, rt, rescuer) \
 ({								\
 	static struct lock_class_key __key;			\
 	const char *__lock_name;				\
@@ -181,19 +189,30 @@ __create_workqueue_key(const char *name, int singlethread,
 		__lock_name = #name;				\
 								\
 	__create_workqueue_key((name), (singlethread),		\
-			       (freezeable), (rt), &__key,	\
-			       __lock_name);			\
+			       (freezeable), (rt), (rescuer),	\
+			       &__key, __lock_name);		\
 })
 #else
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define __create_workqueue(name, singlethread, freezeable, rt, rescuer) \
 	__create_workqueue_key((name), (singlethread), (freezeable), (rt), \
-			       NULL, NULL)
+			       (rescuer), NULL, NULL)
 #endif
 
-#define create_workqueue(name) __create_workqueue((name), 0, 0, 0)
-#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1)
-#define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
-#define create_singlethread_workqueue(name) __create_workqueue((name), 1, 0, 0)
+#define create_workqueue(name) __create_workqueue((name), 0, 0, 0, 0)
+#define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1, 0)
+#define create_freezeable_workqueue(name) \
+	__create_workqueue((name), 1, 1, 0, 0)
+#define create_singlethread_workqueue(name) \
+	__create_workqueue((name), 1, 0, 0, 0)
+
+/*
+ * Workqueues that memory reclaim may wait on, such as those completing
+ * block I/O, need a rescuer thread to run their work items when no
+ * worker can be created.
+ */
+#define create_rescuer_workqueue(name) __create_workqueue((name), 0, 0, 0, 1)
+#define create_singlethread_rescuer_workqueue(name) \
+	__create_workqueue((name), 1, 0, 0, 1)
 
 extern void destroy_workqueue(struct workqueue_struct *wq);
 
@@ -221,6 +240,12 @@ extern int keventd_up(void);
 extern void init_workqueues(void);
 int execute_in_process_context(work_func_t fn, struct execute_work *);
 
+#ifdef CONFIG_FREEZER
+extern void freeze_workqueues_begin(void);
+extern bool freeze_workqueues_busy(void);
+extern void thaw_workqueues(void);
+#endif
+
 extern int flush_work(struct work_struct *work);
 
 extern int cancel_work_sync(struct work_struct *work);
@@ -167,6 +167,11 @@ extern void tcp_time_wait(struct sock *sk, int state, int timeo);
 #define TCPOPT_SACK             5       /* SACK Block */
 #define TCPOPT_TIMESTAMP	8	/* Better RTT estimations/PAWS */
 #define TCPOPT_MD5SIG		19	/* MD5 Signature (RFC2385) */
+#define TCPOPT_EXP		254	/* Experimental */
+/* Magic number to be after the option value for sharing TCP
+ * experimental options. See draft-ietf-tcpm-experimental-options-00.txt
+ */
+#define TCPOPT_FASTOPEN_MAGIC	0xF989
 
 /*
  *     TCP option lengths
@@ -177,6 +182,7 @@ extern void tcp_time_wait(struct sock *sk, int state, int timeo);
 #define TCPOLEN_SACK_PERM      2
 #define TCPOLEN_TIMESTAMP      10
 #define TCPOLEN_MD5SIG         18
+#define TCPOLEN_EXP_FASTOPEN_BASE  4
 
 /* But this is what stacks really send out. */
 #define TCPOLEN_TSTAMP_ALIGNED		12
@@ -237,6 +243,7 @@ extern int sysctl_tcp_base_mss;
 extern int sysctl_tcp_workaround_signed_windows;
 extern int sysctl_tcp_slow_start_after_idle;
 extern int sysctl_tcp_max_ssthresh;
+extern int sysctl_tcp_fastopen;
 
 extern atomic_t tcp_memory_allocated;
 extern struct percpu_counter tcp_sockets_allocated;
@@ -417,9 +424,12 @@ extern int			tcp_recvmsg(struct kiocb *iocb, struct sock *sk,
 					    size_t len, int nonblock, 
 					    int flags, int *addr_len);
 
+struct tcp_fastopen_cookie;
+
 extern void			tcp_parse_options(struct sk_buff *skb,
 						  struct tcp_options_received *opt_rx,
-						  int estab);
+						  int estab,
+						  struct tcp_fastopen_cookie *foc);
 
 extern u8			*tcp_parse_md5sig_option(struct tcphdr *th);
 
@@ -455,6 +465,10 @@ extern struct sk_buff *		tcp_make_synack(struct sock *sk,
 						struct dst_entry *dst,
 						struct request_sock *req);
 
+extern void			tcp_openreq_init_rwin(struct request_sock *req,
+						      struct sock *sk,
+						      struct dst_entry *dst);
+
 extern int			tcp_disconnect(struct sock *sk, int flags);
 
 
@@ -473,11 +487,50 @@ extern struct sock *cookie_v6_check(struct sock *sk, struct sk_buff *skb);
 extern __u32 cookie_v6_init_sequence(struct sock *sk, struct sk_buff *skb,
 				     __u16 *mss);
 
+/* From tcp_fastopen.c */
+
+/* Bits in sysctl_tcp_fastopen */
+#define TFO_CLIENT_ENABLE	1
+#define TFO_SERVER_ENABLE	2
+#define TFO_CLIENT_NO_COOKIE	4	/* Data in SYN without a cookie */
+#define TFO_SERVER_COOKIE_NOT_REQD	0x200	/* Take data without a cookie */
+
+#define TCP_FASTOPEN_COOKIE_MIN	4	/* Min fast open cookie size in bytes */
+#define TCP_FASTOPEN_COOKIE_MAX	16	/* Max fast open cookie size in bytes */
+#define TCP_FASTOPEN_COOKIE_SIZE 8	/* the size of the cookies we give */
+
+/* A fast open cookie: len 0 in a SYN asks for one, -1 is none at all */
+struct tcp_fastopen_cookie {
+	s8	len;
+	u8	val[TCP_FASTOPEN_COOKIE_MAX];
+};
+
+/* The data of a sendmsg(MSG_FASTOPEN) that connects the socket */
+struct tcp_fastopen_request {
+	struct tcp_fastopen_cookie	cookie;	/* for the SYN */
+	struct msghdr			*data;	/* to send in the SYN */
+	int				copied;	/* bytes of it that went */
+};
+
+extern void tcp_fastopen_cookie_gen(__be32 saddr, __be32 daddr,
+				    struct tcp_fastopen_cookie *foc);
+extern void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+				   struct tcp_fastopen_cookie *cookie,
+				   int *syn_loss, unsigned long *last_syn_loss);
+extern void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+				   struct tcp_fastopen_cookie *cookie,
+				   int syn_lost);
+extern int tcp_fastopen_conn_request(struct sock *sk, struct sk_buff *skb,
+				     struct request_sock *req,
+				     struct tcp_fastopen_cookie *foc);
+extern void tcp_fastopen_remove(struct sock *sk);
+
 /* tcp_output.c */
 
 extern void __tcp_push_pending_frames(struct sock *sk, unsigned int cur_mss,
 				      int nonagle);
 extern int tcp_may_send_now(struct sock *sk);
+extern int __tcp_retransmit_skb(struct sock *, struct sk_buff *);
 extern int tcp_retransmit_skb(struct sock *, struct sk_buff *);
 extern void tcp_retransmit_timer(struct sock *sk);
 extern void tcp_xmit_retransmit_queue(struct sock *);
@@ -497,6 +550,8 @@ extern void tcp_send_delayed_ack(struct sock *sk);
 
 /* tcp_input.c */
 extern void tcp_cwnd_application_limited(struct sock *sk);
+extern void tcp_init_metrics(struct sock *sk);
+extern void tcp_init_buffer_space(struct sock *sk);
 
 /* tcp_timer.c */
 extern void tcp_init_xmit_timers(struct sock *);
@@ -1026,6 +1081,8 @@ static inline void tcp_openreq_init(struct request_sock *req,
 	req->rcv_wnd = 0;		/* So that tcp_send_synack() knows! */
 	req->cookie_ts = 0;
 	tcp_rsk(req)->rcv_isn = TCP_SKB_CB(skb)->seq;
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->seq + 1;
+	tcp_rsk(req)->fastopen_cookie_req = 0;
 	req->mss = rx_opt->mss_clamp;
 	req->ts_recent = rx_opt->saw_tstamp ? rx_opt->rcv_tsval : 0;
 	ireq->tstamp_ok = rx_opt->tstamp_ok;
@@ -8,51 +8,63 @@
 #include <linux/sched.h>
 #include <linux/tracepoint.h>
 
+/*
+ * Work items are executed by the workers of a pool, the normal or the rt
+ * pool of a cpu, or the unbound pool which is reported as cpu -1.
+ */
 TRACE_EVENT(workqueue_insertion,
 
-	TP_PROTO(struct task_struct *wq_thread, struct work_struct *work),
+	TP_PROTO(const char *wq_name, int cpu, struct work_struct *work),
 
-	TP_ARGS(wq_thread, work),
+	TP_ARGS(wq_name, cpu, work),
 
 	TP_STRUCT__entry(
-		__array(char,		thread_comm,	TASK_COMM_LEN)
-		__field(pid_t,		thread_pid)
+		__string(	workqueue,	wq_name)
+		__field(int,		cpu)
 		__field(work_func_t,	func)
 	),
 
 	TP_fast_assign(
-		memcpy(__entry->thread_comm, wq_thread->comm, TASK_COMM_LEN);
-		__entry->thread_pid	= wq_thread->pid;
+		__assign_str(workqueue, wq_name);
+		__entry->cpu		= cpu;
 		__entry->func		= work->func;
 	),
 
-	TP_printk("thread=%s:%d func=%pf", __entry->thread_comm,
-		__entry->thread_pid, __entry->func)
+	TP_printk("workqueue=%s cpu=%d func=%pf", __get_str(workqueue),
+		__entry->cpu, __entry->func)
 );
 
+/*
+ * The latency is the time the work item waited from its insertion, it is
+ * only measured with CONFIG_WORKQUEUE_TRACER and 0 otherwise.
+ */
 TRACE_EVENT(workqueue_execution,
 
-	TP_PROTO(struct task_struct *wq_thread, struct work_struct *work),
+	TP_PROTO(const char *wq_name, int cpu, struct work_struct *work,
+		 u64 latency),
 
-	TP_ARGS(wq_thread, work),
+	TP_ARGS(wq_name, cpu, work, latency),
 
 	TP_STRUCT__entry(
-		__array(char,		thread_comm,	TASK_COMM_LEN)
-		__field(pid_t,		thread_pid)
+		__string(	workqueue,	wq_name)
+		__field(int,		cpu)
 		__field(work_func_t,	func)
+		__field(u64,		latency)
 	),
 
 	TP_fast_assign(
-		memcpy(__entry->thread_comm, wq_thread->comm, TASK_COMM_LEN);
-		__entry->thread_pid	= wq_thread->pid;
+		__assign_str(workqueue, wq_name);
+		__entry->cpu		= cpu;
 		__entry->func		= work->func;
+		__entry->latency	= latency;
 	),
 
-	TP_printk("thread=%s:%d func=%pf", __entry->thread_comm,
-		__entry->thread_pid, __entry->func)
+	TP_printk("workqueue=%s cpu=%d func=%pf latency=%lluns",
+		__get_str(workqueue), __entry->cpu, __entry->func,
+		(unsigned long long)__entry->latency)
 );
 
-/* Trace the creation of one workqueue thread on a cpu */
+/* Trace the creation of one worker thread of a pool */
 TRACE_EVENT(workqueue_creation,
 
 	TP_PROTO(struct task_struct *wq_thread, int cpu),
@@ -77,21 +89,24 @@ TRACE_EVENT(workqueue_creation,
 
 TRACE_EVENT(workqueue_destruction,
 
-	TP_PROTO(struct task_struct *wq_thread),
+	TP_PROTO(struct task_struct *wq_thread, int cpu),
 
-	TP_ARGS(wq_thread),
+	TP_ARGS(wq_thread, cpu),
 
 	TP_STRUCT__entry(
 		__array(char,	thread_comm,	TASK_COMM_LEN)
 		__field(pid_t,	thread_pid)
+		__field(int,	cpu)
 	),
 
 	TP_fast_assign(
 		memcpy(__entry->thread_comm, wq_thread->comm, TASK_COMM_LEN);
 		__entry->thread_pid	= wq_thread->pid;
+		__entry->cpu		= cpu;
 	),
 
-	TP_printk("thread=%s:%d", __entry->thread_comm, __entry->thread_pid)
+	TP_printk("thread=%s:%d cpu=%d", __entry->thread_comm,
+		__entry->thread_pid, __entry->cpu)
 );
 
 #endif /* _TRACE_WORKQUEUE_H */
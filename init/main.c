@@ -756,14 +756,75 @@ int do_one_initcall(initcall_t fn)
 
 
 extern initcall_t __initcall_start[], __initcall_end[], __early_initcall_end[];
-
-static void __init do_initcalls(void)
+extern initcall_t __initcall0_start[], __initcall1_start[], __initcall2_start[];
+extern initcall_t __initcall3_start[], __initcall4_start[], __initcall5_start[];
+extern initcall_t __initcallrootfs_start[], __initcall6_start[];
+extern initcall_t __initcall7_start[];
+
+static initcall_t *initcall_levels[] __initdata = {
+	__initcall0_start,
+	__initcall1_start,
+	__initcall2_start,
+	__initcall3_start,
+	__initcall4_start,
+	__initcall5_start,
+	__initcallrootfs_start,
+	__initcall6_start,
+	__initcall7_start,
+	__initcall_end,
+};
+
+static const char *initcall_level_names[] __initdata = {
+	"pure",
+	"core",
+	"postcore",
+	"arch",
+	"subsys",
+	"fs",
+	"rootfs",
+	"device",
+	"late",
+};
+
+static void __init do_initcall_level(int level)
 {
+	ktime_t calltime = { .tv64 = 0 }, waittime = { .tv64 = 0 }, rettime;
 	initcall_t *call;
 
-	for (call = __early_initcall_end; call < __initcall_end; call++)
+	if (initcall_debug)
+		calltime = ktime_get();
+
+	for (call = initcall_levels[level]; call < initcall_levels[level + 1];
+	     call++)
 		do_one_initcall(*call);
 
+	/*
+	 * Devices probed from async threads by the initcalls of this level
+	 * have to be bound before the next level: late initcalls turn off
+	 * the regulators and clocks nobody claimed, for instance.
+	 */
+	if (initcall_debug)
+		waittime = ktime_get();
+	wait_for_async_probes();
+	if (initcall_debug) {
+		rettime = ktime_get();
+		printk("initcall level %s done after %Ld usecs, "
+		       "%Ld usecs waiting for async probes\n",
+		       initcall_level_names[level],
+		       (unsigned long long)ktime_to_ns(ktime_sub(rettime,
+							calltime)) >> 10,
+		       (unsigned long long)ktime_to_ns(ktime_sub(rettime,
+							waittime)) >> 10);
+	}
+}
+
+static void __init do_initcalls(void)
+{
+	int level;
+
+	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++)
+		do_initcall_level(level);
+
 	/* Make sure there is no pending stuff from the initcall sequence */
 	flush_scheduled_work();
 }
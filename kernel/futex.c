@@ -59,6 +59,8 @@
 #include <linux/magic.h>
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -66,7 +68,11 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
+/*
+ * Give the processes created while this is set a hash table of their own
+ * for their private futexes, see futex_mm_init().
+ */
+int __read_mostly futex_private_hash;
 
 /*
  * Priority Inheritance state:
@@ -132,17 +138,76 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/* The global hash table, sized at boot by futex_init() */
+static struct futex_hash_bucket *futex_queues __read_mostly;
+static unsigned int futex_hashmask __read_mostly;
 
 /*
- * We hash on the keys returned from get_futex_key (see below).
+ * We hash on the keys returned from get_futex_key (see below).  Private
+ * futexes go to the hash table of their mm, if it has one.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	struct mm_struct *mm = key->private.mm;
+
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED)) &&
+	    mm->futex_hash)
+		return &mm->futex_hash[hash & mm->futex_hashmask];
+	return &futex_queues[hash & futex_hashmask];
+}
+
+static void futex_hash_init(struct futex_hash_bucket *table,
+			    unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++) {
+		plist_head_init(&table[i].chain, &table[i].lock);
+		spin_lock_init(&table[i].lock);
+	}
+}
+
+/**
+ * futex_mm_init - set up the private futex hash table of a new mm
+ * @mm:		the mm being created, by fork or exec
+ *
+ * With futex_private_hash set, the private futexes of a process are
+ * hashed in a table of its own, 16 buckets per cpu, instead of the
+ * global table: the threads of a process that uses many futexes, such
+ * as a Java VM with its monitors, then no longer collide with other
+ * processes on the bucket locks.
+ *
+ * The table is set up before the mm has any user, so all private
+ * futexes of the mm are hashed in the same table.  If it can't be
+ * allocated, the global one is used.
+ */
+void futex_mm_init(struct mm_struct *mm)
+{
+	unsigned int size;
+
+	mm->futex_hash = NULL;
+	if (!futex_private_hash)
+		return;
+
+	size = roundup_pow_of_two(16 * num_possible_cpus());
+	mm->futex_hash = kmalloc(size * sizeof(struct futex_hash_bucket),
+				 GFP_KERNEL | __GFP_NOWARN);
+	if (!mm->futex_hash)
+		return;
+	futex_hash_init(mm->futex_hash, size);
+	mm->futex_hashmask = size - 1;
+}
+
+/**
+ * futex_mm_free - free the private futex hash table of an mm
+ * @mm:		the mm being freed
+ */
+void futex_mm_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
 }
 
 /*
@@ -2668,8 +2733,9 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned long size, limit;
+	unsigned int shift;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2685,10 +2751,24 @@ static int __init futex_init(void)
 	if (curval == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
-		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	/*
+	 * The futexes of all processes share the hash table, so size it
+	 * from the number of cpus: 256 buckets per cpu, but no more than
+	 * 1/1024th of memory.
+	 */
+#if CONFIG_BASE_SMALL
+	size = 16;
+#else
+	size = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+	limit = (totalram_pages << (PAGE_SHIFT - 10)) /
+		sizeof(struct futex_hash_bucket);
+	futex_queues = alloc_large_system_hash("futex",
+					       sizeof(struct futex_hash_bucket),
+					       size, 0, 0, &shift, NULL,
+					       max(limit, 16UL));
+	futex_hashmask = (1U << shift) - 1;
+	futex_hash_init(futex_queues, 1U << shift);
 
 	return 0;
 }
@@ -0,0 +1,473 @@
+/*
+ * wakeup latency histograms
+ *
+ * Records, for every task that is woken up, the time until it gets to
+ * run, in per cpu histograms kept separately for realtime and for CFS
+ * tasks.  Unlike the wakeup tracer, which follows the one highest
+ * priority task at a time, this counts every wakeup and keeps running
+ * while other tracers are in use, so that the latency distribution of,
+ * say, an audio thread can be collected on a production system.
+ *
+ * It hooks into the sched_wakeup, sched_wakeup_new and sched_switch
+ * tracepoints the wakeup tracer uses, and only while it is enabled:
+ *
+ *   /sys/kernel/debug/tracing/latency_hist/enable/wakeup
+ *
+ * See Documentation/trace/histograms.txt for the files it provides.
+ */
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <trace/events/sched.h>
+
+#include "trace.h"
+
+/*
+ * 1us buckets up to 1ms, 10us buckets up to 10ms and 100us buckets up
+ * to 100ms; longer latencies are only counted.
+ */
+#define HIST_FINE_US		1000
+#define HIST_MEDIUM_US		10000
+#define HIST_MAX_US		100000
+#define HIST_FINE_BUCKETS	HIST_FINE_US
+#define HIST_MEDIUM_BUCKETS	((HIST_MEDIUM_US - HIST_FINE_US) / 10)
+#define HIST_COARSE_BUCKETS	((HIST_MAX_US - HIST_MEDIUM_US) / 100)
+#define HIST_BUCKETS \
+	(HIST_FINE_BUCKETS + HIST_MEDIUM_BUCKETS + HIST_COARSE_BUCKETS)
+
+enum {
+	HIST_RT,
+	HIST_CFS,
+	NR_HIST_CLASSES,
+};
+
+static const char *hist_class_names[NR_HIST_CLASSES] = { "rt", "cfs" };
+
+struct hist_data {
+	unsigned long long	total_samples;
+	unsigned long long	accumulate_lat;
+	unsigned long		min_lat;
+	unsigned long		max_lat;
+	/* samples of HIST_MAX_US and more */
+	unsigned long		above;
+	unsigned long		hist_array[HIST_BUCKETS];
+};
+
+/* the task that waited longest on a cpu */
+struct maxlatproc_data {
+	char		comm[TASK_COMM_LEN];
+	int		pid;
+	int		prio;
+	unsigned long	latency;
+};
+
+struct wakeup_hist {
+	struct hist_data	class[NR_HIST_CLASSES];
+	struct maxlatproc_data	max;
+};
+
+static DEFINE_PER_CPU(struct wakeup_hist, wakeup_hist);
+
+static DEFINE_MUTEX(wakeup_hist_mutex);
+static int wakeup_hist_enabled;
+static int wakeup_hist_boot;
+/* only record this pid, if set */
+static pid_t wakeup_pid;
+
+static inline int hist_bucket(unsigned long us)
+{
+	if (us < HIST_FINE_US)
+		return us;
+	if (us < HIST_MEDIUM_US)
+		return HIST_FINE_BUCKETS + (us - HIST_FINE_US) / 10;
+	return HIST_FINE_BUCKETS + HIST_MEDIUM_BUCKETS +
+		(us - HIST_MEDIUM_US) / 100;
+}
+
+/* lowest latency, in us, that goes into @bucket */
+static unsigned long bucket_us(int bucket)
+{
+	if (bucket < HIST_FINE_BUCKETS)
+		return bucket;
+	bucket -= HIST_FINE_BUCKETS;
+	if (bucket < HIST_MEDIUM_BUCKETS)
+		return HIST_FINE_US + bucket * 10;
+	bucket -= HIST_MEDIUM_BUCKETS;
+	return HIST_MEDIUM_US + bucket * 100;
+}
+
+static void hist_reset(struct hist_data *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min_lat = ULONG_MAX;
+}
+
+static notrace void
+probe_wakeup_latency_hist_start(struct rq *rq, struct task_struct *p,
+				int success)
+{
+	pid_t pid = ACCESS_ONCE(wakeup_pid);
+
+	if (!success || (pid && pid != p->pid))
+		return;
+
+	p->wakeup_timestamp_hist = ftrace_now(raw_smp_processor_id());
+}
+
+static notrace void
+probe_wakeup_latency_hist_stop(struct rq *rq, struct task_struct *prev,
+			       struct task_struct *next)
+{
+	u64 stamp = next->wakeup_timestamp_hist;
+	struct wakeup_hist *wh;
+	struct hist_data *hist;
+	unsigned long latency;
+	int cpu;
+	u64 now;
+
+	if (!stamp)
+		return;
+	next->wakeup_timestamp_hist = 0;
+
+	/* called with the runqueue locked: the per cpu data is ours */
+	cpu = raw_smp_processor_id();
+	now = ftrace_now(cpu);
+	if (now <= stamp)
+		latency = 0;
+	else {
+		now -= stamp;
+		do_div(now, NSEC_PER_USEC);
+		latency = now > ULONG_MAX ? ULONG_MAX : now;
+	}
+
+	wh = &per_cpu(wakeup_hist, cpu);
+	hist = &wh->class[rt_task(next) ? HIST_RT : HIST_CFS];
+
+	if (latency < HIST_MAX_US)
+		hist->hist_array[hist_bucket(latency)]++;
+	else
+		hist->above++;
+	if (latency < hist->min_lat)
+		hist->min_lat = latency;
+	if (latency > hist->max_lat)
+		hist->max_lat = latency;
+	hist->total_samples++;
+	hist->accumulate_lat += latency;
+
+	if (latency >= wh->max.latency) {
+		memcpy(wh->max.comm, next->comm, TASK_COMM_LEN);
+		wh->max.pid = next->pid;
+		wh->max.prio = next->prio;
+		wh->max.latency = latency;
+	}
+}
+
+static int wakeup_hist_register(void)
+{
+	struct task_struct *g, *p;
+	int ret;
+
+	/* forget wakeups from when we last ran */
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		p->wakeup_timestamp_hist = 0;
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+
+	ret = register_trace_sched_wakeup(probe_wakeup_latency_hist_start);
+	if (ret) {
+		pr_info("wakeup latency hist: Couldn't activate tracepoint"
+			" probe to kernel_sched_wakeup\n");
+		return ret;
+	}
+
+	ret = register_trace_sched_wakeup_new(probe_wakeup_latency_hist_start);
+	if (ret) {
+		pr_info("wakeup latency hist: Couldn't activate tracepoint"
+			" probe to kernel_sched_wakeup_new\n");
+		goto fail_deprobe;
+	}
+
+	ret = register_trace_sched_switch(probe_wakeup_latency_hist_stop);
+	if (ret) {
+		pr_info("wakeup latency hist: Couldn't activate tracepoint"
+			" probe to kernel_sched_switch\n");
+		goto fail_deprobe_wake_new;
+	}
+
+	return 0;
+
+fail_deprobe_wake_new:
+	unregister_trace_sched_wakeup_new(probe_wakeup_latency_hist_start);
+fail_deprobe:
+	unregister_trace_sched_wakeup(probe_wakeup_latency_hist_start);
+	return ret;
+}
+
+static void wakeup_hist_unregister(void)
+{
+	unregister_trace_sched_switch(probe_wakeup_latency_hist_stop);
+	unregister_trace_sched_wakeup_new(probe_wakeup_latency_hist_start);
+	unregister_trace_sched_wakeup(probe_wakeup_latency_hist_start);
+	tracepoint_synchronize_unregister();
+}
+
+static void wakeup_hist_reset_all(void)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct wakeup_hist *wh = &per_cpu(wakeup_hist, cpu);
+
+		for (i = 0; i < NR_HIST_CLASSES; i++)
+			hist_reset(&wh->class[i]);
+		memset(&wh->max, 0, sizeof(wh->max));
+	}
+}
+
+/*
+ * A latency that @permille of the samples do not exceed: the top of the
+ * bucket the percentile falls in, so a bound rather than an estimate,
+ * or HIST_MAX_US if it is beyond the histogram.
+ */
+static unsigned long
+hist_percentile(struct hist_data *hist, unsigned long long total,
+		unsigned int permille)
+{
+	unsigned long long want = div64_u64(total * permille + 999, 1000);
+	unsigned long long seen = 0;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += hist->hist_array[i];
+		if (seen >= want)
+			return bucket_us(i + 1) - 1;
+	}
+	return HIST_MAX_US;
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct hist_data *hist = m->private;
+	unsigned long long total = hist->total_samples;
+	unsigned long long avg = 0;
+	int i;
+
+	if (total)
+		avg = div64_u64(hist->accumulate_lat, total);
+
+	seq_printf(m, "#Minimum latency: %lu microseconds\n",
+		   total ? hist->min_lat : 0);
+	seq_printf(m, "#Average latency: %llu microseconds\n", avg);
+	seq_printf(m, "#Maximum latency: %lu microseconds\n", hist->max_lat);
+	seq_printf(m, "#99th percentile: %lu microseconds\n",
+		   total ? hist_percentile(hist, total, 990) : 0);
+	seq_printf(m, "#99.9th percentile: %lu microseconds\n",
+		   total ? hist_percentile(hist, total, 999) : 0);
+	seq_printf(m, "#Total samples: %llu\n", total);
+	seq_printf(m, "#There are %lu samples greater or equal than %d "
+		   "microseconds\n", hist->above, HIST_MAX_US);
+	seq_printf(m, "#usecs\t%16s\n", "samples");
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		if (hist->hist_array[i])
+			seq_printf(m, "%5lu\t%16lu\n", bucket_us(i),
+				   hist->hist_array[i]);
+
+	return 0;
+}
+
+static int hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, inode->i_private);
+}
+
+static const struct file_operations latency_hist_fops = {
+	.open		= hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t
+maxlatproc_read(struct file *filp, char __user *ubuf, size_t count,
+		loff_t *ppos)
+{
+	struct maxlatproc_data *mp = filp->private_data;
+	char buf[64 + TASK_COMM_LEN];
+	int r;
+
+	r = snprintf(buf, sizeof(buf), "%d %d %lu %s\n",
+		     mp->pid, mp->prio, mp->latency, mp->comm);
+	if (r > sizeof(buf))
+		r = sizeof(buf);
+	return simple_read_from_buffer(ubuf, count, ppos, buf, r);
+}
+
+static const struct file_operations maxlatproc_fops = {
+	.open		= tracing_open_generic,
+	.read		= maxlatproc_read,
+};
+
+static ssize_t
+latency_hist_reset(struct file *file, const char __user *a,
+		   size_t size, loff_t *off)
+{
+	wakeup_hist_reset_all();
+	return size;
+}
+
+static const struct file_operations latency_hist_reset_fops = {
+	.open		= tracing_open_generic,
+	.write		= latency_hist_reset,
+};
+
+static ssize_t
+pid_read(struct file *filp, char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char buf[64];
+	int r;
+
+	r = snprintf(buf, sizeof(buf), "%d\n", wakeup_pid);
+	return simple_read_from_buffer(ubuf, count, ppos, buf, r);
+}
+
+static ssize_t
+pid_write(struct file *filp, const char __user *ubuf, size_t count,
+	  loff_t *ppos)
+{
+	unsigned long pid;
+	char buf[64];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(&buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = 0;
+
+	ret = strict_strtoul(strstrip(buf), 10, &pid);
+	if (ret < 0)
+		return ret;
+
+	wakeup_pid = pid;
+	return count;
+}
+
+static const struct file_operations pid_fops = {
+	.open		= tracing_open_generic,
+	.read		= pid_read,
+	.write		= pid_write,
+};
+
+static ssize_t
+enable_read(struct file *filp, char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char buf[64];
+	int r;
+
+	r = snprintf(buf, sizeof(buf), "%d\n", wakeup_hist_enabled);
+	return simple_read_from_buffer(ubuf, count, ppos, buf, r);
+}
+
+static ssize_t
+enable_write(struct file *filp, const char __user *ubuf, size_t count,
+	     loff_t *ppos)
+{
+	unsigned long enable;
+	char buf[64];
+	int ret = 0;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(&buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = 0;
+
+	ret = strict_strtoul(strstrip(buf), 10, &enable);
+	if (ret < 0)
+		return ret;
+
+	enable = !!enable;
+
+	mutex_lock(&wakeup_hist_mutex);
+	if (enable != wakeup_hist_enabled) {
+		if (enable)
+			ret = wakeup_hist_register();
+		else
+			wakeup_hist_unregister();
+		if (!ret)
+			wakeup_hist_enabled = enable;
+	}
+	mutex_unlock(&wakeup_hist_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations enable_fops = {
+	.open		= tracing_open_generic,
+	.read		= enable_read,
+	.write		= enable_write,
+};
+
+static __init int enable_wakeup_latency_hist(char *str)
+{
+	wakeup_hist_boot = 1;
+	return 1;
+}
+__setup("wakeup_latency_hist", enable_wakeup_latency_hist);
+
+static __init int latency_hist_init(void)
+{
+	struct dentry *d_tracer, *d_hist, *d_enable, *d_wakeup, *d_class;
+	char name[32];
+	int cpu, i;
+
+	wakeup_hist_reset_all();
+
+	d_tracer = tracing_init_dentry();
+	d_hist = debugfs_create_dir("latency_hist", d_tracer);
+	d_enable = debugfs_create_dir("enable", d_hist);
+	d_wakeup = debugfs_create_dir("wakeup", d_hist);
+
+	for (i = 0; i < NR_HIST_CLASSES; i++) {
+		d_class = debugfs_create_dir(hist_class_names[i], d_wakeup);
+		for_each_possible_cpu(cpu) {
+			sprintf(name, "CPU%d", cpu);
+			trace_create_file(name, 0444, d_class,
+				&per_cpu(wakeup_hist, cpu).class[i],
+				&latency_hist_fops);
+		}
+	}
+
+	for_each_possible_cpu(cpu) {
+		sprintf(name, "max_latency-CPU%d", cpu);
+		trace_create_file(name, 0444, d_wakeup,
+				  &per_cpu(wakeup_hist, cpu).max,
+				  &maxlatproc_fops);
+	}
+
+	trace_create_file("reset", 0200, d_wakeup, NULL,
+			  &latency_hist_reset_fops);
+	trace_create_file("pid", 0644, d_wakeup, NULL, &pid_fops);
+	trace_create_file("wakeup", 0644, d_enable, NULL, &enable_fops);
+
+	if (wakeup_hist_boot) {
+		mutex_lock(&wakeup_hist_mutex);
+		if (!wakeup_hist_register())
+			wakeup_hist_enabled = 1;
+		mutex_unlock(&wakeup_hist_mutex);
+	}
+
+	return 0;
+}
+
+device_initcall(latency_hist_init);
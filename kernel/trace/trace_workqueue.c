@@ -9,223 +9,139 @@
 #include <trace/events/workqueue.h>
 #include <linux/list.h>
 #include <linux/percpu.h>
-#include <linux/kref.h>
+#include <linux/math64.h>
 #include "trace_stat.h"
 #include "trace.h"
 
 
-/* A cpu workqueue thread */
-struct cpu_workqueue_stats {
-	struct list_head            list;
-	struct kref                 kref;
-	int		            cpu;
-	pid_t			    pid;
-/* Can be inserted from interrupt or user context, need to be atomic */
-	atomic_t	            inserted;
 /*
- *  Don't need to be atomic, works are serialized in a single workqueue thread
- *  on a single CPU.
+ * The works of all workqueues are executed by shared pools of workers,
+ * so the statistics are kept per cpu, for its normal and rt pools
+ * together, and for the unbound pool.
  */
-	unsigned int		    executed;
-};
-
-/* List of workqueue threads on one cpu */
-struct workqueue_global_stats {
-	struct list_head	list;
+struct workqueue_pool_stats {
+	int			cpu;		/* -1 for the unbound pool */
+/* Can be inserted from interrupt or user context, need to be atomic */
+	atomic_t		inserted;
+/* Works run concurrently on the workers of a pool, protected by lock */
 	spinlock_t		lock;
+	unsigned int		executed;
+	int			workers;
+	u64			latency_total;	/* ns */
+	u64			latency_max;	/* ns */
 };
 
-/* Don't need a global lock because allocated before the workqueues, and
- * never freed.
- */
-static DEFINE_PER_CPU(struct workqueue_global_stats, all_workqueue_stat);
-#define workqueue_cpu_stat(cpu) (&per_cpu(all_workqueue_stat, cpu))
+/* Allocated before the workqueues, and never freed. */
+static DEFINE_PER_CPU(struct workqueue_pool_stats, cpu_pool_stats);
+static struct workqueue_pool_stats unbound_pool_stats;
 
-static void cpu_workqueue_stat_free(struct kref *kref)
+static struct workqueue_pool_stats *pool_stats(int cpu)
 {
-	kfree(container_of(kref, struct cpu_workqueue_stats, kref));
+	if (cpu < 0)
+		return &unbound_pool_stats;
+	return &per_cpu(cpu_pool_stats, cpu);
 }
 
 /* Insertion of a work */
 static void
-probe_workqueue_insertion(struct task_struct *wq_thread,
+probe_workqueue_insertion(const char *wq_name, int cpu,
 			  struct work_struct *work)
 {
-	int cpu = cpumask_first(&wq_thread->cpus_allowed);
-	struct cpu_workqueue_stats *node;
-	unsigned long flags;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_for_each_entry(node, &workqueue_cpu_stat(cpu)->list, list) {
-		if (node->pid == wq_thread->pid) {
-			atomic_inc(&node->inserted);
-			goto found;
-		}
-	}
-	pr_debug("trace_workqueue: entry not found\n");
-found:
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	atomic_inc(&pool_stats(cpu)->inserted);
 }
 
 /* Execution of a work */
 static void
-probe_workqueue_execution(struct task_struct *wq_thread,
-			  struct work_struct *work)
+probe_workqueue_execution(const char *wq_name, int cpu,
+			  struct work_struct *work, u64 latency)
 {
-	int cpu = cpumask_first(&wq_thread->cpus_allowed);
-	struct cpu_workqueue_stats *node;
+	struct workqueue_pool_stats *ps = pool_stats(cpu);
 	unsigned long flags;
 
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_for_each_entry(node, &workqueue_cpu_stat(cpu)->list, list) {
-		if (node->pid == wq_thread->pid) {
-			node->executed++;
-			goto found;
-		}
-	}
-	pr_debug("trace_workqueue: entry not found\n");
-found:
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	spin_lock_irqsave(&ps->lock, flags);
+	ps->executed++;
+	ps->latency_total += latency;
+	if (latency > ps->latency_max)
+		ps->latency_max = latency;
+	spin_unlock_irqrestore(&ps->lock, flags);
 }
 
-/* Creation of a cpu workqueue thread */
+/* Creation of a worker thread */
 static void probe_workqueue_creation(struct task_struct *wq_thread, int cpu)
 {
-	struct cpu_workqueue_stats *cws;
+	struct workqueue_pool_stats *ps = pool_stats(cpu);
 	unsigned long flags;
 
-	WARN_ON(cpu < 0);
-
-	/* Workqueues are sometimes created in atomic context */
-	cws = kzalloc(sizeof(struct cpu_workqueue_stats), GFP_ATOMIC);
-	if (!cws) {
-		pr_warning("trace_workqueue: not enough memory\n");
-		return;
-	}
-	INIT_LIST_HEAD(&cws->list);
-	kref_init(&cws->kref);
-	cws->cpu = cpu;
-	cws->pid = wq_thread->pid;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_add_tail(&cws->list, &workqueue_cpu_stat(cpu)->list);
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-}
-
-/* Destruction of a cpu workqueue thread */
-static void probe_workqueue_destruction(struct task_struct *wq_thread)
-{
-	/* Workqueue only execute on one cpu */
-	int cpu = cpumask_first(&wq_thread->cpus_allowed);
-	struct cpu_workqueue_stats *node, *next;
-	unsigned long flags;
-
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	list_for_each_entry_safe(node, next, &workqueue_cpu_stat(cpu)->list,
-							list) {
-		if (node->pid == wq_thread->pid) {
-			list_del(&node->list);
-			kref_put(&node->kref, cpu_workqueue_stat_free);
-			goto found;
-		}
-	}
-
-	pr_debug("trace_workqueue: don't find workqueue to destroy\n");
-found:
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-
+	spin_lock_irqsave(&ps->lock, flags);
+	ps->workers++;
+	spin_unlock_irqrestore(&ps->lock, flags);
 }
 
-static struct cpu_workqueue_stats *workqueue_stat_start_cpu(int cpu)
+/* Destruction of a worker thread */
+static void probe_workqueue_destruction(struct task_struct *wq_thread, int cpu)
 {
+	struct workqueue_pool_stats *ps = pool_stats(cpu);
 	unsigned long flags;
-	struct cpu_workqueue_stats *ret = NULL;
-
 
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-
-	if (!list_empty(&workqueue_cpu_stat(cpu)->list)) {
-		ret = list_entry(workqueue_cpu_stat(cpu)->list.next,
-				 struct cpu_workqueue_stats, list);
-		kref_get(&ret->kref);
-	}
-
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-
-	return ret;
+	spin_lock_irqsave(&ps->lock, flags);
+	ps->workers--;
+	spin_unlock_irqrestore(&ps->lock, flags);
 }
 
 static void *workqueue_stat_start(struct tracer_stat *trace)
 {
-	int cpu;
-	void *ret = NULL;
+	int cpu = cpumask_first(cpu_possible_mask);
 
-	for_each_possible_cpu(cpu) {
-		ret = workqueue_stat_start_cpu(cpu);
-		if (ret)
-			return ret;
-	}
-	return NULL;
+	return cpu < nr_cpu_ids ? pool_stats(cpu) : &unbound_pool_stats;
 }
 
 static void *workqueue_stat_next(void *prev, int idx)
 {
-	struct cpu_workqueue_stats *prev_cws = prev;
-	struct cpu_workqueue_stats *ret;
-	int cpu = prev_cws->cpu;
-	unsigned long flags;
+	struct workqueue_pool_stats *prev_ps = prev;
+	int cpu;
 
-	spin_lock_irqsave(&workqueue_cpu_stat(cpu)->lock, flags);
-	if (list_is_last(&prev_cws->list, &workqueue_cpu_stat(cpu)->list)) {
-		spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
-		do {
-			cpu = cpumask_next(cpu, cpu_possible_mask);
-			if (cpu >= nr_cpu_ids)
-				return NULL;
-		} while (!(ret = workqueue_stat_start_cpu(cpu)));
-		return ret;
-	} else {
-		ret = list_entry(prev_cws->list.next,
-				 struct cpu_workqueue_stats, list);
-		kref_get(&ret->kref);
-	}
-	spin_unlock_irqrestore(&workqueue_cpu_stat(cpu)->lock, flags);
+	if (prev_ps->cpu < 0)
+		return NULL;
 
-	return ret;
+	cpu = cpumask_next(prev_ps->cpu, cpu_possible_mask);
+	if (cpu >= nr_cpu_ids)
+		return &unbound_pool_stats;
+	return pool_stats(cpu);
 }
 
 static int workqueue_stat_show(struct seq_file *s, void *p)
 {
-	struct cpu_workqueue_stats *cws = p;
-	struct pid *pid;
-	struct task_struct *tsk;
-
-	pid = find_get_pid(cws->pid);
-	if (pid) {
-		tsk = get_pid_task(pid, PIDTYPE_PID);
-		if (tsk) {
-			seq_printf(s, "%3d %6d     %6u       %s\n", cws->cpu,
-				   atomic_read(&cws->inserted), cws->executed,
-				   tsk->comm);
-			put_task_struct(tsk);
-		}
-		put_pid(pid);
-	}
+	struct workqueue_pool_stats *ps = p;
+	unsigned int executed;
+	u64 total, max;
+	unsigned long flags;
+	int workers;
+
+	spin_lock_irqsave(&ps->lock, flags);
+	executed = ps->executed;
+	workers = ps->workers;
+	total = ps->latency_total;
+	max = ps->latency_max;
+	spin_unlock_irqrestore(&ps->lock, flags);
+
+	if (ps->cpu < 0)
+		seq_printf(s, "  u");
+	else
+		seq_printf(s, "%3d", ps->cpu);
+	seq_printf(s, "   %8d  %8u  %7d  %11llu  %11llu\n",
+		   atomic_read(&ps->inserted), executed, workers,
+		   executed ? div_u64(total, executed) / NSEC_PER_USEC : 0ULL,
+		   div_u64(max, NSEC_PER_USEC));
 
 	return 0;
 }
 
-static void workqueue_stat_release(void *stat)
-{
-	struct cpu_workqueue_stats *node = stat;
-
-	kref_put(&node->kref, cpu_workqueue_stat_free);
-}
-
 static int workqueue_stat_headers(struct seq_file *s)
 {
-	seq_printf(s, "# CPU  INSERTED  EXECUTED   NAME\n");
-	seq_printf(s, "# |      |         |          |\n");
+	seq_printf(s, "# CPU  INSERTED  EXECUTED  WORKERS  AVG_LAT(us)"
+		      "  MAX_LAT(us)\n");
+	seq_printf(s, "# |      |         |         |         |"
+		      "            |\n");
 	return 0;
 }
 
@@ -234,7 +150,6 @@ struct tracer_stat workqueue_stats __read_mostly = {
 	.stat_start = workqueue_stat_start,
 	.stat_next = workqueue_stat_next,
 	.stat_show = workqueue_stat_show,
-	.stat_release = workqueue_stat_release,
 	.stat_headers = workqueue_stat_headers
 };
 
@@ -250,6 +165,12 @@ int __init stat_workqueue_init(void)
 }
 fs_initcall(stat_workqueue_init);
 
+static void __init pool_stats_init(struct workqueue_pool_stats *ps, int cpu)
+{
+	ps->cpu = cpu;
+	spin_lock_init(&ps->lock);
+}
+
 /*
  * Workqueues are created very early, just after pre-smp initcalls.
  * So we must register our tracepoints at this stage.
@@ -258,6 +179,10 @@ int __init trace_workqueue_early_init(void)
 {
 	int ret, cpu;
 
+	for_each_possible_cpu(cpu)
+		pool_stats_init(pool_stats(cpu), cpu);
+	pool_stats_init(&unbound_pool_stats, -1);
+
 	ret = register_trace_workqueue_insertion(probe_workqueue_insertion);
 	if (ret)
 		goto out;
@@ -274,11 +199,6 @@ int __init trace_workqueue_early_init(void)
 	if (ret)
 		goto no_creation;
 
-	for_each_possible_cpu(cpu) {
-		spin_lock_init(&workqueue_cpu_stat(cpu)->lock);
-		INIT_LIST_HEAD(&workqueue_cpu_stat(cpu)->list);
-	}
-
 	return 0;
 
 no_creation:
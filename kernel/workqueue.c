@@ -14,6 +14,22 @@
  *   Theodore Ts'o <tytso@mit.edu>
  *
  * Made to use alloc_percpu by Christoph Lameter.
+ *
+ * Work items are not run by threads of their workqueue but by shared
+ * pools of workers: each cpu has a normal and an rt pool, and there is
+ * one unbound pool, not tied to any cpu, for singlethreaded workqueues.
+ * A workqueue is a per-cpu set of cpu_workqueue_structs which feed work
+ * items into the pools and limit how many of them can be active at once.
+ *
+ * The workers of a cpu pool are concurrency managed: the scheduler tells
+ * the pool when a worker blocks, and when no worker is left running
+ * while work items are pending, an idle worker is woken up to process
+ * them.  One running worker per cpu is enough to keep the cpu busy; more
+ * are only used when work items block.  Idle workers are kept around for
+ * a while and then destroyed; new ones are created when the last idle
+ * worker starts working.  Workqueues that memory reclaim depends on
+ * have a rescuer thread to guarantee forward progress when new workers
+ * can't be created.
  */
 
 #include <linux/module.h>
@@ -33,24 +49,142 @@
 #include <linux/kallsyms.h>
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
+#include <linux/idr.h>
+#include <linux/hash.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
 
+#include "workqueue_sched.h"
+
+enum {
+	/* pool flags */
+	POOL_MANAGE_WORKERS	= 1 << 0,	/* need to manage workers */
+	POOL_MANAGING_WORKERS	= 1 << 1,	/* managing workers */
+	POOL_DISASSOCIATED	= 1 << 2,	/* not bound to its cpu */
+
+	/* worker flags */
+	WORKER_STARTED		= 1 << 0,	/* started */
+	WORKER_DIE		= 1 << 1,	/* die die die */
+	WORKER_IDLE		= 1 << 2,	/* is idle */
+	WORKER_PREP		= 1 << 3,	/* preparing to run works */
+	WORKER_REBIND		= 1 << 4,	/* must rebind to its cpu */
+	WORKER_UNBOUND		= 1 << 5,	/* may run on any cpu */
+	WORKER_RESCUER		= 1 << 6,	/* rescuer of a workqueue */
+	WORKER_SURPLUS		= 1 << 7,	/* busy when its cpu came up */
+
+	/* workers with any of these don't count in nr_running */
+	WORKER_NOT_RUNNING	= WORKER_IDLE | WORKER_PREP | WORKER_UNBOUND |
+				  WORKER_RESCUER,
+
+	NR_CPU_POOLS		= 2,		/* normal and rt pool */
+
+	BUSY_WORKER_HASH_ORDER	= 6,		/* 64 pointers */
+	BUSY_WORKER_HASH_SIZE	= 1 << BUSY_WORKER_HASH_ORDER,
+
+	MAX_IDLE_WORKERS_RATIO	= 4,		/* 1/4 of busy can be idle */
+	IDLE_WORKER_TIMEOUT	= 300 * HZ,	/* keep idle ones for 5 mins */
+
+	MAYDAY_INITIAL_TIMEOUT	= HZ / 100 >= 2 ? HZ / 100 : 2,
+						/* call for help after 10ms
+						   (min two ticks) */
+	MAYDAY_INTERVAL		= HZ / 10,	/* and then every 100ms */
+	CREATE_COOLDOWN		= HZ,		/* time to breath after fail */
+
+	/* work items of keventd which may be active at once, per cpu */
+	KEVENTD_MAX_ACTIVE	= 256,
+
+	RESCUER_NICE_LEVEL	= -20,
+
+	/* two colors are enough as flushes are serialized */
+	WORK_NR_COLORS		= 2,
+	WORK_NO_COLOR		= (1 << WORK_STRUCT_COLOR_BITS) - 1,
+};
+
+struct worker_pool;
+
 /*
- * The per-CPU workqueue (if single thread, we always use the first
- * possible cpu).
+ * The poor guys doing the actual heavy lifting.  All on-duty workers
+ * are either serving the manager role, on the idle list or on the busy
+ * hash.
  */
-struct cpu_workqueue_struct {
+struct worker {
+	/* on idle list while idle, on busy hash table while busy */
+	union {
+		struct list_head	entry;	/* L: while idle */
+		struct hlist_node	hentry;	/* L: while busy */
+	};
 
-	spinlock_t lock;
+	struct work_struct	*current_work;	/* L: work being processed */
+	struct cpu_workqueue_struct *current_cwq; /* L: current_work's cwq */
+	struct list_head	scheduled;	/* L: scheduled works */
+	struct task_struct	*task;		/* I: worker task */
+	struct worker_pool	*pool;		/* I: the associated pool */
+	struct list_head	node;		/* L: on pool->workers */
+	unsigned long		last_active;	/* L: last active timestamp */
+	unsigned int		flags;		/* X: flags */
+	int			id;		/* I: worker id */
+};
 
-	struct list_head worklist;
-	wait_queue_head_t more_work;
-	struct work_struct *current_work;
+/*
+ * Structure fields follow one of the following exclusion rules.
+ *
+ * I: Set during initialization and read-only afterwards.
+ *
+ * L: pool->lock protected.  Access with pool->lock held.
+ *
+ * X: During normal operation, modification requires pool->lock and
+ *    should be done only from local cpu.  Either disabling preemption
+ *    on local cpu or grabbing pool->lock is enough for read access.
+ *    While the pool is disassociated, only pool->lock is needed.
+ *
+ * F: wq->flush_mutex protected.
+ *
+ * W: workqueue_lock protected.
+ */
+struct worker_pool {
+	spinlock_t		lock;		/* the pool lock */
+	struct list_head	worklist;	/* L: list of pending works */
+	int			cpu;		/* I: the cpu, -1 if unbound */
+	int			rt;		/* I: workers are SCHED_FIFO */
+	unsigned int		flags;		/* L: POOL_* flags */
 
-	struct workqueue_struct *wq;
-	struct task_struct *thread;
-} ____cacheline_aligned;
+	int			nr_workers;	/* L: total number of workers */
+	int			nr_idle;	/* L: currently idle ones */
+
+	/* running workers, see wq_worker_sleeping() */
+	atomic_t		nr_running;
+
+	/* workers are chained either in the idle_list or busy_hash */
+	struct list_head	idle_list;	/* X: list of idle workers */
+	struct hlist_head	busy_hash[BUSY_WORKER_HASH_SIZE];
+						/* L: hash of busy workers */
+	struct list_head	workers;	/* L: all started workers */
+
+	struct timer_list	idle_timer;	/* L: worker idle timeout */
+	struct timer_list	mayday_timer;	/* L: SOS timer for workers */
+
+	struct ida		worker_ida;	/* L: for worker IDs */
+
+	struct worker		*first_idle;	/* L: first idle worker */
+} ____cacheline_aligned_in_smp;
+
+/*
+ * The part of a workqueue on one cpu, or on the first possible cpu if it
+ * is single threaded.  The lower WORK_STRUCT_FLAG_BITS of work->data are
+ * used for flags and thus cwqs need to be aligned at two's power of the
+ * number of flag bits.
+ */
+struct cpu_workqueue_struct {
+	struct worker_pool	*pool;		/* I: the associated pool */
+	struct workqueue_struct *wq;		/* I: the owning workqueue */
+	int			work_color;	/* L: current color */
+	int			flush_color;	/* L: flushing color */
+	int			nr_in_flight[WORK_NR_COLORS];
+						/* L: nr of in_flight works */
+	int			nr_active;	/* L: nr of active works */
+	int			max_active;	/* L: max active works */
+	struct list_head	delayed_works;	/* L: delayed works */
+} __attribute__((aligned(1 << WORK_STRUCT_FLAG_BITS)));
 
 /*
  * The externally visible workqueue abstraction is an array of
@@ -58,7 +192,16 @@ struct cpu_workqueue_struct {
  */
 struct workqueue_struct {
 	struct cpu_workqueue_struct *cpu_wq;
-	struct list_head list;
+	struct list_head list;		/* W: list of all workqueues */
+
+	struct mutex flush_mutex;	/* protects wq flushing */
+	atomic_t nr_cwqs_to_flush;	/* F: flush in progress */
+	struct completion flush_done;	/* F: last cwq flushed */
+
+	cpumask_var_t mayday_mask;	/* cpus requesting rescue */
+	struct worker *rescuer;		/* I: rescue worker */
+
+	int saved_max_active;		/* W: saved cwq max_active */
 	const char *name;
 	int singlethread;
 	int freezeable;		/* Freeze threads during suspend */
@@ -71,19 +214,22 @@ struct workqueue_struct {
 /* Serializes the accesses to the list of workqueues. */
 static DEFINE_SPINLOCK(workqueue_lock);
 static LIST_HEAD(workqueues);
+static bool workqueue_freezing;		/* W: have wqs started freezing? */
+
+static DEFINE_PER_CPU(struct worker_pool [NR_CPU_POOLS], cpu_worker_pools);
+static struct worker_pool unbound_pool;
+
+#define for_each_cpu_pool(pool, cpu)					\
+	for ((pool) = &per_cpu(cpu_worker_pools, (cpu))[0];		\
+	     (pool) < &per_cpu(cpu_worker_pools, (cpu))[NR_CPU_POOLS];	\
+	     (pool)++)
 
 static int singlethread_cpu __read_mostly;
 static const struct cpumask *cpu_singlethread_map __read_mostly;
-/*
- * _cpu_down() first removes CPU from cpu_online_map, then CPU_DEAD
- * flushes cwq->worklist. This means that flush_workqueue/wait_on_work
- * which comes in between can't use for_each_online_cpu(). We could
- * use cpu_possible_map, the cpumask below is more a documentation
- * than optimization.
- */
-static cpumask_var_t cpu_populated_map __read_mostly;
 
-/* If it's single threaded, it isn't in the list of workqueues. */
+static int worker_thread(void *__worker);
+
+/* If it's single threaded, it only has the cwq of singlethread_cpu. */
 static inline int is_wq_single_threaded(struct workqueue_struct *wq)
 {
 	return wq->singlethread;
@@ -92,7 +238,7 @@ static inline int is_wq_single_threaded(struct workqueue_struct *wq)
 static const struct cpumask *wq_cpu_map(struct workqueue_struct *wq)
 {
 	return is_wq_single_threaded(wq)
-		? cpu_singlethread_map : cpu_populated_map;
+		? cpu_singlethread_map : cpu_possible_mask;
 }
 
 static
@@ -103,20 +249,34 @@ struct cpu_workqueue_struct *wq_per_cpu(struct workqueue_struct *wq, int cpu)
 	return per_cpu_ptr(wq->cpu_wq, cpu);
 }
 
+static int work_next_color(int color)
+{
+	return (color + 1) % WORK_NR_COLORS;
+}
+
+static unsigned long work_color_to_flags(int color)
+{
+	return (unsigned long)color << WORK_STRUCT_COLOR_SHIFT;
+}
+
+static int get_work_color(struct work_struct *work)
+{
+	return (*work_data_bits(work) >> WORK_STRUCT_COLOR_SHIFT) &
+		((1 << WORK_STRUCT_COLOR_BITS) - 1);
+}
+
 /*
  * Set the workqueue on which a work item is to be run
  * - Must *only* be called if the pending flag is set
  */
 static inline void set_wq_data(struct work_struct *work,
-				struct cpu_workqueue_struct *cwq)
+			       struct cpu_workqueue_struct *cwq,
+			       unsigned long extra_flags)
 {
-	unsigned long new;
-
 	BUG_ON(!work_pending(work));
 
-	new = (unsigned long) cwq | (1UL << WORK_STRUCT_PENDING);
-	new |= WORK_STRUCT_FLAG_MASK & *work_data_bits(work);
-	atomic_long_set(&work->data, new);
+	atomic_long_set(&work->data, (unsigned long)cwq |
+			(1UL << WORK_STRUCT_PENDING) | extra_flags);
 }
 
 static inline
@@ -125,29 +285,355 @@ struct cpu_workqueue_struct *get_wq_data(struct work_struct *work)
 	return (void *) (atomic_long_read(&work->data) & WORK_STRUCT_WQ_DATA_MASK);
 }
 
+#ifdef CONFIG_WORKQUEUE_TRACER
+static inline void work_set_queued(struct work_struct *work)
+{
+	work->queued_at = cpu_clock(raw_smp_processor_id());
+}
+
+static inline u64 work_latency(struct work_struct *work)
+{
+	s64 delta = cpu_clock(raw_smp_processor_id()) - work->queued_at;
+
+	/* the clocks of two cpus may be off by a bit */
+	return delta > 0 ? delta : 0;
+}
+#else
+static inline void work_set_queued(struct work_struct *work)
+{
+}
+
+static inline u64 work_latency(struct work_struct *work)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Policy functions.  These define the policies on how the pool is
+ * managed.  Unless noted otherwise, these functions assume that they're
+ * being called with pool->lock held.
+ */
+
+static bool __need_more_worker(struct worker_pool *pool)
+{
+	return !atomic_read(&pool->nr_running);
+}
+
+/*
+ * Need to wake up a worker?  Called from anything but currently
+ * running workers.
+ */
+static bool need_more_worker(struct worker_pool *pool)
+{
+	return !list_empty(&pool->worklist) && __need_more_worker(pool);
+}
+
+/* Can I start working?  Called from busy but !running workers. */
+static bool may_start_working(struct worker_pool *pool)
+{
+	return pool->nr_idle;
+}
+
+/* Do I need to keep working?  Called from currently running workers. */
+static bool keep_working(struct worker_pool *pool)
+{
+	return !list_empty(&pool->worklist) &&
+		atomic_read(&pool->nr_running) <= 1;
+}
+
+/*
+ * Do we need a new worker?  Called from manager.  The rt pools keep the
+ * single worker per cpu of the rt workqueue threads they replace:
+ * stop_machine runs from them, and kthreadd can't run to create another
+ * worker while stop_machine spins on the cpus.
+ */
+static bool need_to_create_worker(struct worker_pool *pool)
+{
+	return !pool->rt && need_more_worker(pool) && !may_start_working(pool);
+}
+
+/* Do I need to be the manager? */
+static bool need_to_manage_workers(struct worker_pool *pool)
+{
+	return need_to_create_worker(pool) ||
+		(pool->flags & POOL_MANAGE_WORKERS);
+}
+
+/* Do we have too many workers and should some go away? */
+static bool too_many_workers(struct worker_pool *pool)
+{
+	bool managing = pool->flags & POOL_MANAGING_WORKERS;
+	int nr_idle = pool->nr_idle + managing; /* manager is considered idle */
+	int nr_busy = pool->nr_workers - nr_idle;
+
+	return nr_idle > 2 && (nr_idle - 2) * MAX_IDLE_WORKERS_RATIO >= nr_busy;
+}
+
+/*
+ * Wake up functions.
+ */
+
+/* Return the first worker.  Safe with preemption disabled */
+static struct worker *first_worker(struct worker_pool *pool)
+{
+	if (unlikely(list_empty(&pool->idle_list)))
+		return NULL;
+
+	return list_first_entry(&pool->idle_list, struct worker, entry);
+}
+
+/**
+ * wake_up_worker - wake up an idle worker
+ * @pool: pool to wake worker for
+ *
+ * Wake up the first idle worker of @pool.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
+static void wake_up_worker(struct worker_pool *pool)
+{
+	struct worker *worker = first_worker(pool);
+
+	if (likely(worker))
+		wake_up_process(worker->task);
+}
+
+/**
+ * wq_worker_waking_up - a worker is waking up
+ * @task: task waking up
+ * @cpu: CPU @task is waking up to
+ *
+ * This function is called during try_to_wake_up() when a worker is
+ * being awoken.
+ *
+ * CONTEXT:
+ * spin_lock_irq(rq->lock)
+ */
+void wq_worker_waking_up(struct task_struct *task, unsigned int cpu)
+{
+	struct worker *worker = kthread_data(task);
+
+	if (!(worker->flags & WORKER_NOT_RUNNING))
+		atomic_inc(&worker->pool->nr_running);
+}
+
+/**
+ * wq_worker_sleeping - a worker is going to sleep
+ * @task: task going to sleep
+ * @cpu: CPU in question, must be the current CPU number
+ *
+ * This function is called during schedule() when a busy worker is
+ * going to sleep.  Worker on the same cpu can be woken up by
+ * returning pointer to its task.
+ *
+ * CONTEXT:
+ * spin_lock_irq(rq->lock)
+ *
+ * RETURNS:
+ * Worker task on @cpu to wake up, %NULL if none.
+ */
+struct task_struct *wq_worker_sleeping(struct task_struct *task,
+				       unsigned int cpu)
+{
+	struct worker *worker = kthread_data(task), *to_wakeup = NULL;
+	struct worker_pool *pool = worker->pool;
+
+	if (worker->flags & WORKER_NOT_RUNNING)
+		return NULL;
+
+	/* this can only happen on the local cpu */
+	BUG_ON(cpu != raw_smp_processor_id());
+
+	/*
+	 * The counterpart of the following dec_and_test, implied mb,
+	 * worklist not empty test sequence is in insert_work().
+	 * Please read comment there.
+	 *
+	 * NOT_RUNNING is clear.  This means that the pool is associated
+	 * and we're running on the local cpu w/ rq lock held and
+	 * preemption disabled, which in turn means that none else could
+	 * be manipulating idle_list, so dereferencing idle_list without
+	 * pool->lock is safe.
+	 */
+	if (atomic_dec_and_test(&pool->nr_running) &&
+	    !list_empty(&pool->worklist))
+		to_wakeup = first_worker(pool);
+
+	/* only bound workers can be woken up on the local rq */
+	if (!to_wakeup || (to_wakeup->flags & WORKER_UNBOUND))
+		return NULL;
+	return to_wakeup->task;
+}
+
+/**
+ * worker_set_flags - set worker flags and adjust nr_running accordingly
+ * @worker: self
+ * @flags: flags to set
+ * @wakeup: wakeup an idle worker if necessary
+ *
+ * Set @flags in @worker->flags and adjust nr_running accordingly.  If
+ * nr_running becomes zero and @wakeup is %true, an idle worker is
+ * woken up.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock)
+ */
+static inline void worker_set_flags(struct worker *worker, unsigned int flags,
+				    bool wakeup)
+{
+	struct worker_pool *pool = worker->pool;
+
+	WARN_ON_ONCE(worker->task != current);
+
+	/*
+	 * If transitioning into NOT_RUNNING, adjust nr_running and
+	 * wake up an idle worker as necessary if requested by
+	 * @wakeup.
+	 */
+	if ((flags & WORKER_NOT_RUNNING) &&
+	    !(worker->flags & WORKER_NOT_RUNNING)) {
+		if (wakeup) {
+			if (atomic_dec_and_test(&pool->nr_running) &&
+			    !list_empty(&pool->worklist))
+				wake_up_worker(pool);
+		} else
+			atomic_dec(&pool->nr_running);
+	}
+
+	worker->flags |= flags;
+}
+
+/**
+ * worker_clr_flags - clear worker flags and adjust nr_running accordingly
+ * @worker: self
+ * @flags: flags to clear
+ *
+ * Clear @flags in @worker->flags and adjust nr_running accordingly.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock)
+ */
+static inline void worker_clr_flags(struct worker *worker, unsigned int flags)
+{
+	struct worker_pool *pool = worker->pool;
+	unsigned int oflags = worker->flags;
+
+	WARN_ON_ONCE(worker->task != current);
+
+	worker->flags &= ~flags;
+
+	/* if transitioning out of NOT_RUNNING, increment nr_running */
+	if ((flags & WORKER_NOT_RUNNING) && (oflags & WORKER_NOT_RUNNING))
+		if (!(worker->flags & WORKER_NOT_RUNNING))
+			atomic_inc(&pool->nr_running);
+}
+
+static struct hlist_head *busy_worker_head(struct worker_pool *pool,
+					   struct work_struct *work)
+{
+	return &pool->busy_hash[hash_ptr(work, BUSY_WORKER_HASH_ORDER)];
+}
+
+/**
+ * find_worker_executing_work - find worker which is executing a work
+ * @pool: pool of interest
+ * @work: work to find worker for
+ *
+ * Find a worker which is executing @work on @pool.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ *
+ * RETURNS:
+ * Pointer to worker which is executing @work if found, NULL
+ * otherwise.
+ */
+static struct worker *find_worker_executing_work(struct worker_pool *pool,
+						 struct work_struct *work)
+{
+	struct hlist_head *bwh = busy_worker_head(pool, work);
+	struct hlist_node *tmp;
+	struct worker *worker;
+
+	hlist_for_each_entry(worker, tmp, bwh, hentry)
+		if (worker->current_work == work)
+			return worker;
+	return NULL;
+}
+
+/**
+ * insert_work - insert a work into the pool
+ * @cwq: cwq @work belongs to
+ * @work: work to insert
+ * @head: insertion point
+ * @extra_flags: extra WORK_STRUCT_* flags to set
+ *
+ * Insert @work which belongs to @cwq into the pool after @head.
+ * @extra_flags is or'd to work_struct flags.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
 static void insert_work(struct cpu_workqueue_struct *cwq,
-			struct work_struct *work, struct list_head *head)
+			struct work_struct *work, struct list_head *head,
+			unsigned long extra_flags)
 {
-	trace_workqueue_insertion(cwq->thread, work);
+	struct worker_pool *pool = cwq->pool;
+
+	/* barriers are timestamped and counted too, they are executed */
+	work_set_queued(work);
+	trace_workqueue_insertion(cwq->wq->name, pool->cpu, work);
+
+	/* we own @work, set data and link */
+	set_wq_data(work, cwq, extra_flags);
 
-	set_wq_data(work, cwq);
 	/*
 	 * Ensure that we get the right work->data if we see the
 	 * result of list_add() below, see try_to_grab_pending().
 	 */
 	smp_wmb();
+
 	list_add_tail(&work->entry, head);
-	wake_up(&cwq->more_work);
+
+	/*
+	 * Ensure either wq_worker_sleeping() sees the above
+	 * list_add_tail() or we see zero nr_running to avoid workers
+	 * lying around lazily while there are works to be processed.
+	 */
+	smp_mb();
+
+	if (__need_more_worker(pool))
+		wake_up_worker(pool);
 }
 
-static void __queue_work(struct cpu_workqueue_struct *cwq,
+static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
+	struct cpu_workqueue_struct *cwq = wq_per_cpu(wq, cpu);
+	struct worker_pool *pool = cwq->pool;
+	struct list_head *worklist;
+	unsigned long work_flags;
 	unsigned long flags;
 
-	spin_lock_irqsave(&cwq->lock, flags);
-	insert_work(cwq, work, &cwq->worklist);
-	spin_unlock_irqrestore(&cwq->lock, flags);
+	spin_lock_irqsave(&pool->lock, flags);
+	BUG_ON(!list_empty(&work->entry));
+
+	cwq->nr_in_flight[cwq->work_color]++;
+	work_flags = work_color_to_flags(cwq->work_color);
+
+	if (likely(cwq->nr_active < cwq->max_active)) {
+		cwq->nr_active++;
+		worklist = &pool->worklist;
+	} else {
+		work_flags |= 1UL << WORK_STRUCT_DELAYED;
+		worklist = &cwq->delayed_works;
+	}
+
+	insert_work(cwq, work, worklist, work_flags);
+
+	spin_unlock_irqrestore(&pool->lock, flags);
 }
 
 /**
@@ -188,8 +674,7 @@ queue_work_on(int cpu, struct workqueue_struct *wq, struct work_struct *work)
 	int ret = 0;
 
 	if (!test_and_set_bit(WORK_STRUCT_PENDING, work_data_bits(work))) {
-		BUG_ON(!list_empty(&work->entry));
-		__queue_work(wq_per_cpu(wq, cpu), work);
+		__queue_work(cpu, wq, work);
 		ret = 1;
 	}
 	return ret;
@@ -200,9 +685,8 @@ static void delayed_work_timer_fn(unsigned long __data)
 {
 	struct delayed_work *dwork = (struct delayed_work *)__data;
 	struct cpu_workqueue_struct *cwq = get_wq_data(&dwork->work);
-	struct workqueue_struct *wq = cwq->wq;
 
-	__queue_work(wq_per_cpu(wq, smp_processor_id()), &dwork->work);
+	__queue_work(smp_processor_id(), cwq->wq, &dwork->work);
 }
 
 /**
@@ -246,7 +730,7 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		timer_stats_timer_set_start_info(&dwork->timer);
 
 		/* This stores cwq for the moment, for the timer_fn */
-		set_wq_data(work, wq_per_cpu(wq, raw_smp_processor_id()));
+		set_wq_data(work, wq_per_cpu(wq, raw_smp_processor_id()), 0);
 		timer->expires = jiffies + delay;
 		timer->data = (unsigned long)dwork;
 		timer->function = delayed_work_timer_fn;
@@ -261,79 +745,857 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 }
 EXPORT_SYMBOL_GPL(queue_delayed_work_on);
 
-static void run_workqueue(struct cpu_workqueue_struct *cwq)
+/**
+ * worker_enter_idle - enter idle state
+ * @worker: worker which is entering idle state
+ *
+ * @worker is entering idle state.  Update stats and idle timer if
+ * necessary.
+ *
+ * LOCKING:
+ * spin_lock_irq(pool->lock).
+ */
+static void worker_enter_idle(struct worker *worker)
 {
-	spin_lock_irq(&cwq->lock);
-	while (!list_empty(&cwq->worklist)) {
-		struct work_struct *work = list_entry(cwq->worklist.next,
-						struct work_struct, entry);
-		work_func_t f = work->func;
-#ifdef CONFIG_LOCKDEP
+	struct worker_pool *pool = worker->pool;
+
+	BUG_ON(worker->flags & WORKER_IDLE);
+	BUG_ON(!list_empty(&worker->entry) &&
+	       (worker->hentry.next || worker->hentry.pprev));
+
+	/* can't use worker_set_flags(), also called from start_worker() */
+	worker->flags |= WORKER_IDLE;
+	pool->nr_idle++;
+	worker->last_active = jiffies;
+
+	/* idle_list is LIFO */
+	list_add(&worker->entry, &pool->idle_list);
+
+	if (too_many_workers(pool) && !timer_pending(&pool->idle_timer))
+		mod_timer(&pool->idle_timer, jiffies + IDLE_WORKER_TIMEOUT);
+
+	/* sanity check nr_running */
+	WARN_ON_ONCE(pool->nr_workers == pool->nr_idle &&
+		     atomic_read(&pool->nr_running));
+}
+
+/**
+ * worker_leave_idle - leave idle state
+ * @worker: worker which is leaving idle state
+ *
+ * @worker is leaving idle state.  Update stats.
+ *
+ * LOCKING:
+ * spin_lock_irq(pool->lock).
+ */
+static void worker_leave_idle(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	BUG_ON(!(worker->flags & WORKER_IDLE));
+	worker_clr_flags(worker, WORKER_IDLE);
+	pool->nr_idle--;
+	list_del_init(&worker->entry);
+}
+
+/**
+ * worker_rebind - bind a worker back to the cpu of its pool
+ * @worker: self
+ *
+ * The cpu of @worker's pool came back online while @worker was busy.
+ * Move to the cpu and take part in concurrency management again, unless
+ * the cpu went away again in the meantime.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock) which may be released and regrabbed
+ * multiple times.
+ */
+static void worker_rebind(struct worker *worker)
+__releases(&pool->lock)
+__acquires(&pool->lock)
+{
+	struct worker_pool *pool = worker->pool;
+	int ret;
+
+	while (worker->flags & WORKER_REBIND) {
+		worker->flags &= ~WORKER_REBIND;
+		if (pool->flags & POOL_DISASSOCIATED)
+			return;
+
+		spin_unlock_irq(&pool->lock);
+		ret = set_cpus_allowed_ptr(current, cpumask_of(pool->cpu));
+		spin_lock_irq(&pool->lock);
+
+		/* the cpu may have gone down and up again meanwhile */
+		if (ret || (pool->flags & POOL_DISASSOCIATED) ||
+		    (worker->flags & WORKER_REBIND))
+			continue;
+
+		current->flags |= PF_THREAD_BOUND;
+		worker_clr_flags(worker, WORKER_UNBOUND);
+	}
+}
+
+static struct worker *alloc_worker(void)
+{
+	struct worker *worker;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL);
+	if (worker) {
+		INIT_LIST_HEAD(&worker->entry);
+		INIT_LIST_HEAD(&worker->scheduled);
+		INIT_LIST_HEAD(&worker->node);
+		/* on creation a worker is in !idle && prep state */
+		worker->flags = WORKER_PREP;
+	}
+	return worker;
+}
+
+/**
+ * create_worker - create a new workqueue worker
+ * @pool: pool the new worker will belong to
+ * @bind: whether to bind the worker to the cpu of @pool or not
+ *
+ * Create a new worker which is bound to @pool.  The returned worker
+ * can be started by calling start_worker() or destroyed using
+ * destroy_worker().
+ *
+ * CONTEXT:
+ * Might sleep.  Does GFP_KERNEL allocations.
+ *
+ * RETURNS:
+ * Pointer to the newly created worker.
+ */
+static struct worker *create_worker(struct worker_pool *pool, bool bind)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+	struct worker *worker = NULL;
+	int id = -1;
+
+	spin_lock_irq(&pool->lock);
+	while (ida_get_new(&pool->worker_ida, &id)) {
+		spin_unlock_irq(&pool->lock);
+		if (!ida_pre_get(&pool->worker_ida, GFP_KERNEL))
+			goto fail;
+		spin_lock_irq(&pool->lock);
+	}
+	spin_unlock_irq(&pool->lock);
+
+	worker = alloc_worker();
+	if (!worker)
+		goto fail;
+
+	worker->pool = pool;
+	worker->id = id;
+
+	if (pool->cpu < 0)
+		worker->task = kthread_create(worker_thread, worker,
+					      "kworker/u:%d", id);
+	else
+		worker->task = kthread_create(worker_thread, worker,
+					      "kworker/%d:%d%s", pool->cpu, id,
+					      pool->rt ? "H" : "");
+	if (IS_ERR(worker->task))
+		goto fail;
+
+	if (pool->rt)
+		sched_setscheduler_nocheck(worker->task, SCHED_FIFO, &param);
+
+	if (bind)
+		kthread_bind(worker->task, pool->cpu);
+	else
+		worker->flags |= WORKER_UNBOUND;
+
+	trace_workqueue_creation(worker->task, pool->cpu);
+
+	return worker;
+fail:
+	if (id >= 0) {
+		spin_lock_irq(&pool->lock);
+		ida_remove(&pool->worker_ida, id);
+		spin_unlock_irq(&pool->lock);
+	}
+	kfree(worker);
+	return NULL;
+}
+
+/**
+ * start_worker - start a newly created worker
+ * @worker: worker to start
+ *
+ * Make the pool aware of @worker and start it.  A worker created for a
+ * cpu that went down meanwhile runs unbound, one created unbound for a
+ * cpu that came up binds itself when it starts.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
+static void start_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	worker->flags |= WORKER_STARTED;
+	pool->nr_workers++;
+	list_add_tail(&worker->node, &pool->workers);
+
+	if (pool->flags & POOL_DISASSOCIATED)
+		worker->flags |= WORKER_UNBOUND;
+	else if (worker->flags & WORKER_UNBOUND)
+		worker->flags |= WORKER_REBIND;
+
+	worker_enter_idle(worker);
+	wake_up_process(worker->task);
+}
+
+/**
+ * destroy_worker - destroy an idle workqueue worker
+ * @worker: worker to be destroyed
+ *
+ * Tell an idle worker to go away; it removes itself from the pool and
+ * frees itself when it wakes up.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
+static void destroy_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	/* sanity check frenzy */
+	BUG_ON(worker->current_work);
+	BUG_ON(!list_empty(&worker->scheduled));
+	BUG_ON(!(worker->flags & WORKER_IDLE));
+
+	pool->nr_workers--;
+	pool->nr_idle--;
+	list_del_init(&worker->entry);
+	worker->flags |= WORKER_DIE;
+	wake_up_process(worker->task);
+}
+
+/*
+ * Destroy a worker which was created but never started.  Can only be
+ * used while nobody else can see the worker.
+ */
+static void free_unstarted_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	kthread_stop(worker->task);
+	trace_workqueue_destruction(worker->task, pool->cpu);
+
+	spin_lock_irq(&pool->lock);
+	ida_remove(&pool->worker_ida, worker->id);
+	spin_unlock_irq(&pool->lock);
+	kfree(worker);
+}
+
+static void idle_worker_timeout(unsigned long __pool)
+{
+	struct worker_pool *pool = (void *)__pool;
+
+	spin_lock_irq(&pool->lock);
+
+	if (too_many_workers(pool)) {
+		struct worker *worker;
+		unsigned long expires;
+
+		/* idle_list is kept in LIFO order, check the last one */
+		worker = list_entry(pool->idle_list.prev, struct worker, entry);
+		expires = worker->last_active + IDLE_WORKER_TIMEOUT;
+
+		if (time_before(jiffies, expires))
+			mod_timer(&pool->idle_timer, expires);
+		else {
+			/* it's been idle for too long, wake up manager */
+			pool->flags |= POOL_MANAGE_WORKERS;
+			wake_up_worker(pool);
+		}
+	}
+
+	spin_unlock_irq(&pool->lock);
+}
+
+static bool send_mayday(struct work_struct *work)
+{
+	struct cpu_workqueue_struct *cwq = get_wq_data(work);
+	struct workqueue_struct *wq = cwq->wq;
+	int cpu;
+
+	if (!wq->rescuer)
+		return false;
+
+	/* the cwq of a singlethread workqueue is the one of its cpu */
+	cpu = cwq->pool->cpu;
+	if (cpu < 0)
+		cpu = singlethread_cpu;
+	if (!cpumask_test_and_set_cpu(cpu, wq->mayday_mask))
+		wake_up_process(wq->rescuer->task);
+	return true;
+}
+
+static void pool_mayday_timeout(unsigned long __pool)
+{
+	struct worker_pool *pool = (void *)__pool;
+	struct work_struct *work;
+
+	spin_lock_irq(&pool->lock);
+
+	if (need_to_create_worker(pool)) {
 		/*
-		 * It is permissible to free the struct work_struct
-		 * from inside the function that is called from it,
-		 * this we need to take into account for lockdep too.
-		 * To avoid bogus "held lock freed" warnings as well
-		 * as problems when looking into work->lockdep_map,
-		 * make a copy and use that here.
+		 * We've been trying to create a new worker but
+		 * haven't been successful.  We might be hitting an
+		 * allocation deadlock.  Send distress signals to
+		 * rescuers.
 		 */
-		struct lockdep_map lockdep_map = work->lockdep_map;
+		list_for_each_entry(work, &pool->worklist, entry)
+			send_mayday(work);
+	}
+
+	spin_unlock_irq(&pool->lock);
+
+	mod_timer(&pool->mayday_timer, jiffies + MAYDAY_INTERVAL);
+}
+
+/**
+ * maybe_create_worker - create a new worker if necessary
+ * @pool: pool to create a new worker for
+ *
+ * Create a new worker for @pool if necessary.  @pool is guaranteed to
+ * have at least one idle worker on return from this function.  If
+ * creating a new worker takes longer than MAYDAY_INITIAL_TIMEOUT,
+ * mayday is sent to all rescuers with works scheduled on @pool to
+ * resolve possible allocation deadlock.
+ *
+ * On return, need_to_create_worker() is guaranteed to be false and
+ * may_start_working() true.
+ *
+ * LOCKING:
+ * spin_lock_irq(pool->lock) which may be released and regrabbed
+ * multiple times.  Does GFP_KERNEL allocations.  Called only from
+ * manager.
+ *
+ * RETURNS:
+ * false if no action was taken and pool->lock stayed locked, true
+ * otherwise.
+ */
+static bool maybe_create_worker(struct worker_pool *pool)
+__releases(&pool->lock)
+__acquires(&pool->lock)
+{
+	if (!need_to_create_worker(pool))
+		return false;
+restart:
+	spin_unlock_irq(&pool->lock);
+
+	/* if we don't make progress in MAYDAY_INITIAL_TIMEOUT, call for help */
+	mod_timer(&pool->mayday_timer, jiffies + MAYDAY_INITIAL_TIMEOUT);
+
+	while (true) {
+		struct worker *worker;
+
+		worker = create_worker(pool, !(pool->flags &
+					       POOL_DISASSOCIATED));
+		if (worker) {
+			del_timer_sync(&pool->mayday_timer);
+			spin_lock_irq(&pool->lock);
+			start_worker(worker);
+			BUG_ON(need_to_create_worker(pool));
+			return true;
+		}
+
+		if (!need_to_create_worker(pool))
+			break;
+
+		__set_current_state(TASK_INTERRUPTIBLE);
+		schedule_timeout(CREATE_COOLDOWN);
+
+		if (!need_to_create_worker(pool))
+			break;
+	}
+
+	del_timer_sync(&pool->mayday_timer);
+	spin_lock_irq(&pool->lock);
+	if (need_to_create_worker(pool))
+		goto restart;
+	return true;
+}
+
+/**
+ * maybe_destroy_workers - destroy workers which have been idle for a while
+ * @pool: pool to destroy workers for
+ *
+ * Destroy @pool workers which have been idle for longer than
+ * IDLE_WORKER_TIMEOUT.
+ *
+ * LOCKING:
+ * spin_lock_irq(pool->lock).  Called only from manager.
+ *
+ * RETURNS:
+ * false if no action was taken, true otherwise.
+ */
+static bool maybe_destroy_workers(struct worker_pool *pool)
+{
+	bool ret = false;
+
+	while (too_many_workers(pool)) {
+		struct worker *worker;
+		unsigned long expires;
+
+		worker = list_entry(pool->idle_list.prev, struct worker, entry);
+		expires = worker->last_active + IDLE_WORKER_TIMEOUT;
+
+		if (time_before(jiffies, expires)) {
+			mod_timer(&pool->idle_timer, expires);
+			break;
+		}
+
+		destroy_worker(worker);
+		ret = true;
+	}
+
+	return ret;
+}
+
+/**
+ * manage_workers - manage worker pool
+ * @worker: self
+ *
+ * Assume the manager role and manage the pool @worker belongs to.
+ * At any given time, there can be only zero or one manager per pool.
+ *
+ * The manager role is claimed by a worker which is about to start
+ * working or going to sleep, so the pool always has a worker to
+ * process the work items queued to it.
+ *
+ * LOCKING:
+ * spin_lock_irq(pool->lock) which may be released and regrabbed
+ * multiple times.  Does GFP_KERNEL allocations.
+ *
+ * RETURNS:
+ * false if no action was taken and pool->lock stayed locked, true if
+ * some action was taken.
+ */
+static bool manage_workers(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+	bool ret = false;
+
+	if (pool->flags & POOL_MANAGING_WORKERS)
+		return ret;
+
+	pool->flags &= ~POOL_MANAGE_WORKERS;
+	pool->flags |= POOL_MANAGING_WORKERS;
+
+	/*
+	 * Destroy and then create so that may_start_working() is true
+	 * on return.
+	 */
+	ret |= maybe_destroy_workers(pool);
+	ret |= maybe_create_worker(pool);
+
+	pool->flags &= ~POOL_MANAGING_WORKERS;
+
+	return ret;
+}
+
+/**
+ * move_linked_works - move linked works to a list
+ * @work: start of series of works to be scheduled
+ * @head: target list to append @work to
+ * @nextp: out paramter for nested worklist walking
+ *
+ * Schedule linked works starting from @work to @head.  Work series to
+ * be scheduled starts at @work and includes any consecutive work with
+ * WORK_STRUCT_LINKED set in its predecessor.
+ *
+ * If @nextp is not NULL, it's updated to point to the next work of
+ * the last scheduled work.  This allows move_linked_works() to be
+ * nested inside outer list_for_each_entry_safe().
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
+static void move_linked_works(struct work_struct *work, struct list_head *head,
+			      struct work_struct **nextp)
+{
+	struct work_struct *n;
+
+	/*
+	 * Linked worklist will always end before the end of the list,
+	 * use NULL for list head.
+	 */
+	list_for_each_entry_safe_from(work, n, NULL, entry) {
+		list_move_tail(&work->entry, head);
+		if (!test_bit(WORK_STRUCT_LINKED, work_data_bits(work)))
+			break;
+	}
+
+	/*
+	 * If we're already inside safe list traversal and have moved
+	 * multiple works to the scheduled queue, the next position
+	 * needs to be updated.
+	 */
+	if (nextp)
+		*nextp = n;
+}
+
+static void cwq_activate_first_delayed(struct cpu_workqueue_struct *cwq)
+{
+	struct work_struct *work = list_first_entry(&cwq->delayed_works,
+						    struct work_struct, entry);
+
+	move_linked_works(work, &cwq->pool->worklist, NULL);
+	__clear_bit(WORK_STRUCT_DELAYED, work_data_bits(work));
+	cwq->nr_active++;
+
+	if (__need_more_worker(cwq->pool))
+		wake_up_worker(cwq->pool);
+}
+
+/**
+ * cwq_dec_nr_in_flight - decrement cwq's nr_in_flight
+ * @cwq: cwq of interest
+ * @color: color of work which left the queue
+ * @delayed: for a delayed work
+ *
+ * A work either has completed or is removed from pending queue,
+ * decrement nr_in_flight of its cwq and handle workqueue flushing.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
+static void cwq_dec_nr_in_flight(struct cpu_workqueue_struct *cwq, int color,
+				 bool delayed)
+{
+	/* ignore uncolored works */
+	if (color == WORK_NO_COLOR)
+		return;
+
+	cwq->nr_in_flight[color]--;
+
+	if (!delayed) {
+		cwq->nr_active--;
+		if (!list_empty(&cwq->delayed_works)) {
+			/* one down, submit a delayed one */
+			if (cwq->nr_active < cwq->max_active)
+				cwq_activate_first_delayed(cwq);
+		}
+	}
+
+	/* is flush in progress and are we at the flushing tip? */
+	if (likely(cwq->flush_color != color))
+		return;
+
+	/* are there still in-flight works? */
+	if (cwq->nr_in_flight[color])
+		return;
+
+	/* this cwq is done, clear flush_color */
+	cwq->flush_color = -1;
+
+	/* if this was the last cwq, wake up the flusher */
+	if (atomic_dec_and_test(&cwq->wq->nr_cwqs_to_flush))
+		complete(&cwq->wq->flush_done);
+}
+
+/**
+ * process_one_work - process single work
+ * @worker: self
+ * @work: work to process
+ *
+ * Process @work.  This function contains all the logics necessary to
+ * process a single work including synchronization against and
+ * interaction with other workers on the same cpu, queueing and
+ * flushing.  As long as context requirement is met, any worker can
+ * call this function to process a work.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock) which is released and regrabbed.
+ */
+static void process_one_work(struct worker *worker, struct work_struct *work)
+__releases(&pool->lock)
+__acquires(&pool->lock)
+{
+	struct cpu_workqueue_struct *cwq = get_wq_data(work);
+	struct worker_pool *pool = worker->pool;
+	work_func_t f = work->func;
+	struct worker *collision;
+	int work_color;
+#ifdef CONFIG_LOCKDEP
+	/*
+	 * It is permissible to free the struct work_struct
+	 * from inside the function that is called from it,
+	 * this we need to take into account for lockdep too.
+	 * To avoid bogus "held lock freed" warnings as well
+	 * as problems when looking into work->lockdep_map,
+	 * make a copy and use that here.
+	 */
+	struct lockdep_map lockdep_map = work->lockdep_map;
 #endif
-		trace_workqueue_execution(cwq->thread, work);
-		cwq->current_work = work;
-		list_del_init(cwq->worklist.next);
-		spin_unlock_irq(&cwq->lock);
-
-		BUG_ON(get_wq_data(work) != cwq);
-		work_clear_pending(work);
-		lock_map_acquire(&cwq->wq->lockdep_map);
-		lock_map_acquire(&lockdep_map);
-		f(work);
-		lock_map_release(&lockdep_map);
-		lock_map_release(&cwq->wq->lockdep_map);
-
-		if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
-			printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
-					"%s/0x%08x/%d\n",
-					current->comm, preempt_count(),
-				       	task_pid_nr(current));
-			printk(KERN_ERR "    last function: ");
-			print_symbol("%s\n", (unsigned long)f);
-			debug_show_held_locks(current);
-			dump_stack();
+	/*
+	 * A single work shouldn't be executed concurrently by
+	 * multiple workers of a pool.  Check whether anyone is
+	 * already processing the work.  If so, defer the work to the
+	 * currently executing one.
+	 */
+	collision = find_worker_executing_work(pool, work);
+	if (unlikely(collision)) {
+		move_linked_works(work, &collision->scheduled, NULL);
+		return;
+	}
+
+	/* claim and process */
+	hlist_add_head(&worker->hentry, busy_worker_head(pool, work));
+	worker->current_work = work;
+	worker->current_cwq = cwq;
+	work_color = get_work_color(work);
+
+	list_del_init(&work->entry);
+
+	/*
+	 * Wake up another worker if necessary.  The condition is always
+	 * false for the bound workers of a cpu pool since nr_running
+	 * would always be >= 1 at this point.  This chains execution of
+	 * the pending work items for workers which aren't concurrency
+	 * managed, as the ones of the unbound pool.
+	 */
+	if (need_more_worker(pool))
+		wake_up_worker(pool);
+
+	trace_workqueue_execution(cwq->wq->name, pool->cpu, work,
+				  work_latency(work));
+	spin_unlock_irq(&pool->lock);
+
+	BUG_ON(get_wq_data(work) != cwq);
+	work_clear_pending(work);
+	lock_map_acquire(&cwq->wq->lockdep_map);
+	lock_map_acquire(&lockdep_map);
+	f(work);
+	lock_map_release(&lockdep_map);
+	lock_map_release(&cwq->wq->lockdep_map);
+
+	if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
+		printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
+				"%s/0x%08x/%d\n",
+				current->comm, preempt_count(),
+			       	task_pid_nr(current));
+		printk(KERN_ERR "    last function: ");
+		print_symbol("%s\n", (unsigned long)f);
+		debug_show_held_locks(current);
+		dump_stack();
+	}
+
+	spin_lock_irq(&pool->lock);
+
+	/* we're done with it, release */
+	hlist_del_init(&worker->hentry);
+	worker->current_work = NULL;
+	worker->current_cwq = NULL;
+	cwq_dec_nr_in_flight(cwq, work_color, false);
+}
+
+/**
+ * process_scheduled_works - process scheduled works
+ * @worker: self
+ *
+ * Process all scheduled works.  Please note that the scheduled list
+ * may change while processing a work, so this function repeatedly
+ * fetches a work from the top and executes it.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock) which may be released and regrabbed
+ * multiple times.
+ */
+static void process_scheduled_works(struct worker *worker)
+{
+	while (!list_empty(&worker->scheduled)) {
+		struct work_struct *work = list_first_entry(&worker->scheduled,
+						struct work_struct, entry);
+		process_one_work(worker, work);
+	}
+}
+
+/**
+ * worker_thread - the worker thread function
+ * @__worker: self
+ *
+ * The worker thread function.  There are NR_CPU_POOLS pools of workers
+ * per cpu and the unbound pool.  Work items are processed by whichever
+ * worker of the pool is available; the pool keeps one running worker
+ * per cpu and wakes up another one when it blocks.
+ */
+static int worker_thread(void *__worker)
+{
+	struct worker *worker = __worker;
+	struct worker_pool *pool = worker->pool;
+
+	/* tell the scheduler that this is a workqueue worker */
+	current->flags |= PF_WQ_WORKER;
+woke_up:
+	spin_lock_irq(&pool->lock);
+
+	/* DIE can be set only while we're idle, checking here is enough */
+	if (unlikely(worker->flags & WORKER_DIE)) {
+		list_del(&worker->node);
+		ida_remove(&pool->worker_ida, worker->id);
+		current->flags &= ~PF_WQ_WORKER;
+		spin_unlock_irq(&pool->lock);
+
+		trace_workqueue_destruction(current, pool->cpu);
+		kfree(worker);
+		return 0;
+	}
+
+	worker_leave_idle(worker);
+recheck:
+	/* our cpu came back while we were away from it? */
+	if (unlikely(worker->flags & WORKER_REBIND))
+		worker_rebind(worker);
+
+	/* no more worker necessary? */
+	if (!need_more_worker(pool))
+		goto sleep;
+
+	/* do we need to manage? */
+	if (unlikely(!may_start_working(pool)) && manage_workers(worker))
+		goto recheck;
+
+	/*
+	 * ->scheduled list can only be filled while a worker is
+	 * preparing to process a work or actually processing it.
+	 * Make sure nobody diddled with it while I was sleeping.
+	 */
+	BUG_ON(!list_empty(&worker->scheduled));
+
+	/*
+	 * When control reaches this point, we're guaranteed to have
+	 * at least one idle worker or that someone else has already
+	 * assumed the manager role.
+	 */
+	worker_clr_flags(worker, WORKER_PREP);
+
+	do {
+		struct work_struct *work =
+			list_first_entry(&pool->worklist,
+					 struct work_struct, entry);
+
+		if (likely(!test_bit(WORK_STRUCT_LINKED,
+				     work_data_bits(work)))) {
+			/* optimization path, not strictly necessary */
+			process_one_work(worker, work);
+			if (unlikely(!list_empty(&worker->scheduled)))
+				process_scheduled_works(worker);
+		} else {
+			move_linked_works(work, &worker->scheduled, NULL);
+			process_scheduled_works(worker);
 		}
+	} while (keep_working(pool) && !(worker->flags & WORKER_REBIND));
+
+	worker_set_flags(worker, WORKER_PREP, false);
+
+	if (unlikely(worker->flags & WORKER_REBIND))
+		goto recheck;
+sleep:
+	if (unlikely(need_to_manage_workers(pool)) && manage_workers(worker))
+		goto recheck;
+
+	/*
+	 * pool->lock is held and there's no work to process and no
+	 * need to manage, sleep.  Workers are woken up only while
+	 * holding pool->lock or from local cpu, so setting the
+	 * current state before releasing pool->lock is enough to
+	 * prevent losing any event.
+	 */
+	worker_enter_idle(worker);
 
-		spin_lock_irq(&cwq->lock);
-		cwq->current_work = NULL;
+	/*
+	 * The pool got a fresh worker when its cpu came back; once done
+	 * with the works it had then, this one goes away unless it is
+	 * the only idle worker left.
+	 */
+	if (unlikely(worker->flags & WORKER_SURPLUS)) {
+		worker->flags &= ~WORKER_SURPLUS;
+		if (pool->nr_idle > 1) {
+			destroy_worker(worker);
+			spin_unlock_irq(&pool->lock);
+			goto woke_up;
+		}
 	}
-	spin_unlock_irq(&cwq->lock);
+
+	__set_current_state(TASK_INTERRUPTIBLE);
+	spin_unlock_irq(&pool->lock);
+	schedule();
+	goto woke_up;
 }
 
-static int worker_thread(void *__cwq)
+/**
+ * rescuer_thread - the rescuer thread function
+ * @__wq: the associated workqueue
+ *
+ * Workqueue rescuer thread function.  There's one rescuer for each
+ * workqueue created with create_*rescuer_workqueue().
+ *
+ * Regular work processing on a pool may block trying to create a new
+ * worker which uses GFP_KERNEL allocation which has slight chance of
+ * developing into deadlock if some works currently on the same queue
+ * need to be processed to satisfy the GFP_KERNEL allocation.  This is
+ * the problem rescuer solves.
+ *
+ * When such condition is possible, the pool summons rescuers of all
+ * workqueues which have works queued on the pool and let them process
+ * those works so that forward progress can be guaranteed.
+ *
+ * This should happen rarely.
+ */
+static int rescuer_thread(void *__wq)
 {
-	struct cpu_workqueue_struct *cwq = __cwq;
-	DEFINE_WAIT(wait);
+	struct workqueue_struct *wq = __wq;
+	struct worker *rescuer = wq->rescuer;
+	struct list_head *scheduled = &rescuer->scheduled;
+	int cpu;
+
+	if (!wq->rt)
+		set_user_nice(current, RESCUER_NICE_LEVEL);
+repeat:
+	set_current_state(TASK_INTERRUPTIBLE);
 
-	if (cwq->wq->freezeable)
-		set_freezable();
+	if (kthread_should_stop()) {
+		__set_current_state(TASK_RUNNING);
+		return 0;
+	}
 
-	for (;;) {
-		prepare_to_wait(&cwq->more_work, &wait, TASK_INTERRUPTIBLE);
-		if (!freezing(current) &&
-		    !kthread_should_stop() &&
-		    list_empty(&cwq->worklist))
-			schedule();
-		finish_wait(&cwq->more_work, &wait);
+	/* see whether any cpu is asking for help */
+	for_each_cpu(cpu, wq->mayday_mask) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+		struct worker_pool *pool = cwq->pool;
+		struct work_struct *work, *n;
 
-		try_to_freeze();
+		__set_current_state(TASK_RUNNING);
+		cpumask_clear_cpu(cpu, wq->mayday_mask);
 
-		if (kthread_should_stop())
-			break;
+		/* migrate to the target cpu if possible */
+		rescuer->pool = pool;
+		if (pool->cpu < 0 ||
+		    set_cpus_allowed_ptr(current, cpumask_of(pool->cpu)))
+			set_cpus_allowed_ptr(current, cpu_all_mask);
+		spin_lock_irq(&pool->lock);
+
+		/*
+		 * Slurp in all works issued via this workqueue and
+		 * process'em.
+		 */
+		BUG_ON(!list_empty(&rescuer->scheduled));
+		list_for_each_entry_safe(work, n, &pool->worklist, entry)
+			if (get_wq_data(work) == cwq)
+				move_linked_works(work, scheduled, &n);
 
-		run_workqueue(cwq);
+		process_scheduled_works(rescuer);
+		spin_unlock_irq(&pool->lock);
 	}
 
-	return 0;
+	schedule();
+	goto repeat;
 }
 
 struct wq_barrier {
@@ -347,35 +1609,58 @@ static void wq_barrier_func(struct work_struct *work)
 	complete(&barr->done);
 }
 
+/**
+ * insert_wq_barrier - insert a barrier work
+ * @cwq: cwq to insert barrier into
+ * @barr: wq_barrier to insert
+ * @target: target work to attach @barr to
+ * @worker: worker currently executing @target, NULL if @target is not executing
+ *
+ * @barr is linked to @target such that @barr is completed only after
+ * @target finishes execution.  Please note that the ordering
+ * guarantee is observed only with respect to @target and on the local
+ * cpu.
+ *
+ * Currently, a queued barrier can't be canceled.  This is because
+ * try_to_grab_pending() can't determine whether the work to be
+ * grabbed is at the head of the queue and thus can't clear LINKED
+ * flag of the previous work while there must be a valid next work
+ * after a work with LINKED flag set.
+ *
+ * The barrier is uncolored and doesn't count as active, so it is
+ * neither waited for by flush_workqueue() nor limited by max_active.
+ *
+ * CONTEXT:
+ * spin_lock_irq(pool->lock).
+ */
 static void insert_wq_barrier(struct cpu_workqueue_struct *cwq,
-			struct wq_barrier *barr, struct list_head *head)
+			      struct wq_barrier *barr,
+			      struct work_struct *target, struct worker *worker)
 {
+	struct list_head *head;
+	unsigned long linked = 0;
+
 	INIT_WORK(&barr->work, wq_barrier_func);
 	__set_bit(WORK_STRUCT_PENDING, work_data_bits(&barr->work));
-
 	init_completion(&barr->done);
 
-	insert_work(cwq, &barr->work, head);
-}
-
-static int flush_cpu_workqueue(struct cpu_workqueue_struct *cwq)
-{
-	int active = 0;
-	struct wq_barrier barr;
-
-	WARN_ON(cwq->thread == current);
-
-	spin_lock_irq(&cwq->lock);
-	if (!list_empty(&cwq->worklist) || cwq->current_work != NULL) {
-		insert_wq_barrier(cwq, &barr, &cwq->worklist);
-		active = 1;
+	/*
+	 * If @target is currently being executed, schedule the
+	 * barrier to the worker; otherwise, put it after @target.
+	 */
+	if (worker)
+		head = worker->scheduled.next;
+	else {
+		unsigned long *bits = work_data_bits(target);
+
+		head = target->entry.next;
+		/* there can already be other linked works, inherit and set */
+		linked = *bits & (1UL << WORK_STRUCT_LINKED);
+		__set_bit(WORK_STRUCT_LINKED, bits);
 	}
-	spin_unlock_irq(&cwq->lock);
-
-	if (active)
-		wait_for_completion(&barr.done);
 
-	return active;
+	insert_work(cwq, &barr->work, head,
+		    work_color_to_flags(WORK_NO_COLOR) | linked);
 }
 
 /**
@@ -386,10 +1671,8 @@ static int flush_cpu_workqueue(struct cpu_workqueue_struct *cwq)
  * This is typically used in driver shutdown handlers.
  *
  * We sleep until all works which were queued on entry have been handled,
- * but we are not livelocked by new incoming ones.
- *
- * This function used to run the workqueues itself.  Now we just wait for the
- * helper threads to do it.
+ * but we are not livelocked by new incoming ones: works queued after the
+ * flush started get the other color and are not waited for.
  */
 void flush_workqueue(struct workqueue_struct *wq)
 {
@@ -399,8 +1682,33 @@ void flush_workqueue(struct workqueue_struct *wq)
 	might_sleep();
 	lock_map_acquire(&wq->lockdep_map);
 	lock_map_release(&wq->lockdep_map);
-	for_each_cpu(cpu, cpu_map)
-		flush_cpu_workqueue(per_cpu_ptr(wq->cpu_wq, cpu));
+
+	mutex_lock(&wq->flush_mutex);
+
+	INIT_COMPLETION(wq->flush_done);
+	/* bias, so that the completion can't fire before all cwqs are seen */
+	atomic_set(&wq->nr_cwqs_to_flush, 1);
+
+	for_each_cpu(cpu, cpu_map) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+		struct worker_pool *pool = cwq->pool;
+
+		spin_lock_irq(&pool->lock);
+
+		BUG_ON(cwq->flush_color != -1);
+		if (cwq->nr_in_flight[cwq->work_color]) {
+			cwq->flush_color = cwq->work_color;
+			atomic_inc(&wq->nr_cwqs_to_flush);
+		}
+		cwq->work_color = work_next_color(cwq->work_color);
+
+		spin_unlock_irq(&pool->lock);
+	}
+
+	if (!atomic_dec_and_test(&wq->nr_cwqs_to_flush))
+		wait_for_completion(&wq->flush_done);
+
+	mutex_unlock(&wq->flush_mutex);
 }
 EXPORT_SYMBOL_GPL(flush_workqueue);
 
@@ -416,20 +1724,21 @@ EXPORT_SYMBOL_GPL(flush_workqueue);
  */
 int flush_work(struct work_struct *work)
 {
+	struct worker *worker = NULL;
 	struct cpu_workqueue_struct *cwq;
-	struct list_head *prev;
+	struct worker_pool *pool;
 	struct wq_barrier barr;
 
 	might_sleep();
 	cwq = get_wq_data(work);
 	if (!cwq)
 		return 0;
+	pool = cwq->pool;
 
 	lock_map_acquire(&cwq->wq->lockdep_map);
 	lock_map_release(&cwq->wq->lockdep_map);
 
-	prev = NULL;
-	spin_lock_irq(&cwq->lock);
+	spin_lock_irq(&pool->lock);
 	if (!list_empty(&work->entry)) {
 		/*
 		 * See the comment near try_to_grab_pending()->smp_rmb().
@@ -437,21 +1746,20 @@ int flush_work(struct work_struct *work)
 		 */
 		smp_rmb();
 		if (unlikely(cwq != get_wq_data(work)))
-			goto out;
-		prev = &work->entry;
+			goto already_gone;
 	} else {
-		if (cwq->current_work != work)
-			goto out;
-		prev = &cwq->worklist;
+		worker = find_worker_executing_work(pool, work);
+		if (!worker || worker->current_cwq != cwq)
+			goto already_gone;
 	}
-	insert_wq_barrier(cwq, &barr, prev->next);
-out:
-	spin_unlock_irq(&cwq->lock);
-	if (!prev)
-		return 0;
 
+	insert_wq_barrier(cwq, &barr, work, worker);
+	spin_unlock_irq(&pool->lock);
 	wait_for_completion(&barr.done);
 	return 1;
+already_gone:
+	spin_unlock_irq(&pool->lock);
+	return 0;
 }
 EXPORT_SYMBOL_GPL(flush_work);
 
@@ -462,6 +1770,7 @@ EXPORT_SYMBOL_GPL(flush_work);
 static int try_to_grab_pending(struct work_struct *work)
 {
 	struct cpu_workqueue_struct *cwq;
+	struct worker_pool *pool;
 	int ret = -1;
 
 	if (!test_and_set_bit(WORK_STRUCT_PENDING, work_data_bits(work)))
@@ -475,8 +1784,9 @@ static int try_to_grab_pending(struct work_struct *work)
 	cwq = get_wq_data(work);
 	if (!cwq)
 		return ret;
+	pool = cwq->pool;
 
-	spin_lock_irq(&cwq->lock);
+	spin_lock_irq(&pool->lock);
 	if (!list_empty(&work->entry)) {
 		/*
 		 * This work is queued, but perhaps we locked the wrong cwq.
@@ -486,10 +1796,12 @@ static int try_to_grab_pending(struct work_struct *work)
 		smp_rmb();
 		if (cwq == get_wq_data(work)) {
 			list_del_init(&work->entry);
+			cwq_dec_nr_in_flight(cwq, get_work_color(work),
+				*work_data_bits(work) & (1UL << WORK_STRUCT_DELAYED));
 			ret = 1;
 		}
 	}
-	spin_unlock_irq(&cwq->lock);
+	spin_unlock_irq(&pool->lock);
 
 	return ret;
 }
@@ -497,17 +1809,21 @@ static int try_to_grab_pending(struct work_struct *work)
 static void wait_on_cpu_work(struct cpu_workqueue_struct *cwq,
 				struct work_struct *work)
 {
+	struct worker_pool *pool = cwq->pool;
 	struct wq_barrier barr;
-	int running = 0;
+	struct worker *worker;
 
-	spin_lock_irq(&cwq->lock);
-	if (unlikely(cwq->current_work == work)) {
-		insert_wq_barrier(cwq, &barr, cwq->worklist.next);
-		running = 1;
-	}
-	spin_unlock_irq(&cwq->lock);
+	spin_lock_irq(&pool->lock);
 
-	if (unlikely(running))
+	worker = find_worker_executing_work(pool, work);
+	if (unlikely(worker && worker->current_cwq == cwq))
+		insert_wq_barrier(cwq, &barr, work, worker);
+	else
+		worker = NULL;
+
+	spin_unlock_irq(&pool->lock);
+
+	if (unlikely(worker))
 		wait_for_completion(&barr.done);
 }
 
@@ -648,9 +1964,8 @@ EXPORT_SYMBOL(schedule_delayed_work);
 void flush_delayed_work(struct delayed_work *dwork)
 {
 	if (del_timer_sync(&dwork->timer)) {
-		struct cpu_workqueue_struct *cwq;
-		cwq = wq_per_cpu(keventd_wq, get_cpu());
-		__queue_work(cwq, &dwork->work);
+		__queue_work(get_cpu(), get_wq_data(&dwork->work)->wq,
+			     &dwork->work);
 		put_cpu();
 	}
 	flush_work(&dwork->work);
@@ -685,7 +2000,6 @@ EXPORT_SYMBOL(schedule_delayed_work_on);
 int schedule_on_each_cpu(work_func_t func)
 {
 	int cpu;
-	int orig = -1;
 	struct work_struct *works;
 
 	works = alloc_percpu(struct work_struct);
@@ -694,23 +2008,12 @@ int schedule_on_each_cpu(work_func_t func)
 
 	get_online_cpus();
 
-	/*
-	 * When running in keventd don't schedule a work item on
-	 * itself.  Can just call directly because the work queue is
-	 * already bound.  This also is faster.
-	 */
-	if (current_is_keventd())
-		orig = raw_smp_processor_id();
-
 	for_each_online_cpu(cpu) {
 		struct work_struct *work = per_cpu_ptr(works, cpu);
 
 		INIT_WORK(work, func);
-		if (cpu != orig)
-			schedule_work_on(cpu, work);
+		schedule_work_on(cpu, work);
 	}
-	if (orig >= 0)
-		func(per_cpu_ptr(works, orig));
 
 	for_each_online_cpu(cpu)
 		flush_work(per_cpu_ptr(works, cpu));
@@ -759,92 +2062,56 @@ int keventd_up(void)
 
 int current_is_keventd(void)
 {
-	struct cpu_workqueue_struct *cwq;
-	int cpu = raw_smp_processor_id(); /* preempt-safe: keventd is per-cpu */
-	int ret = 0;
+	struct worker *worker;
 
 	BUG_ON(!keventd_wq);
 
-	cwq = per_cpu_ptr(keventd_wq->cpu_wq, cpu);
-	if (current == cwq->thread)
-		ret = 1;
-
-	return ret;
-
-}
-
-static struct cpu_workqueue_struct *
-init_cpu_workqueue(struct workqueue_struct *wq, int cpu)
-{
-	struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
-
-	cwq->wq = wq;
-	spin_lock_init(&cwq->lock);
-	INIT_LIST_HEAD(&cwq->worklist);
-	init_waitqueue_head(&cwq->more_work);
-
-	return cwq;
-}
-
-static int create_workqueue_thread(struct cpu_workqueue_struct *cwq, int cpu)
-{
-	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
-	struct workqueue_struct *wq = cwq->wq;
-	const char *fmt = is_wq_single_threaded(wq) ? "%s" : "%s/%d";
-	struct task_struct *p;
-
-	p = kthread_create(worker_thread, cwq, fmt, wq->name, cpu);
-	/*
-	 * Nobody can add the work_struct to this cwq,
-	 *	if (caller is __create_workqueue)
-	 *		nobody should see this wq
-	 *	else // caller is CPU_UP_PREPARE
-	 *		cpu is not on cpu_online_map
-	 * so we can abort safely.
-	 */
-	if (IS_ERR(p))
-		return PTR_ERR(p);
-	if (cwq->wq->rt)
-		sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
-	cwq->thread = p;
-
-	trace_workqueue_creation(cwq->thread, cpu);
+	if (!(current->flags & PF_WQ_WORKER))
+		return 0;
 
-	return 0;
+	worker = kthread_data(current);
+	return worker->current_cwq && worker->current_cwq->wq == keventd_wq;
 }
 
-static void start_workqueue_thread(struct cpu_workqueue_struct *cwq, int cpu)
+/*
+ * The pool the works of @wq queued on @cpu are processed by:
+ * singlethreaded workqueues use the unbound pool, or the rt pool of
+ * singlethread_cpu, others the normal or rt pool of @cpu.
+ */
+static struct worker_pool *wq_pool(struct workqueue_struct *wq, int cpu)
 {
-	struct task_struct *p = cwq->thread;
-
-	if (p != NULL) {
-		if (cpu >= 0)
-			kthread_bind(p, cpu);
-		wake_up_process(p);
+	if (is_wq_single_threaded(wq)) {
+		if (!wq->rt)
+			return &unbound_pool;
+		cpu = singlethread_cpu;
 	}
+	return &per_cpu(cpu_worker_pools, cpu)[wq->rt ? 1 : 0];
 }
 
-struct workqueue_struct *__create_workqueue_key(const char *name,
-						int singlethread,
-						int freezeable,
-						int rt,
-						struct lock_class_key *key,
-						const char *lock_name)
+static struct workqueue_struct *__alloc_workqueue(const char *name,
+						  int singlethread,
+						  int freezeable,
+						  int rt,
+						  int max_active,
+						  bool rescuer,
+						  struct lock_class_key *key,
+						  const char *lock_name)
 {
 	struct workqueue_struct *wq;
-	struct cpu_workqueue_struct *cwq;
-	int err = 0, cpu;
+	int cpu;
 
 	wq = kzalloc(sizeof(*wq), GFP_KERNEL);
 	if (!wq)
 		return NULL;
 
 	wq->cpu_wq = alloc_percpu(struct cpu_workqueue_struct);
-	if (!wq->cpu_wq) {
-		kfree(wq);
-		return NULL;
-	}
+	if (!wq->cpu_wq)
+		goto err;
 
+	wq->saved_max_active = max_active;
+	mutex_init(&wq->flush_mutex);
+	atomic_set(&wq->nr_cwqs_to_flush, 0);
+	init_completion(&wq->flush_done);
 	wq->name = name;
 	lockdep_init_map(&wq->lockdep_map, lock_name, key, 0);
 	wq->singlethread = singlethread;
@@ -852,72 +2119,87 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 	wq->rt = rt;
 	INIT_LIST_HEAD(&wq->list);
 
-	if (singlethread) {
-		cwq = init_cpu_workqueue(wq, singlethread_cpu);
-		err = create_workqueue_thread(cwq, singlethread_cpu);
-		start_workqueue_thread(cwq, -1);
-	} else {
-		cpu_maps_update_begin();
-		/*
-		 * We must place this wq on list even if the code below fails.
-		 * cpu_down(cpu) can remove cpu from cpu_populated_map before
-		 * destroy_workqueue() takes the lock, in that case we leak
-		 * cwq[cpu]->thread.
-		 */
-		spin_lock(&workqueue_lock);
-		list_add(&wq->list, &workqueues);
-		spin_unlock(&workqueue_lock);
-		/*
-		 * We must initialize cwqs for each possible cpu even if we
-		 * are going to call destroy_workqueue() finally. Otherwise
-		 * cpu_up() can hit the uninitialized cwq once we drop the
-		 * lock.
-		 */
-		for_each_possible_cpu(cpu) {
-			cwq = init_cpu_workqueue(wq, cpu);
-			if (err || !cpu_online(cpu))
-				continue;
-			err = create_workqueue_thread(cwq, cpu);
-			start_workqueue_thread(cwq, cpu);
-		}
-		cpu_maps_update_done();
+	/*
+	 * Initialize the cwqs of all possible cpus, the works queued on
+	 * a cpu that is offline are processed by the unbound workers of
+	 * its pools.
+	 */
+	for_each_possible_cpu(cpu) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+
+		BUG_ON((unsigned long)cwq & WORK_STRUCT_FLAG_MASK);
+		cwq->pool = wq_pool(wq, cpu);
+		cwq->wq = wq;
+		cwq->flush_color = -1;
+		cwq->max_active = max_active;
+		INIT_LIST_HEAD(&cwq->delayed_works);
 	}
 
-	if (err) {
-		destroy_workqueue(wq);
-		wq = NULL;
+	if (rescuer) {
+		struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+		struct worker *worker;
+
+		if (!alloc_cpumask_var(&wq->mayday_mask, GFP_KERNEL))
+			goto err;
+		cpumask_clear(wq->mayday_mask);
+
+		wq->rescuer = worker = alloc_worker();
+		if (!worker)
+			goto err;
+		worker->flags = WORKER_RESCUER;
+
+		worker->task = kthread_create(rescuer_thread, wq, "%s", name);
+		if (IS_ERR(worker->task))
+			goto err;
+		if (rt)
+			sched_setscheduler_nocheck(worker->task, SCHED_FIFO,
+						   &param);
+		wake_up_process(worker->task);
 	}
-	return wq;
-}
-EXPORT_SYMBOL_GPL(__create_workqueue_key);
 
-static void cleanup_workqueue_thread(struct cpu_workqueue_struct *cwq)
-{
 	/*
-	 * Our caller is either destroy_workqueue() or CPU_POST_DEAD,
-	 * cpu_add_remove_lock protects cwq->thread.
+	 * workqueue_lock protects the list and, while the workqueues are
+	 * frozen, max_active of the freezeable ones.
 	 */
-	if (cwq->thread == NULL)
-		return;
+	spin_lock(&workqueue_lock);
 
-	lock_map_acquire(&cwq->wq->lockdep_map);
-	lock_map_release(&cwq->wq->lockdep_map);
+	if (workqueue_freezing && freezeable)
+		for_each_possible_cpu(cpu)
+			per_cpu_ptr(wq->cpu_wq, cpu)->max_active = 0;
 
-	flush_cpu_workqueue(cwq);
-	/*
-	 * If the caller is CPU_POST_DEAD and cwq->worklist was not empty,
-	 * a concurrent flush_workqueue() can insert a barrier after us.
-	 * However, in that case run_workqueue() won't return and check
-	 * kthread_should_stop() until it flushes all work_struct's.
-	 * When ->worklist becomes empty it is safe to exit because no
-	 * more work_structs can be queued on this cwq: flush_workqueue
-	 * checks list_empty(), and a "normal" queue_work() can't use
-	 * a dead CPU.
-	 */
-	trace_workqueue_destruction(cwq->thread);
-	kthread_stop(cwq->thread);
-	cwq->thread = NULL;
+	list_add(&wq->list, &workqueues);
+
+	spin_unlock(&workqueue_lock);
+
+	return wq;
+err:
+	if (wq) {
+		free_percpu(wq->cpu_wq);
+		free_cpumask_var(wq->mayday_mask);
+		kfree(wq->rescuer);
+		kfree(wq);
+	}
+	return NULL;
+}
+
+/*
+ * Workqueues created through create_workqueue() and friends run one work
+ * item at a time per cpu, as their threads did.  Only those created with
+ * @rescuer, by create_*rescuer_workqueue(), have a rescuer: they may be
+ * used on the memory reclaim path.
+ */
+struct workqueue_struct *__create_workqueue_key(const char *name,
+						int singlethread,
+						int freezeable,
+						int rt,
+						int rescuer,
+						struct lock_class_key *key,
+						const char *lock_name)
+{
+	return __alloc_workqueue(name, singlethread, freezeable, rt, 1,
+				 rescuer, key, lock_name);
 }
+EXPORT_SYMBOL_GPL(__create_workqueue_key);
 
 /**
  * destroy_workqueue - safely terminate a workqueue
@@ -927,71 +2209,274 @@ static void cleanup_workqueue_thread(struct cpu_workqueue_struct *cwq)
  */
 void destroy_workqueue(struct workqueue_struct *wq)
 {
-	const struct cpumask *cpu_map = wq_cpu_map(wq);
 	int cpu;
 
-	cpu_maps_update_begin();
+	flush_workqueue(wq);
+
+	/*
+	 * wq list is used to freeze wq, remove from list after
+	 * flushing is complete in case freeze races us.
+	 */
 	spin_lock(&workqueue_lock);
 	list_del(&wq->list);
 	spin_unlock(&workqueue_lock);
 
-	for_each_cpu(cpu, cpu_map)
-		cleanup_workqueue_thread(per_cpu_ptr(wq->cpu_wq, cpu));
- 	cpu_maps_update_done();
+	/* sanity check */
+	for_each_cpu(cpu, wq_cpu_map(wq)) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+		int i;
+
+		for (i = 0; i < WORK_NR_COLORS; i++)
+			BUG_ON(cwq->nr_in_flight[i]);
+		BUG_ON(cwq->nr_active);
+		BUG_ON(!list_empty(&cwq->delayed_works));
+	}
+
+	if (wq->rescuer) {
+		kthread_stop(wq->rescuer->task);
+		kfree(wq->rescuer);
+	}
 
+	free_cpumask_var(wq->mayday_mask);
 	free_percpu(wq->cpu_wq);
 	kfree(wq);
 }
 EXPORT_SYMBOL_GPL(destroy_workqueue);
 
+#ifdef CONFIG_FREEZER
+
+/**
+ * freeze_workqueues_begin - begin freezing workqueues
+ *
+ * Start freezing workqueues.  After this function returns, all
+ * freezeable workqueues will queue new works to their delayed_works
+ * list instead of the pool's worklist.
+ *
+ * CONTEXT:
+ * Grabs and releases workqueue_lock and pool->lock's.
+ */
+void freeze_workqueues_begin(void)
+{
+	struct workqueue_struct *wq;
+	int cpu;
+
+	spin_lock(&workqueue_lock);
+
+	BUG_ON(workqueue_freezing);
+	workqueue_freezing = true;
+
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!wq->freezeable)
+			continue;
+
+		for_each_cpu(cpu, wq_cpu_map(wq)) {
+			struct cpu_workqueue_struct *cwq;
+
+			cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+			spin_lock_irq(&cwq->pool->lock);
+			cwq->max_active = 0;
+			spin_unlock_irq(&cwq->pool->lock);
+		}
+	}
+
+	spin_unlock(&workqueue_lock);
+}
+
+/**
+ * freeze_workqueues_busy - are freezeable workqueues still busy?
+ *
+ * Check whether freezing is complete.  This function must be called
+ * between freeze_workqueues_begin() and thaw_workqueues().
+ *
+ * CONTEXT:
+ * Grabs and releases workqueue_lock.
+ *
+ * RETURNS:
+ * %true if some freezeable workqueues are still busy.  %false if
+ * freezing is complete.
+ */
+bool freeze_workqueues_busy(void)
+{
+	struct workqueue_struct *wq;
+	bool busy = false;
+	int cpu;
+
+	spin_lock(&workqueue_lock);
+
+	BUG_ON(!workqueue_freezing);
+
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!wq->freezeable)
+			continue;
+
+		for_each_cpu(cpu, wq_cpu_map(wq)) {
+			/*
+			 * nr_active is monotonically decreasing.  It's
+			 * safe to peek without lock.
+			 */
+			if (per_cpu_ptr(wq->cpu_wq, cpu)->nr_active) {
+				busy = true;
+				goto out_unlock;
+			}
+		}
+	}
+out_unlock:
+	spin_unlock(&workqueue_lock);
+	return busy;
+}
+
+/**
+ * thaw_workqueues - thaw workqueues
+ *
+ * Thaw workqueues.  Normal queueing is restored and all collected
+ * frozen works are transferred to their respective pool worklists.
+ *
+ * CONTEXT:
+ * Grabs and releases workqueue_lock and pool->lock's.
+ */
+void thaw_workqueues(void)
+{
+	struct workqueue_struct *wq;
+	int cpu;
+
+	spin_lock(&workqueue_lock);
+
+	if (!workqueue_freezing)
+		goto out_unlock;
+
+	list_for_each_entry(wq, &workqueues, list) {
+		if (!wq->freezeable)
+			continue;
+
+		for_each_cpu(cpu, wq_cpu_map(wq)) {
+			struct cpu_workqueue_struct *cwq;
+
+			cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+			spin_lock_irq(&cwq->pool->lock);
+
+			/* restore max_active and repopulate worklist */
+			cwq->max_active = wq->saved_max_active;
+
+			while (!list_empty(&cwq->delayed_works) &&
+			       cwq->nr_active < cwq->max_active)
+				cwq_activate_first_delayed(cwq);
+
+			spin_unlock_irq(&cwq->pool->lock);
+		}
+	}
+
+	workqueue_freezing = false;
+out_unlock:
+	spin_unlock(&workqueue_lock);
+}
+#endif /* CONFIG_FREEZER */
+
+/*
+ * Throw away the workers created for a cpu that didn't come up, or the
+ * ones that were created before failing to create the others.
+ */
+static void __devinit discard_first_idle(unsigned int cpu)
+{
+	struct worker_pool *pool;
+
+	for_each_cpu_pool(pool, cpu) {
+		if (pool->first_idle) {
+			free_unstarted_worker(pool->first_idle);
+			pool->first_idle = NULL;
+		}
+	}
+}
+
 static int __devinit workqueue_cpu_callback(struct notifier_block *nfb,
 						unsigned long action,
 						void *hcpu)
 {
 	unsigned int cpu = (unsigned long)hcpu;
-	struct cpu_workqueue_struct *cwq;
-	struct workqueue_struct *wq;
-	int ret = NOTIFY_OK;
+	struct worker_pool *pool;
+	struct worker *worker;
 
 	action &= ~CPU_TASKS_FROZEN;
 
 	switch (action) {
 	case CPU_UP_PREPARE:
-		cpumask_set_cpu(cpu, cpu_populated_map);
-	}
-undo:
-	list_for_each_entry(wq, &workqueues, list) {
-		cwq = per_cpu_ptr(wq->cpu_wq, cpu);
-
-		switch (action) {
-		case CPU_UP_PREPARE:
-			if (!create_workqueue_thread(cwq, cpu))
-				break;
-			printk(KERN_ERR "workqueue [%s] for %i failed\n",
-				wq->name, cpu);
-			action = CPU_UP_CANCELED;
-			ret = NOTIFY_BAD;
-			goto undo;
-
-		case CPU_ONLINE:
-			start_workqueue_thread(cwq, cpu);
-			break;
-
-		case CPU_UP_CANCELED:
-			start_workqueue_thread(cwq, -1);
-		case CPU_POST_DEAD:
-			cleanup_workqueue_thread(cwq);
-			break;
+		/*
+		 * The pools are still disassociated: the new workers are
+		 * bound to the cpu but not started until it is online.
+		 */
+		for_each_cpu_pool(pool, cpu) {
+			BUG_ON(pool->first_idle);
+			pool->first_idle = create_worker(pool, true);
+			if (!pool->first_idle) {
+				printk(KERN_ERR "workqueue: failed to create "
+				       "worker for cpu %u\n", cpu);
+				discard_first_idle(cpu);
+				return NOTIFY_BAD;
+			}
 		}
-	}
+		break;
 
-	switch (action) {
 	case CPU_UP_CANCELED:
-	case CPU_POST_DEAD:
-		cpumask_clear_cpu(cpu, cpu_populated_map);
+		discard_first_idle(cpu);
+		break;
+
+	case CPU_DYING:
+		/*
+		 * Called on the dying cpu with irqs disabled.  Its workers
+		 * are about to be migrated: they run unbound from now on,
+		 * and without concurrency management, until the cpu comes
+		 * back.
+		 */
+		for_each_cpu_pool(pool, cpu) {
+			spin_lock(&pool->lock);
+			pool->flags |= POOL_DISASSOCIATED;
+			list_for_each_entry(worker, &pool->workers, node)
+				worker->flags |= WORKER_UNBOUND;
+			atomic_set(&pool->nr_running, 0);
+			spin_unlock(&pool->lock);
+		}
+		break;
+
+	case CPU_DEAD:
+		/* the pending works are now run from the other cpus */
+		for_each_cpu_pool(pool, cpu) {
+			spin_lock_irq(&pool->lock);
+			if (need_more_worker(pool))
+				wake_up_worker(pool);
+			spin_unlock_irq(&pool->lock);
+		}
+		break;
+
+	case CPU_DOWN_FAILED:
+	case CPU_ONLINE:
+		/*
+		 * Every pool starts again from the worker created for the
+		 * cpu.  Idle unbound workers go away, the busy ones rebind
+		 * themselves once they are done with their current work,
+		 * and go away too once idle if first_idle still is.
+		 */
+		for_each_cpu_pool(pool, cpu) {
+			spin_lock_irq(&pool->lock);
+			pool->flags &= ~POOL_DISASSOCIATED;
+			list_for_each_entry(worker, &pool->workers, node) {
+				if (!(worker->flags & WORKER_UNBOUND) ||
+				    (worker->flags & WORKER_DIE))
+					continue;
+				if (worker->flags & WORKER_IDLE)
+					destroy_worker(worker);
+				else
+					worker->flags |= WORKER_REBIND |
+							 WORKER_SURPLUS;
+			}
+			if (pool->first_idle) {
+				start_worker(pool->first_idle);
+				pool->first_idle = NULL;
+			}
+			spin_unlock_irq(&pool->lock);
+		}
+		break;
 	}
 
-	return ret;
+	return NOTIFY_OK;
 }
 
 #ifdef CONFIG_SMP
@@ -1041,14 +2526,70 @@ long work_on_cpu(unsigned int cpu, long (*fn)(void *), void *arg)
 EXPORT_SYMBOL_GPL(work_on_cpu);
 #endif /* CONFIG_SMP */
 
+static void __init init_worker_pool(struct worker_pool *pool, int cpu, int rt)
+{
+	int i;
+
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->worklist);
+	pool->cpu = cpu;
+	pool->rt = rt;
+	atomic_set(&pool->nr_running, 0);
+
+	INIT_LIST_HEAD(&pool->idle_list);
+	for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&pool->busy_hash[i]);
+	INIT_LIST_HEAD(&pool->workers);
+
+	init_timer_deferrable(&pool->idle_timer);
+	pool->idle_timer.function = idle_worker_timeout;
+	pool->idle_timer.data = (unsigned long)pool;
+
+	setup_timer(&pool->mayday_timer, pool_mayday_timeout,
+		    (unsigned long)pool);
+
+	ida_init(&pool->worker_ida);
+}
+
+static void __init start_first_worker(struct worker_pool *pool, bool bind)
+{
+	struct worker *worker;
+
+	worker = create_worker(pool, bind);
+	BUG_ON(!worker);
+	spin_lock_irq(&pool->lock);
+	start_worker(worker);
+	spin_unlock_irq(&pool->lock);
+}
+
 void __init init_workqueues(void)
 {
-	alloc_cpumask_var(&cpu_populated_map, GFP_KERNEL);
+	static struct lock_class_key keventd_key;
+	struct worker_pool *pool;
+	unsigned int cpu;
 
-	cpumask_copy(cpu_populated_map, cpu_online_mask);
 	singlethread_cpu = cpumask_first(cpu_possible_mask);
 	cpu_singlethread_map = cpumask_of(singlethread_cpu);
 	hotcpu_notifier(workqueue_cpu_callback, 0);
-	keventd_wq = create_workqueue("events");
+
+	/* the pools of offline cpus stay disassociated until they come up */
+	for_each_possible_cpu(cpu) {
+		for_each_cpu_pool(pool, cpu) {
+			init_worker_pool(pool, cpu,
+					 pool != per_cpu(cpu_worker_pools, cpu));
+			if (!cpu_online(cpu))
+				pool->flags |= POOL_DISASSOCIATED;
+		}
+	}
+	init_worker_pool(&unbound_pool, -1, 0);
+	unbound_pool.flags |= POOL_DISASSOCIATED;
+
+	for_each_online_cpu(cpu)
+		for_each_cpu_pool(pool, cpu)
+			start_first_worker(pool, true);
+	start_first_worker(&unbound_pool, false);
+
+	keventd_wq = __alloc_workqueue("events", 0, 0, 0, KEVENTD_MAX_ACTIVE,
+				       false, &keventd_key, "events");
 	BUG_ON(!keventd_wq);
 }
@@ -0,0 +1,10 @@
+/*
+ * kernel/workqueue_sched.h
+ *
+ * Scheduler hooks for the concurrency management of workqueue workers.
+ * Only to be included from sched.c and workqueue.c.
+ */
+
+void wq_worker_waking_up(struct task_struct *task, unsigned int cpu);
+struct task_struct *wq_worker_sleeping(struct task_struct *task,
+				       unsigned int cpu);
@@ -43,7 +43,42 @@
 # define tobe(x) (x)
 #endif
 
+#ifdef CONFIG_CRC32_BOOT_TABLES
+#include "crc32gen.h"
+
+/*
+ * Generated by crc32_init_tables() instead of being built into the
+ * image, already converted to the byte order crc32_body() expects.
+ */
+static u32 crc32table_le_rw[LE_TABLE_ROWS][256] ____cacheline_aligned;
+static u32 crc32table_be_rw[BE_TABLE_ROWS][256] ____cacheline_aligned;
+static u32 crc32ctable_le_rw[LE_TABLE_ROWS][256] ____cacheline_aligned;
+
+#define crc32table_le	((const u32 (*)[256])crc32table_le_rw)
+#define crc32table_be	((const u32 (*)[256])crc32table_be_rw)
+#define crc32ctable_le	((const u32 (*)[256])crc32ctable_le_rw)
+
+static void __init crc32_init_tables(void)
+{
+	int i, j;
+
+	crc32init_le_generic(CRCPOLY_LE, crc32table_le_rw);
+	crc32init_le_generic(CRC32C_POLY_LE, crc32ctable_le_rw);
+	crc32init_be_generic(CRCPOLY_BE, crc32table_be_rw);
+
+	for (i = 0; i < LE_TABLE_ROWS; i++) {
+		for (j = 0; j < LE_TABLE_SIZE; j++) {
+			crc32table_le_rw[i][j] = tole(crc32table_le_rw[i][j]);
+			crc32ctable_le_rw[i][j] = tole(crc32ctable_le_rw[i][j]);
+		}
+	}
+	for (i = 0; i < BE_TABLE_ROWS; i++)
+		for (j = 0; j < BE_TABLE_SIZE; j++)
+			crc32table_be_rw[i][j] = tobe(crc32table_be_rw[i][j]);
+}
+#else
 #include "crc32table.h"
+#endif
 
 MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Various CRC32 calculations");
@@ -990,6 +1025,7 @@ static struct crc_test {
 };
 
 #include <linux/time.h>
+#include <linux/math64.h>
 
 static int __init crc32c_test(void)
 {
@@ -1033,7 +1069,7 @@ static int __init crc32c_test(void)
 	pr_info("crc32c: CRC_LE_BITS = %d\n", CRC_LE_BITS);
 
 	if (errors)
-		pr_warn("crc32c: %d self tests failed\n", errors);
+		pr_warning("crc32c: %d self tests failed\n", errors);
 	else {
 		pr_info("crc32c: self tests passed, processed %d bytes in %lld nsec\n",
 			bytes, nsec);
@@ -1092,7 +1128,7 @@ static int __init crc32_test(void)
 		 CRC_LE_BITS, CRC_BE_BITS);
 
 	if (errors)
-		pr_warn("crc32: %d self tests failed\n", errors);
+		pr_warning("crc32: %d self tests failed\n", errors);
 	else {
 		pr_info("crc32: self tests passed, processed %d bytes in %lld nsec\n",
 			bytes, nsec);
@@ -1101,10 +1137,74 @@ static int __init crc32_test(void)
 	return 0;
 }
 
-static int __init crc32test_init(void)
+/*
+ * Throughput of each CRC flavour on aligned buffers of a few typical
+ * sizes: a small network header, a 512 byte sector and a 4KB page.
+ */
+static const size_t crc32_bench_sizes[] = { 64, 512, 4096 };
+
+static const struct {
+	const char *name;
+	u32 (*fn)(u32 crc, unsigned char const *p, size_t len);
+} crc32_bench_fns[] = {
+	{ "crc32_le",	crc32_le },
+	{ "crc32_be",	crc32_be },
+	{ "crc32c_le",	__crc32c_le },
+};
+
+#define CRC32_BENCH_BYTES	(256 * 1024)
+
+static void __init crc32_bench(void)
+{
+	struct timespec start, stop;
+	unsigned long flags;
+	unsigned int loops;
+	u64 nsec;
+	int f, s, i;
+
+	/* keep static so the loop isn't optimized away */
+	static u32 crc;
+
+	for (f = 0; f < ARRAY_SIZE(crc32_bench_fns); f++) {
+		for (s = 0; s < ARRAY_SIZE(crc32_bench_sizes); s++) {
+			loops = CRC32_BENCH_BYTES / crc32_bench_sizes[s];
+
+			/* pre-warm the cache */
+			crc ^= crc32_bench_fns[f].fn(crc, test_buf,
+						     crc32_bench_sizes[s]);
+
+			local_irq_save(flags);
+			getnstimeofday(&start);
+			for (i = 0; i < loops; i++)
+				crc = crc32_bench_fns[f].fn(crc, test_buf,
+							    crc32_bench_sizes[s]);
+			getnstimeofday(&stop);
+			local_irq_restore(flags);
+
+			nsec = stop.tv_nsec - start.tv_nsec +
+				1000000000ULL * (stop.tv_sec - start.tv_sec);
+
+			/* bytes per nsec * 1000 == MB/s */
+			pr_info("crc32: %-9s %4zu byte buffers: %llu MB/s\n",
+				crc32_bench_fns[f].name, crc32_bench_sizes[s],
+				nsec ? div64_u64((u64)CRC32_BENCH_BYTES * 1000,
+						 nsec) : 0ULL);
+		}
+	}
+}
+#endif /* CONFIG_CRC32_SELFTEST */
+
+#if defined(CONFIG_CRC32_BOOT_TABLES) || defined(CONFIG_CRC32_SELFTEST)
+static int __init crc32_init(void)
 {
+#ifdef CONFIG_CRC32_BOOT_TABLES
+	crc32_init_tables();
+#endif
+#ifdef CONFIG_CRC32_SELFTEST
 	crc32_test();
 	crc32c_test();
+	crc32_bench();
+#endif
 	return 0;
 }
 
@@ -1112,6 +1212,7 @@ static void __exit crc32_exit(void)
 {
 }
 
-module_init(crc32test_init);
+/* Early enough for every user of the tables when built in. */
+core_initcall(crc32_init);
 module_exit(crc32_exit);
-#endif /* CONFIG_CRC32_SELFTEST */
+#endif
@@ -0,0 +1,78 @@
+/*
+ * CRC32 lookup table generation, shared by the gen_crc32table host
+ * program and, with CONFIG_CRC32_BOOT_TABLES, by crc32.c at boot.
+ *
+ * Include crc32defs.h and provide uint32_t and __init before including
+ * this.  The generators only run once, at boot; the tables they fill
+ * are the ones crc32_le() and crc32_be() use afterwards, so they stay.
+ */
+
+#if CRC_LE_BITS > 8
+# define LE_TABLE_ROWS (CRC_LE_BITS/8)
+# define LE_TABLE_SIZE 256
+#else
+# define LE_TABLE_ROWS 1
+# define LE_TABLE_SIZE (1 << CRC_LE_BITS)
+#endif
+
+#if CRC_BE_BITS > 8
+# define BE_TABLE_ROWS (CRC_BE_BITS/8)
+# define BE_TABLE_SIZE 256
+#else
+# define BE_TABLE_ROWS 1
+# define BE_TABLE_SIZE (1 << CRC_BE_BITS)
+#endif
+
+/**
+ * crc32init_le_generic() - initialize LE table data
+ *
+ * crc is the crc of the byte i; other entries are filled in based on the
+ * fact that crctable[i^j] = crctable[i] ^ crctable[j].
+ *
+ */
+static void __init crc32init_le_generic(const uint32_t polynomial,
+					uint32_t (*tab)[256])
+{
+	unsigned i, j;
+	uint32_t crc = 1;
+
+	tab[0][0] = 0;
+
+	for (i = LE_TABLE_SIZE >> 1; i; i >>= 1) {
+		crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+		for (j = 0; j < LE_TABLE_SIZE; j += 2 * i)
+			tab[0][i + j] = crc ^ tab[0][j];
+	}
+	for (i = 0; i < LE_TABLE_SIZE; i++) {
+		crc = tab[0][i];
+		for (j = 1; j < LE_TABLE_ROWS; j++) {
+			crc = tab[0][crc & 0xff] ^ (crc >> 8);
+			tab[j][i] = crc;
+		}
+	}
+}
+
+/**
+ * crc32init_be_generic() - initialize BE table data
+ */
+static void __init crc32init_be_generic(const uint32_t polynomial,
+					uint32_t (*tab)[256])
+{
+	unsigned i, j;
+	uint32_t crc = 0x80000000;
+
+	tab[0][0] = 0;
+
+	for (i = 1; i < BE_TABLE_SIZE; i <<= 1) {
+		crc = (crc << 1) ^ ((crc & 0x80000000) ? polynomial : 0);
+		for (j = 0; j < i; j++)
+			tab[0][i + j] = crc ^ tab[0][j];
+	}
+	for (i = 0; i < BE_TABLE_SIZE; i++) {
+		crc = tab[0][i];
+		for (j = 1; j < BE_TABLE_ROWS; j++) {
+			crc = tab[0][(crc >> 24) & 0xff] ^ (crc << 8);
+			tab[j][i] = crc;
+		}
+	}
+}
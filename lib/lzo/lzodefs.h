@@ -15,6 +15,69 @@
 #define LZO_VERSION_STRING	"2.02"
 #define LZO_VERSION_DATE	"Oct 17 2005"
 
+/*
+ * Word sized unaligned loads and stores are cheap on x86 and on ARMv6
+ * and later (the kernel runs with SCTLR.A clear), and the copy loops
+ * below use them to move literal runs and matches 8 bytes at a time.
+ *
+ * get_unaligned() on ARM always goes byte by byte, so plain LDR/STR
+ * are issued there.  They are spelled out in asm to stop the compiler
+ * from merging neighbouring accesses into LDRD/LDM, which still trap
+ * on unaligned addresses.  The pre-boot decompressor (STATIC) cannot
+ * rely on the alignment setup and keeps the portable accessors.
+ */
+#if defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+#define LZO_FAST_UNALIGNED	1
+
+static inline u32 lzo_get32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static inline void lzo_put32(void *p, u32 v)
+{
+	asm("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+#else
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
+#define LZO_FAST_UNALIGNED	1
+#endif
+
+#define lzo_get32(p)		get_unaligned((const u32 *)(p))
+#define lzo_put32(p, v)		put_unaligned((v), (u32 *)(p))
+#endif
+
+/*
+ * The compressor hashes input bytes in little endian order on every
+ * CPU, so that its output does not depend on the byte order.
+ */
+#if defined(__BIG_ENDIAN)
+#define lzo_get_le32(p)		swab32(lzo_get32(p))
+#else
+#define lzo_get_le32(p)		lzo_get32(p)
+#endif
+
+#define COPY4(dst, src)		lzo_put32((dst), lzo_get32(src))
+#if defined(CONFIG_X86_64) || defined(__x86_64__)
+#define COPY8(dst, src)	\
+		put_unaligned(get_unaligned((const u64 *)(src)), (u64 *)(dst))
+#else
+#define COPY8(dst, src)	\
+		do { COPY4(dst, src); COPY4((dst) + 4, (src) + 4); } while (0)
+#endif
+
+/* Count trailing zero bits with a single instruction where possible. */
+#if defined(CONFIG_X86_64) || defined(__x86_64__)
+#define LZO_USE_CTZ64	1
+#define LZO_USE_CTZ32	1
+#elif defined(CONFIG_X86) || defined(__i386__) || \
+	(defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 5)
+#define LZO_USE_CTZ32	1
+#endif
+
 #define M1_MAX_OFFSET	0x0400
 #define M2_MAX_OFFSET	0x0800
 #define M3_MAX_OFFSET	0x4000
@@ -34,10 +97,11 @@
 #define M3_MARKER	32
 #define M4_MARKER	16
 
-#define D_BITS		14
-#define D_MASK		((1u << D_BITS) - 1)
-#define D_HIGH		((D_MASK >> 1) + 1)
-
-#define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
-							<< (s1)) ^ (p)[0])
-#define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+/*
+ * The compressor's dictionary holds 16 bit offsets into the current
+ * chunk of input, which is never longer than M4_MAX_OFFSET + 1.
+ */
+#define lzo_dict_t	unsigned short
+#define D_BITS		13
+#define D_SIZE		(1u << D_BITS)
+#define D_MASK		(D_SIZE - 1)
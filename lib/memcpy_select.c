@@ -0,0 +1,194 @@
+/*
+ * lib/memcpy_select.c
+ *
+ * Boot-time selection of the memcpy() implementation.
+ *
+ * The architecture dispatches medium and large copies through
+ * __memcpy_select[] and lists its candidate routines through
+ * arch_memcpy_variants().  Together with the generic word-at-a-time
+ * copy from lib/memcopy.c, every candidate is timed on a representative
+ * size of each class and the fastest one is installed.  Until that has
+ * happened __memcpy_select[] points at the architecture's default, so
+ * memcpy() is usable from the very start.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/string.h>
+#include <linux/memcopy.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/irqflags.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define MEMCPY_MAX_VARIANTS	8
+#define MEMCPY_BENCH_BYTES	(256 * 1024)	/* copied per timing run */
+#define MEMCPY_BENCH_RUNS	3		/* best of */
+
+/*
+ * Representative copy sizes for each class: well inside the medium
+ * range, and large enough to stream past L1 for the large one.
+ */
+static const size_t memcpy_bench_size[MEMCPY_NR_CLASSES] = {
+	[MEMCPY_MEDIUM]	= MEMCPY_LARGE_MIN / 4,
+	[MEMCPY_LARGE]	= MEMCPY_LARGE_MIN * 16,
+};
+
+static const char *memcpy_class_name[MEMCPY_NR_CLASSES] = {
+	[MEMCPY_MEDIUM]	= "medium",
+	[MEMCPY_LARGE]	= "large",
+};
+
+static struct memcpy_variant memcpy_variants[MEMCPY_MAX_VARIANTS];
+static int nr_memcpy_variants;
+static int memcpy_chosen[MEMCPY_NR_CLASSES];
+static u32 memcpy_mbps[MEMCPY_NR_CLASSES][MEMCPY_MAX_VARIANTS];
+static char memcpy_force[16] __initdata;
+
+/**
+ * memcpy_wordcopy - generic word-at-a-time memcpy()
+ * @dest: Where to copy to
+ * @src: Where to copy from
+ * @count: The size of the area.
+ *
+ * The glibc-derived copy used by lib/string.c on architectures without
+ * their own memcpy(), offered here as one more candidate.
+ */
+void *memcpy_wordcopy(void *dest, const void *src, size_t count)
+{
+	mem_copy_fwd((unsigned long)dest, (unsigned long)src, count);
+	return dest;
+}
+
+static int __init memcpy_setup(char *str)
+{
+	strlcpy(memcpy_force, str, sizeof(memcpy_force));
+	return 0;
+}
+early_param("memcpy", memcpy_setup);
+
+/* Return the copy throughput of @copy in MB/s for @size byte copies. */
+static u32 __init memcpy_bench(memcpy_fn_t *copy, void *dst, void *src,
+			       size_t size)
+{
+	unsigned int i, loops = MEMCPY_BENCH_BYTES / size;
+	unsigned long flags;
+	u64 t0, best = ~0ULL;
+	int run;
+
+	for (run = 0; run < MEMCPY_BENCH_RUNS; run++) {
+		local_irq_save(flags);
+		t0 = sched_clock();
+		for (i = 0; i < loops; i++)
+			copy(dst, src, size);
+		best = min(best, sched_clock() - t0);
+		local_irq_restore(flags);
+	}
+
+	/* bytes per ns * 1000 == MB/s, rounded to whole MB/s */
+	return best ? div64_u64((u64)loops * size * 1000, best) : 0;
+}
+
+static int __init memcpy_select_init(void)
+{
+	const struct memcpy_variant *arch;
+	unsigned int order;
+	void *src, *dst;
+	int c, i, nr;
+
+	arch = arch_memcpy_variants(&nr);
+	for (i = 0; i < nr && i < MEMCPY_MAX_VARIANTS - 1; i++)
+		memcpy_variants[i] = arch[i];
+	memcpy_variants[i].name = "wordcopy";
+	memcpy_variants[i].copy = memcpy_wordcopy;
+	nr_memcpy_variants = i + 1;
+
+	for (i = 0; i < nr_memcpy_variants; i++) {
+		if (!strcmp(memcpy_force, memcpy_variants[i].name)) {
+			for (c = 0; c < MEMCPY_NR_CLASSES; c++) {
+				memcpy_chosen[c] = i;
+				__memcpy_select[c] = memcpy_variants[i].copy;
+			}
+			printk(KERN_INFO "memcpy: using %s (forced)\n",
+			       memcpy_variants[i].name);
+			return 0;
+		}
+	}
+
+	order = get_order(memcpy_bench_size[MEMCPY_LARGE]);
+	src = (void *)__get_free_pages(GFP_KERNEL, order);
+	dst = (void *)__get_free_pages(GFP_KERNEL, order);
+	if (!src || !dst)
+		goto out;
+	memset(src, 0x5a, PAGE_SIZE << order);
+
+	for (c = 0; c < MEMCPY_NR_CLASSES; c++) {
+		for (i = 0; i < nr_memcpy_variants; i++) {
+			memcpy_mbps[c][i] = memcpy_bench(memcpy_variants[i].copy,
+							 dst, src,
+							 memcpy_bench_size[c]);
+			if (memcpy_mbps[c][i] > memcpy_mbps[c][memcpy_chosen[c]])
+				memcpy_chosen[c] = i;
+		}
+		__memcpy_select[c] = memcpy_variants[memcpy_chosen[c]].copy;
+		printk(KERN_INFO "memcpy: %s copies use %s (%u MB/s)\n",
+		       memcpy_class_name[c],
+		       memcpy_variants[memcpy_chosen[c]].name,
+		       memcpy_mbps[c][memcpy_chosen[c]]);
+	}
+
+out:
+	free_pages((unsigned long)src, order);
+	free_pages((unsigned long)dst, order);
+	return 0;
+}
+late_initcall(memcpy_select_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int memcpy_select_show(struct seq_file *m, void *v)
+{
+	int c, i;
+
+	seq_printf(m, "%-8s %8s", "variant", "");
+	for (c = 0; c < MEMCPY_NR_CLASSES; c++)
+		seq_printf(m, " %7s(%zu)", memcpy_class_name[c],
+			   memcpy_bench_size[c]);
+	seq_putc(m, '\n');
+
+	for (i = 0; i < nr_memcpy_variants; i++) {
+		seq_printf(m, "%-8s %8s", memcpy_variants[i].name, "MB/s");
+		for (c = 0; c < MEMCPY_NR_CLASSES; c++)
+			seq_printf(m, " %10u%c", memcpy_mbps[c][i],
+				   memcpy_chosen[c] == i ? '*' : ' ');
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int memcpy_select_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, memcpy_select_show, NULL);
+}
+
+static const struct file_operations memcpy_select_fops = {
+	.open		= memcpy_select_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init memcpy_select_debugfs(void)
+{
+	debugfs_create_file("memcpy_select", 0444, NULL, NULL,
+			    &memcpy_select_fops);
+	return 0;
+}
+late_initcall(memcpy_select_debugfs);
+#endif
@@ -454,6 +454,17 @@ out:
 }
 EXPORT_SYMBOL(add_to_page_cache_locked);
 
+static void __add_page_cache_lru(struct page *page,
+				 struct address_space *mapping, pgoff_t offset)
+{
+	if (!page_is_file_cache(page))
+		lru_cache_add_anon(page);
+	else if (workingset_refault(mapping, offset))
+		lru_cache_add_lru(page, LRU_ACTIVE_FILE);
+	else
+		lru_cache_add_file(page);
+}
+
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, gfp_t gfp_mask)
 {
@@ -469,16 +480,102 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 		SetPageSwapBacked(page);
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
-			lru_cache_add_anon(page);
-	}
+	if (ret == 0)
+		__add_page_cache_lru(page, mapping, offset);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+/**
+ * add_to_page_cache_lru_batch - add newly allocated pages to the pagecache
+ * @pages:	the pages, with page->index set
+ * @nr:		number of pages
+ * @mapping:	the pages' address_space
+ * @gfp_mask:	page allocation mode
+ *
+ * Does add_to_page_cache_lru() for each of @pages at its page->index,
+ * taking the tree_lock once for the lot rather than once per page.  The
+ * pages that are added are left locked, as add_to_page_cache_lru() leaves
+ * them.  The others, whose index was cached already or for which memory
+ * ran out, are released on behalf of the caller and their slot in @pages
+ * is cleared.
+ *
+ * Returns the number of pages added.
+ */
+unsigned add_to_page_cache_lru_batch(struct page **pages, unsigned nr,
+				struct address_space *mapping, gfp_t gfp_mask)
+{
+	unsigned i, added = 0;
+	int error = 0;
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
+
+		if (mapping_cap_swap_backed(mapping))
+			SetPageSwapBacked(page);
+		__set_page_locked(page);
+		if (mem_cgroup_cache_charge(page, current->mm,
+					    gfp_mask & GFP_RECLAIM_MASK)) {
+			__clear_page_locked(page);
+			page_cache_release(page);
+			pages[i] = NULL;
+		}
+	}
+
+	/*
+	 * A preload only guarantees the radix tree nodes for one insertion:
+	 * when the tree needs more, drop the lock, preload again, and carry on.
+	 */
+	i = 0;
+	while (i < nr) {
+		error = radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM);
+		if (error)
+			break;
+		spin_lock_irq(&mapping->tree_lock);
+		for (; i < nr; i++) {
+			struct page *page = pages[i];
+
+			if (!page)
+				continue;
+			page_cache_get(page);
+			page->mapping = mapping;
+			error = radix_tree_insert(&mapping->page_tree,
+						  page->index, page);
+			if (unlikely(error)) {
+				page->mapping = NULL;
+				page_cache_release(page);
+				if (error == -ENOMEM)
+					break;
+				continue;
+			}
+			mapping->nrpages++;
+			__inc_zone_page_state(page, NR_FILE_PAGES);
+			if (PageSwapBacked(page))
+				__inc_zone_page_state(page, NR_SHMEM);
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+		radix_tree_preload_end();
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
+
+		if (!page)
+			continue;
+		if (page->mapping != mapping) {
+			mem_cgroup_uncharge_cache_page(page);
+			__clear_page_locked(page);
+			page_cache_release(page);
+			pages[i] = NULL;
+			continue;
+		}
+		__add_page_cache_lru(page, mapping, page->index);
+		added++;
+	}
+	return added;
+}
+EXPORT_SYMBOL_GPL(add_to_page_cache_lru_batch);
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -489,6 +586,26 @@ struct page *__page_cache_alloc(gfp_t gfp)
 	return alloc_pages(gfp, 0);
 }
 EXPORT_SYMBOL(__page_cache_alloc);
+
+unsigned long __page_cache_alloc_bulk(gfp_t gfp, unsigned long nr,
+				      struct list_head *list)
+{
+	struct page *page;
+	unsigned long i;
+
+	/* the bulk allocator ignores cpuset spreading and mempolicies */
+	if (!cpuset_do_page_mem_spread() && !current->mempolicy)
+		return alloc_pages_bulk(gfp, nr, list);
+
+	for (i = 0; i < nr; i++) {
+		page = __page_cache_alloc(gfp);
+		if (!page)
+			break;
+		list_add_tail(&page->lru, list);
+	}
+	return i;
+}
+EXPORT_SYMBOL(__page_cache_alloc_bulk);
 #endif
 
 static int __sleep_on_page_lock(void *word)
@@ -32,6 +32,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
 #include <linux/ksm.h>
+#include <linux/math64.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -96,6 +97,8 @@ struct mm_slot {
  * @address: the next address inside that to be scanned
  * @rmap_item: the current rmap that we are scanning inside the rmap_list
  * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @merged: pages merged since the current full scan started
+ * @runtime: ksmd's CPU time when the current full scan started, in ns
  *
  * There is only the one ksm_scan instance of this cursor structure.
  */
@@ -104,6 +107,8 @@ struct ksm_scan {
 	unsigned long address;
 	struct rmap_item *rmap_item;
 	unsigned long seqnr;
+	unsigned long merged;
+	u64 runtime;
 };
 
 /**
@@ -172,6 +177,25 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Adjust pages_to_scan to the pages merged per CPU second of ksmd */
+static unsigned int ksm_auto_tune;
+
+/* Bounds of pages_to_scan when auto-tuning */
+static unsigned int ksm_pages_to_scan_min = 10;
+static unsigned int ksm_pages_to_scan_max = 2000;
+
+/* Pages merged per CPU second of ksmd that make it worth scanning faster */
+static unsigned int ksm_auto_tune_target = 1000;
+
+/* Most full scans a vma that doesn't merge is skipped for, 0 for none */
+static unsigned int ksm_max_vma_skip = 16;
+
+/* Full scans of a vma without a merge before it starts being skipped */
+#define KSM_IDLE_SCANS	2
+
+/* The number of times a vma was skipped by a full scan */
+static unsigned long ksm_vma_skips;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -223,6 +247,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -441,6 +466,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 				rb_erase(&rmap_item->node, &root_stable_tree);
 				ksm_pages_shared--;
 			}
+			rmap_item->mm->ksm_merging_pages--;
 		} else {
 			struct rmap_item *prev_item = rmap_item->prev;
 
@@ -451,6 +477,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 				next_item->prev = rmap_item->prev;
 			}
 			ksm_pages_sharing--;
+			rmap_item->mm->ksm_merging_pages--;
 		}
 
 		rmap_item->next = NULL;
@@ -775,6 +802,11 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 	if ((vma->vm_flags & VM_LOCKED) && !err)
 		munlock_vma_page(oldpage);
 
+	if (!err) {
+		vma->ksm_merged++;
+		ksm_scan.merged++;
+	}
+
 	unlock_page(oldpage);
 out_putpage:
 	put_page(oldpage);
@@ -980,6 +1012,7 @@ static struct rmap_item *stable_tree_insert(struct page *page,
 	rb_insert_color(&rmap_item->node, &root_stable_tree);
 
 	ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 	return rmap_item;
 }
 
@@ -1068,6 +1101,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 	rmap_item->address |= STABLE_FLAG;
 
 	ksm_pages_sharing++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -1193,10 +1227,106 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 		rmap_item->mm = mm_slot->mm;
 		rmap_item->address = addr;
 		list_add_tail(&rmap_item->link, cur);
+		mm_slot->mm->ksm_rmap_items++;
 	}
 	return rmap_item;
 }
 
+/*
+ * Back-off for areas that don't merge, such as heaps of unique data:
+ * once KSM_IDLE_SCANS full scans of a vma in a row merged nothing in it,
+ * skip it for 1, 2, 4... full scans, up to ksm_max_vma_skip.  A merge in
+ * it resets the back-off.  Called as a full scan reaches the vma; returns
+ * 1 if the scan should skip it.
+ */
+static int ksm_vma_skip(struct vm_area_struct *vma)
+{
+	unsigned int skip;
+
+	if (vma->ksm_merged != vma->ksm_merged_seen) {
+		vma->ksm_merged_seen = vma->ksm_merged;
+		vma->ksm_idle = 0;
+		vma->ksm_skip = 0;
+		return 0;
+	}
+	if (vma->ksm_skip) {
+		vma->ksm_skip--;
+		return 1;
+	}
+	if (!ksm_max_vma_skip)
+		return 0;
+
+	if (vma->ksm_idle < KSM_IDLE_SCANS + 16)
+		vma->ksm_idle++;
+	if (vma->ksm_idle <= KSM_IDLE_SCANS)
+		return 0;
+
+	skip = min(1U << (vma->ksm_idle - KSM_IDLE_SCANS - 1),
+		   ksm_max_vma_skip);
+	vma->ksm_skip = skip - 1;
+	return 1;
+}
+
+/*
+ * Move the cursor over the rmap_items of a vma that this full scan skips.
+ * They are kept, with their checksums, for when the vma is scanned again;
+ * those in the stable tree stay there, the others leave the unstable tree
+ * as if they had been scanned.  Returns the address to scan next.
+ */
+static unsigned long skip_vma_rmap_items(struct mm_slot *mm_slot,
+					 struct vm_area_struct *vma)
+{
+	struct list_head *cur = ksm_scan.rmap_item->link.next;
+	struct rmap_item *rmap_item;
+
+	while (cur != &mm_slot->rmap_list) {
+		rmap_item = list_entry(cur, struct rmap_item, link);
+		if ((rmap_item->address & PAGE_MASK) >= vma->vm_end)
+			break;
+		cur = cur->next;
+		if ((rmap_item->address & PAGE_MASK) < vma->vm_start) {
+			/* left over from an area unmapped since */
+			remove_rmap_item_from_tree(rmap_item);
+			list_del(&rmap_item->link);
+			free_rmap_item(rmap_item);
+			continue;
+		}
+		if (!in_stable_tree(rmap_item))
+			remove_rmap_item_from_tree(rmap_item);
+		ksm_scan.rmap_item = rmap_item;
+	}
+
+	ksm_vma_skips++;
+	return vma->vm_end;
+}
+
+/*
+ * Auto-tuning, at the end of each full scan: compare the pages merged
+ * during the scan with the CPU time ksmd spent on it.  While merging pays
+ * at least ksm_auto_tune_target pages per CPU second, double the scan
+ * rate; when it pays less than a quarter of that, halve it.
+ */
+static void ksm_tune_scan_rate(void)
+{
+	u64 runtime = task_sched_runtime(current);
+	u64 cpu_ns = runtime - ksm_scan.runtime;
+	unsigned int pages = ksm_thread_pages_to_scan;
+	u64 rate;
+
+	if (ksm_auto_tune && cpu_ns) {
+		rate = div64_u64((u64)ksm_scan.merged * NSEC_PER_SEC, cpu_ns);
+		if (rate >= ksm_auto_tune_target)
+			pages = pages > UINT_MAX / 2 ? UINT_MAX : pages * 2;
+		else if (rate < ksm_auto_tune_target / 4)
+			pages /= 2;
+		ksm_thread_pages_to_scan = clamp(pages, ksm_pages_to_scan_min,
+						 ksm_pages_to_scan_max);
+	}
+
+	ksm_scan.runtime = runtime;
+	ksm_scan.merged = 0;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1241,6 +1371,9 @@ next_mm:
 			ksm_scan.address = vma->vm_start;
 		if (!vma->anon_vma)
 			ksm_scan.address = vma->vm_end;
+		else if (ksm_scan.address == vma->vm_start &&
+			 ksm_vma_skip(vma))
+			ksm_scan.address = skip_vma_rmap_items(slot, vma);
 
 		while (ksm_scan.address < vma->vm_end) {
 			if (ksm_test_exit(mm))
@@ -1310,6 +1443,7 @@ next_mm:
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+	ksm_tune_scan_rate();
 	return NULL;
 }
 
@@ -1536,6 +1670,131 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t auto_tune_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune);
+}
+
+static ssize_t auto_tune_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	int err;
+	unsigned long flags;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	ksm_auto_tune = flags;
+
+	return count;
+}
+KSM_ATTR(auto_tune);
+
+static ssize_t pages_to_scan_min_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_pages_to_scan_min);
+}
+
+static ssize_t pages_to_scan_min_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || !nr_pages || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (nr_pages > ksm_pages_to_scan_max)
+		err = -EINVAL;
+	else
+		ksm_pages_to_scan_min = nr_pages;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return err ? err : count;
+}
+KSM_ATTR(pages_to_scan_min);
+
+static ssize_t pages_to_scan_max_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_pages_to_scan_max);
+}
+
+static ssize_t pages_to_scan_max_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (nr_pages < ksm_pages_to_scan_min)
+		err = -EINVAL;
+	else
+		ksm_pages_to_scan_max = nr_pages;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return err ? err : count;
+}
+KSM_ATTR(pages_to_scan_max);
+
+static ssize_t auto_tune_target_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto_tune_target);
+}
+
+static ssize_t auto_tune_target_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	int err;
+	unsigned long target;
+
+	err = strict_strtoul(buf, 10, &target);
+	if (err || !target || target > UINT_MAX)
+		return -EINVAL;
+
+	ksm_auto_tune_target = target;
+
+	return count;
+}
+KSM_ATTR(auto_tune_target);
+
+static ssize_t max_vma_skip_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_max_vma_skip);
+}
+
+static ssize_t max_vma_skip_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	unsigned long scans;
+
+	err = strict_strtoul(buf, 10, &scans);
+	if (err || scans > USHORT_MAX)
+		return -EINVAL;
+
+	ksm_max_vma_skip = scans;
+
+	return count;
+}
+KSM_ATTR(max_vma_skip);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1651,9 +1910,21 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t vma_skips_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_vma_skips);
+}
+KSM_ATTR_RO(vma_skips);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&auto_tune_attr.attr,
+	&pages_to_scan_min_attr.attr,
+	&pages_to_scan_max_attr.attr,
+	&auto_tune_target_attr.attr,
+	&max_vma_skip_attr.attr,
 	&run_attr.attr,
 	&max_kernel_pages_attr.attr,
 	&pages_shared_attr.attr,
@@ -1661,6 +1932,7 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&vma_skips_attr.attr,
 	NULL,
 };
 
@@ -40,6 +40,7 @@
 #include <linux/swapops.h>
 #include <linux/spinlock.h>
 #include <linux/eventfd.h>
+#include <linux/vmpressure.h>
 #include <linux/sort.h>
 #include <linux/fs.h>
 #include <linux/seq_file.h>
@@ -220,6 +221,9 @@ struct mem_cgroup {
 	/* thresholds for mem+swap usage. RCU-protected */
 	struct mem_cgroup_threshold_ary *memsw_thresholds;
 
+	/* reclaim efficiency and its listeners, see vmpressure.c */
+	struct vmpressure vmpressure;
+
 	/*
 	 * Should we move charges of a task when a task is moved into this
 	 * mem_cgroup ? And what type of charges should we move ?
@@ -3199,7 +3203,7 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
 	struct mem_cgroup *parent;
 
-	if (val > 100)
+	if (val > 200)
 		return -EINVAL;
 
 	if (cgrp->parent == NULL)
@@ -3516,6 +3520,11 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_move_charge_read,
 		.write_u64 = mem_cgroup_move_charge_write,
 	},
+	{
+		.name = "pressure_level",
+		.register_event = vmpressure_register_event,
+		.unregister_event = vmpressure_unregister_event,
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -3682,6 +3691,27 @@ static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem)
 	return mem_cgroup_from_res_counter(mem->res.parent, res);
 }
 
+struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *mem)
+{
+	if (!mem)
+		mem = root_mem_cgroup;
+	return mem ? &mem->vmpressure : NULL;
+}
+
+struct vmpressure *cgroup_to_vmpressure(struct cgroup *cgrp)
+{
+	return &mem_cgroup_from_cont(cgrp)->vmpressure;
+}
+
+struct vmpressure *vmpressure_parent(struct vmpressure *vmpr)
+{
+	struct mem_cgroup *mem;
+
+	mem = container_of(vmpr, struct mem_cgroup, vmpressure);
+	mem = parent_mem_cgroup(mem);
+	return mem ? &mem->vmpressure : NULL;
+}
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 static void __init enable_swap_cgroup(void)
 {
@@ -3730,6 +3760,9 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	if (!mem)
 		return ERR_PTR(error);
 
+	/* reclaim reports to root_mem_cgroup as soon as it is set */
+	vmpressure_init(&mem->vmpressure);
+
 	for_each_node_state(node, N_POSSIBLE)
 		if (alloc_mem_cgroup_per_zone_info(mem, node))
 			goto free_out;
@@ -3795,6 +3828,7 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	vmpressure_cleanup(&mem->vmpressure);
 	mem_cgroup_put(mem);
 }
 
@@ -1981,6 +1981,113 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 }
 EXPORT_SYMBOL(__alloc_pages_nodemask);
 
+/*
+ * __alloc_pages_bulk_nodemask - allocate a batch of order-0 pages
+ *
+ * Takes the pages from the per-cpu list of the first zone that stays
+ * above its low watermark with all of them gone, refilling the list from
+ * the buddy allocator a pcp->batch at a time, all with interrupts
+ * disabled once rather than once per page.  Whatever that doesn't cover
+ * comes from __alloc_pages_nodemask() one page at a time, which may
+ * reclaim.
+ *
+ * The pages are added to @list through page->lru.  Returns how many
+ * were, which is less than @nr_pages only if the allocation failed.
+ */
+unsigned long __alloc_pages_bulk_nodemask(gfp_t gfp_mask,
+			unsigned long nr_pages, struct zonelist *zonelist,
+			nodemask_t *nodemask, struct list_head *list)
+{
+	enum zone_type high_zoneidx = gfp_zone(gfp_mask);
+	int migratetype = allocflags_to_migratetype(gfp_mask);
+	int cold = !!(gfp_mask & __GFP_COLD);
+	struct zone *preferred_zone, *zone;
+	struct per_cpu_pages *pcp;
+	struct list_head *pcp_list;
+	struct page *page, *next;
+	struct zoneref *z;
+	unsigned long flags, nr = 0, i;
+	LIST_HEAD(batch);
+
+	gfp_mask &= gfp_allowed_mask;
+
+	lockdep_trace_alloc(gfp_mask);
+
+	might_sleep_if(gfp_mask & __GFP_WAIT);
+
+	if (nr_pages < 2 || should_fail_alloc_page(gfp_mask, 0))
+		goto fallback;
+
+	if (unlikely(!zonelist->_zonerefs->zone))
+		return 0;
+
+	first_zones_zonelist(zonelist, high_zoneidx, nodemask, &preferred_zone);
+	if (!preferred_zone)
+		return 0;
+
+	for_each_zone_zonelist_nodemask(zone, z, zonelist,
+					high_zoneidx, nodemask) {
+		if (!cpuset_zone_allowed_softwall(zone,
+						  gfp_mask | __GFP_HARDWALL))
+			continue;
+		if (zone_watermark_ok(zone, 0, low_wmark_pages(zone) + nr_pages,
+				      zone_idx(preferred_zone),
+				      ALLOC_WMARK_LOW | ALLOC_CPUSET))
+			break;
+	}
+	if (!zone)
+		goto fallback;
+
+	local_irq_save(flags);
+	pcp = &zone_pcp(zone, smp_processor_id())->pcp;
+	pcp_list = &pcp->lists[migratetype];
+	while (nr < nr_pages) {
+		if (list_empty(pcp_list)) {
+			pcp->count += rmqueue_bulk(zone, 0,
+					pcp->batch, pcp_list,
+					migratetype, cold);
+			if (unlikely(list_empty(pcp_list)))
+				break;
+		}
+
+		if (cold)
+			page = list_entry(pcp_list->prev, struct page, lru);
+		else
+			page = list_entry(pcp_list->next, struct page, lru);
+
+		list_move_tail(&page->lru, &batch);
+		pcp->count--;
+		nr++;
+	}
+	__count_zone_vm_events(PGALLOC, zone, nr);
+	for (i = 0; i < nr; i++)
+		zone_statistics(preferred_zone, zone);
+	local_irq_restore(flags);
+
+	list_for_each_entry_safe(page, next, &batch, lru) {
+		list_del(&page->lru);
+		VM_BUG_ON(bad_range(zone, page));
+		/* a bad page is left alone, as buffered_rmqueue() does */
+		if (prep_new_page(page, 0, gfp_mask)) {
+			nr--;
+			continue;
+		}
+		trace_mm_page_alloc(page, 0, gfp_mask, migratetype);
+		list_add_tail(&page->lru, list);
+	}
+
+fallback:
+	while (nr < nr_pages) {
+		page = __alloc_pages_nodemask(gfp_mask, 0, zonelist, nodemask);
+		if (!page)
+			break;
+		list_add_tail(&page->lru, list);
+		nr++;
+	}
+	return nr;
+}
+EXPORT_SYMBOL(__alloc_pages_bulk_nodemask);
+
 /*
  * Common helper functions.
  */
@@ -118,20 +118,31 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = list_to_page(pages);
-		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping,
-					page->index, GFP_KERNEL)) {
-			mapping->a_ops->readpage(filp, page);
+	while (nr_pages) {
+		struct page *batch[PAGEVEC_SIZE];
+		unsigned nr = min_t(unsigned, nr_pages, PAGEVEC_SIZE);
+
+		for (page_idx = 0; page_idx < nr; page_idx++) {
+			batch[page_idx] = list_to_page(pages);
+			list_del(&batch[page_idx]->lru);
 		}
-		page_cache_release(page);
+		add_to_page_cache_lru_batch(batch, nr, mapping, GFP_KERNEL);
+		for (page_idx = 0; page_idx < nr; page_idx++) {
+			if (!batch[page_idx])
+				continue;
+			mapping->a_ops->readpage(filp, batch[page_idx]);
+			page_cache_release(batch[page_idx]);
+		}
+		nr_pages -= nr;
 	}
 	ret = 0;
 out:
 	return ret;
 }
 
+/* Pages looked up and allocated at a time by __do_page_cache_readahead() */
+#define READAHEAD_BATCH	32
+
 /*
  * __do_page_cache_readahead() actually reads a chunk of disk.  It allocates all
  * the pages first, then submits them all for I/O. This avoids the very bad
@@ -148,8 +159,11 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	struct inode *inode = mapping->host;
 	struct page *page;
 	unsigned long end_index;	/* The last page we want to read */
+	pgoff_t batch[READAHEAD_BATCH];
 	LIST_HEAD(page_pool);
-	int page_idx;
+	LIST_HEAD(new_pages);
+	unsigned long page_idx = 0;
+	unsigned long nr, got, i;
 	int ret = 0;
 	loff_t isize = i_size_read(inode);
 
@@ -159,28 +173,35 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	end_index = ((isize - 1) >> PAGE_CACHE_SHIFT);
 
 	/*
-	 * Preallocate as many pages as we will need.
+	 * Preallocate as many pages as we will need, a batch of the missing
+	 * ones at a time from the bulk allocator.
 	 */
-	for (page_idx = 0; page_idx < nr_to_read; page_idx++) {
-		pgoff_t page_offset = offset + page_idx;
-
-		if (page_offset > end_index)
-			break;
-
+	while (page_idx < nr_to_read) {
+		nr = 0;
 		rcu_read_lock();
-		page = radix_tree_lookup(&mapping->page_tree, page_offset);
+		for (; page_idx < nr_to_read && nr < READAHEAD_BATCH;
+		     page_idx++) {
+			pgoff_t page_offset = offset + page_idx;
+
+			if (page_offset > end_index)
+				break;
+			if (!radix_tree_lookup(&mapping->page_tree,
+					       page_offset))
+				batch[nr++] = page_offset;
+		}
 		rcu_read_unlock();
-		if (page)
-			continue;
 
-		page = page_cache_alloc_cold(mapping);
-		if (!page)
+		got = page_cache_alloc_cold_bulk(mapping, nr, &new_pages);
+		for (i = 0; i < got; i++) {
+			page = list_entry(new_pages.next, struct page, lru);
+			list_move(&page->lru, &page_pool);
+			page->index = batch[i];
+			if (batch[i] == offset + nr_to_read - lookahead_size)
+				SetPageReadahead(page);
+			ret++;
+		}
+		if (got < nr || offset + page_idx > end_index)
 			break;
-		page->index = page_offset;
-		list_add(&page->lru, &page_pool);
-		if (page_idx == nr_to_read - lookahead_size)
-			SetPageReadahead(page);
-		ret++;
 	}
 
 	/*
@@ -0,0 +1,459 @@
+/*
+ * mm/slab_bench.c
+ *
+ * Slab allocator microbenchmark.
+ *
+ * Runs a fixed set of alloc/free patterns against whichever slab
+ * allocator (SLAB, SLUB, SLQB or SLOB) the kernel was built with, so
+ * that kernels differing only in that choice can be compared on the
+ * same hardware or under QEMU.  All randomness comes from a seeded
+ * generator, so two runs with the same parameters issue exactly the
+ * same sequence of requests.
+ *
+ * Each pattern reports the mean cost per operation together with the
+ * 50th, 90th and 99th percentile of the individually timed calls; the
+ * tail percentiles are where cache-cold slow paths show up.  Memory
+ * overhead is reported both as ksize() slack and as the growth of the
+ * NR_SLAB_* counters per live object.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) "slab_bench: " fmt
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/vmstat.h>
+#include <linux/sort.h>
+
+#if defined(CONFIG_SLAB)
+#define SLAB_BENCH_ALLOCATOR	"SLAB"
+#elif defined(CONFIG_SLUB)
+#define SLAB_BENCH_ALLOCATOR	"SLUB"
+#elif defined(CONFIG_SLQB)
+#define SLAB_BENCH_ALLOCATOR	"SLQB"
+#elif defined(CONFIG_SLOB)
+#define SLAB_BENCH_ALLOCATOR	"SLOB"
+#else
+#define SLAB_BENCH_ALLOCATOR	"unknown"
+#endif
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Objects allocated per pattern (default 10000)");
+
+static unsigned int size = 64;
+module_param(size, uint, 0444);
+MODULE_PARM_DESC(size, "Object size for the fixed-size patterns (default 64)");
+
+static unsigned int burst = 64;
+module_param(burst, uint, 0444);
+MODULE_PARM_DESC(burst, "Objects per burst in the burst pattern (default 64)");
+
+static unsigned int sweep_max = 8192;
+module_param(sweep_max, uint, 0444);
+MODULE_PARM_DESC(sweep_max, "Largest kmalloc size in the size sweep (default 8192)");
+
+static unsigned int seed = 1;
+module_param(seed, uint, 0444);
+MODULE_PARM_DESC(seed, "Seed for the mixed-size pattern (default 1)");
+
+static unsigned int bench_cpu;
+module_param(bench_cpu, uint, 0444);
+MODULE_PARM_DESC(bench_cpu, "CPU the allocating side runs on (default 0)");
+
+struct bench_stats {
+	u32		*samples;	/* per-operation latency in ns */
+	unsigned int	nr;
+	u64		total;
+};
+
+static struct bench_stats stats;
+static void **objs;
+static u32 clock_overhead;
+static u32 rand_state;
+
+static u32 bench_rand(void)
+{
+	/* Numerical Recipes LCG: cheap and identical on every run */
+	rand_state = rand_state * 1664525 + 1013904223;
+	return rand_state >> 8;
+}
+
+static inline void stats_reset(void)
+{
+	stats.nr = 0;
+	stats.total = 0;
+}
+
+static inline void stats_add(u64 start, u64 end)
+{
+	u64 delta = end - start;
+
+	delta = delta > clock_overhead ? delta - clock_overhead : 0;
+	if (stats.nr < iterations)
+		stats.samples[stats.nr++] = min_t(u64, delta, ~0U);
+	stats.total += delta;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void stats_report(const char *pattern, const char *op)
+{
+	unsigned int nr = stats.nr;
+
+	if (!nr)
+		return;
+
+	sort(stats.samples, nr, sizeof(u32), cmp_u32, NULL);
+	pr_info("%-8s %-6s ops %6u  ns/op %6llu  p50 %6u  p90 %6u  p99 %6u  max %6u\n",
+		pattern, op, nr, div_u64(stats.total, nr),
+		stats.samples[nr / 2], stats.samples[nr * 9 / 10],
+		stats.samples[nr * 99 / 100], stats.samples[nr - 1]);
+}
+
+static unsigned long slab_pages(void)
+{
+	return global_page_state(NR_SLAB_RECLAIMABLE) +
+	       global_page_state(NR_SLAB_UNRECLAIMABLE);
+}
+
+/*
+ * Report how much memory @nr live objects of @objsize bytes actually
+ * cost: the rounding slack reported by ksize() and the per-object
+ * growth of the slab page counters since @pages_before.  The latter is
+ * only meaningful for sizes served from slab pages and is noisy when
+ * other allocations happen concurrently.
+ */
+static void report_overhead(const char *pattern, size_t objsize,
+			    unsigned int nr, unsigned long pages_before)
+{
+	unsigned long pages_after = slab_pages();
+	long grown = (long)(pages_after - pages_before) * PAGE_SIZE;
+	size_t real = objs[0] ? ksize(objs[0]) : 0;
+
+	pr_info("%-8s memory size %5zu  ksize %5zu  slab bytes/object %ld\n",
+		pattern, objsize, real, grown > 0 ? grown / (long)nr : 0L);
+}
+
+static void free_objs(unsigned int nr)
+{
+	while (nr--)
+		kfree(objs[nr]);
+}
+
+/*
+ * A failed kmalloc() would be timed as a very fast one: free the @nr
+ * objects allocated so far and abort the whole run.
+ */
+static int alloc_failed(const char *pattern, unsigned int nr)
+{
+	pr_err("%-8s kmalloc failed after %u objects, run aborted\n",
+	       pattern, nr);
+	free_objs(nr);
+	return -ENOMEM;
+}
+
+/* Allocate everything, then free everything, on the same CPU. */
+static int bench_same_cpu(void)
+{
+	unsigned long pages;
+	unsigned int i;
+	u64 t0;
+
+	pages = slab_pages();
+	stats_reset();
+	for (i = 0; i < iterations; i++) {
+		t0 = sched_clock();
+		objs[i] = kmalloc(size, GFP_KERNEL);
+		stats_add(t0, sched_clock());
+		if (!objs[i])
+			return alloc_failed("samecpu", i);
+	}
+	stats_report("samecpu", "alloc");
+	report_overhead("samecpu", size, iterations, pages);
+
+	stats_reset();
+	for (i = 0; i < iterations; i++) {
+		t0 = sched_clock();
+		kfree(objs[i]);
+		stats_add(t0, sched_clock());
+	}
+	stats_report("samecpu", "free");
+	return 0;
+}
+
+struct remote_free {
+	struct completion	done;
+	unsigned int		nr;
+};
+
+static int remote_free_thread(void *data)
+{
+	struct remote_free *rf = data;
+	unsigned int i;
+	u64 t0;
+
+	stats_reset();
+	for (i = 0; i < rf->nr; i++) {
+		t0 = sched_clock();
+		kfree(objs[i]);
+		stats_add(t0, sched_clock());
+	}
+	complete(&rf->done);
+	return 0;
+}
+
+/*
+ * Allocate on the benchmark CPU and free from another one: this is the
+ * producer/consumer pattern (e.g. network RX on one CPU, processing on
+ * another) that exercises each allocator's remote free handling.
+ */
+static int bench_remote(void)
+{
+	struct remote_free rf;
+	struct task_struct *p;
+	unsigned int i, cpu;
+	u64 t0;
+
+	cpu = cpumask_any_but(cpu_online_mask, smp_processor_id());
+	if (cpu >= nr_cpu_ids) {
+		pr_info("remote   skipped: only one CPU online\n");
+		return 0;
+	}
+
+	stats_reset();
+	for (i = 0; i < iterations; i++) {
+		t0 = sched_clock();
+		objs[i] = kmalloc(size, GFP_KERNEL);
+		stats_add(t0, sched_clock());
+		if (!objs[i])
+			return alloc_failed("remote", i);
+	}
+	stats_report("remote", "alloc");
+
+	init_completion(&rf.done);
+	rf.nr = iterations;
+	p = kthread_create(remote_free_thread, &rf, "slab_bench/%u", cpu);
+	if (IS_ERR(p)) {
+		free_objs(iterations);
+		return PTR_ERR(p);
+	}
+	kthread_bind(p, cpu);
+	wake_up_process(p);
+	wait_for_completion(&rf.done);
+	stats_report("remote", "free");
+
+	/* Reallocate after the remote frees to see what they left behind. */
+	stats_reset();
+	for (i = 0; i < iterations; i++) {
+		t0 = sched_clock();
+		objs[i] = kmalloc(size, GFP_KERNEL);
+		stats_add(t0, sched_clock());
+		if (!objs[i])
+			return alloc_failed("remote", i);
+	}
+	stats_report("remote", "realloc");
+	free_objs(iterations);
+	return 0;
+}
+
+/* Short alloc bursts freed in LIFO order, as a syscall path would. */
+static int bench_burst(void)
+{
+	unsigned int i, j, n = min(burst, iterations);
+	u64 t0;
+
+	if (!n)
+		return 0;
+
+	stats_reset();
+	for (i = 0; i + n <= iterations; i += n) {
+		t0 = sched_clock();
+		for (j = 0; j < n; j++) {
+			objs[j] = kmalloc(size, GFP_KERNEL);
+			if (!objs[j])
+				return alloc_failed("burst", j);
+		}
+		for (j = n; j-- > 0; )
+			kfree(objs[j]);
+		stats_add(t0, sched_clock());
+	}
+	/* Samples are whole bursts; scale the mean to a single alloc+free. */
+	stats.total = div_u64(stats.total, n);
+	for (i = 0; i < stats.nr; i++)
+		stats.samples[i] /= n;
+	stats_report("burst", "pair");
+	return 0;
+}
+
+static const unsigned int mixed_sizes[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 512, 1024, 2048,
+};
+
+/*
+ * Keep a working set of mixed-size objects and replace a random one at
+ * each step.  This fragments the caches the way long-running kernels
+ * do, instead of the pristine state the other patterns see.
+ */
+static int bench_mixed(void)
+{
+	unsigned int i, slot, live = min(iterations, 1024U);
+	size_t sz;
+	u64 t0;
+
+	rand_state = seed;
+	for (i = 0; i < live; i++) {
+		objs[i] = kmalloc(mixed_sizes[bench_rand() %
+					      ARRAY_SIZE(mixed_sizes)], GFP_KERNEL);
+		if (!objs[i])
+			return alloc_failed("mixed", i);
+	}
+
+	stats_reset();
+	for (i = 0; i < iterations; i++) {
+		slot = bench_rand() % live;
+		sz = mixed_sizes[bench_rand() % ARRAY_SIZE(mixed_sizes)];
+		t0 = sched_clock();
+		kfree(objs[slot]);
+		objs[slot] = kmalloc(sz, GFP_KERNEL);
+		stats_add(t0, sched_clock());
+		/* kfree(NULL) is fine, the slot needs no special care */
+		if (!objs[slot])
+			return alloc_failed("mixed", live);
+	}
+	stats_report("mixed", "pair");
+
+	free_objs(live);
+	return 0;
+}
+
+/* Allocate and free @iterations objects of each power-of-two size. */
+static int bench_sweep(void)
+{
+	unsigned long pages;
+	unsigned int i, objsize;
+	char name[16];
+	u64 t0;
+
+	for (objsize = 8; objsize <= sweep_max; objsize <<= 1) {
+		snprintf(name, sizeof(name), "kmalloc%u", objsize);
+		pages = slab_pages();
+		stats_reset();
+		for (i = 0; i < iterations; i++) {
+			t0 = sched_clock();
+			objs[i] = kmalloc(objsize, GFP_KERNEL);
+			stats_add(t0, sched_clock());
+			if (!objs[i])
+				return alloc_failed(name, i);
+		}
+		stats_report(name, "alloc");
+		report_overhead(name, objsize, iterations, pages);
+
+		stats_reset();
+		for (i = 0; i < iterations; i++) {
+			t0 = sched_clock();
+			kfree(objs[i]);
+			stats_add(t0, sched_clock());
+		}
+		stats_report(name, "free");
+		cond_resched();
+	}
+	return 0;
+}
+
+static void calibrate_clock(void)
+{
+	u64 t0, best = ULLONG_MAX;
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		t0 = sched_clock();
+		best = min(best, sched_clock() - t0);
+	}
+	clock_overhead = best;
+}
+
+struct bench_run {
+	struct completion	done;
+	int			err;
+};
+
+static int slab_bench_thread(void *data)
+{
+	struct bench_run *run = data;
+
+	pr_info("allocator %s, cpu %u, iterations %u, size %u\n",
+		SLAB_BENCH_ALLOCATOR, smp_processor_id(), iterations, size);
+
+	calibrate_clock();
+	pr_info("sched_clock overhead %u ns subtracted from samples\n",
+		clock_overhead);
+
+	run->err = bench_same_cpu();
+	if (!run->err)
+		run->err = bench_remote();
+	if (!run->err)
+		run->err = bench_burst();
+	if (!run->err)
+		run->err = bench_mixed();
+	if (!run->err)
+		run->err = bench_sweep();
+
+	complete(&run->done);
+	return 0;
+}
+
+static int __init slab_bench_init(void)
+{
+	struct bench_run run;
+	struct task_struct *p;
+
+	if (!iterations || !size || bench_cpu >= nr_cpu_ids ||
+	    !cpu_online(bench_cpu))
+		return -EINVAL;
+
+	stats.samples = vmalloc(iterations * sizeof(u32));
+	objs = vmalloc(iterations * sizeof(void *));
+	if (!stats.samples || !objs) {
+		vfree(stats.samples);
+		vfree(objs);
+		return -ENOMEM;
+	}
+
+	init_completion(&run.done);
+	p = kthread_create(slab_bench_thread, &run, "slab_bench");
+	if (IS_ERR(p)) {
+		vfree(stats.samples);
+		vfree(objs);
+		return PTR_ERR(p);
+	}
+	kthread_bind(p, bench_cpu);
+	wake_up_process(p);
+	wait_for_completion(&run.done);
+
+	vfree(stats.samples);
+	vfree(objs);
+
+	/* Nothing to keep resident; fail the load so it can be rerun. */
+	return run.err ? run.err : -EAGAIN;
+}
+module_init(slab_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Slab allocator microbenchmark");
@@ -18,6 +18,7 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/pfn.h>
 
 #include <asm/pgtable.h>
 
@@ -250,22 +251,89 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
+/*
+ * Swap readahead adapts its window to how many of the pages it read
+ * ahead were used: PG_readahead marks them until they are looked up.
+ *
+ * Slot clustering, swapin_readahead(), keeps the hits in one global
+ * counter.  VMA readahead, swap_vma_readahead(), keeps them per vma in
+ * vma->swap_readahead_info, together with the address of the last fault
+ * and the last window:
+ *
+ *	| fault address (PAGE_MASK) | window | hits |
+ *
+ * with the window and hit count each in half of the page offset bits.
+ */
+int sysctl_swap_vma_readahead __read_mostly = 1;
+
+static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
+
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/* Start out with a few hits, so that the first window isn't minimal */
+#define GET_SWAP_RA_VAL(vma)					\
+	(atomic_long_read(&(vma)->swap_readahead_info) ? : 4)
+
+/*
+ * The VMA window is limited to a page table page, and read through a
+ * copy of its ptes on the stack: keep that small.
+ */
+#ifdef CONFIG_64BIT
+#define SWAP_RA_ORDER_CEILING	5
+#else
+#define SWAP_RA_ORDER_CEILING	3
+#endif
+#define SWAP_RA_PTE_MAX		(1 << SWAP_RA_ORDER_CEILING)
+
 /*
  * Lookup a swap entry in the swap cache. A found page will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+			       unsigned long addr)
 {
 	struct page *page;
+	unsigned long ra_val;
+	unsigned int win, hits;
+	int readahead, vma_ra;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
-		INC_CACHE_INFO(find_success);
-
 	INC_CACHE_INFO(find_total);
+	if (!page)
+		return NULL;
+
+	INC_CACHE_INFO(find_success);
+	readahead = TestClearPageReadahead(page);
+	vma_ra = vma && swap_use_vma_readahead();
+	if (vma_ra) {
+		ra_val = GET_SWAP_RA_VAL(vma);
+		win = SWAP_RA_WIN(ra_val);
+		hits = SWAP_RA_HITS(ra_val);
+		if (readahead && hits < SWAP_RA_HITS_MAX)
+			hits++;
+		atomic_long_set(&vma->swap_readahead_info,
+				SWAP_RA_VAL(addr, win, hits));
+	}
+	if (readahead) {
+		count_vm_event(SWAP_RA_HIT);
+		if (!vma_ra)
+			atomic_inc(&swapin_readahead_hits);
+	}
 	return page;
 }
 
@@ -273,14 +341,17 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * Locate a page of swap in physical memory, reserving swap cache space
  * and reading the disk if it is not already cached.
  * A failure return means that either the page allocation failed or that
- * the swap entry is no longer in use.
+ * the swap entry is no longer in use.  *@allocated tells whether the
+ * page was newly read in rather than found in the swap cache.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			int *allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*allocated = 0;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -331,6 +402,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*allocated = 1;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -348,6 +420,78 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	int allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, &allocated);
+}
+
+/*
+ * The readahead window, in pages, for a fault at @offset following one
+ * at @prev_offset, after @hits of the pages last read ahead were used.
+ */
+static unsigned int __swapin_nr_pages(unsigned long prev_offset,
+				      unsigned long offset, unsigned int hits,
+				      unsigned int max_pages,
+				      unsigned int prev_win)
+{
+	unsigned int pages, last_ra;
+
+	/*
+	 * This heuristic has been found to work well on both sequential and
+	 * random loads, swapping to hard disk or to SSD: please don't ask
+	 * what the "+ 2" means, it just happens to work well, that's all.
+	 */
+	pages = hits + 2;
+	if (pages == 2) {
+		/*
+		 * We can have no readahead hits to judge by: but must not get
+		 * stuck here forever, so check for an adjacent offset instead
+		 * (and don't even bother to check whether swap type is same).
+		 */
+		if (offset != prev_offset + 1 && offset != prev_offset - 1)
+			pages = 1;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+
+	if (pages > max_pages)
+		pages = max_pages;
+
+	/* Don't shrink readahead too fast */
+	last_ra = prev_win / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+
+	return pages;
+}
+
+static unsigned int swapin_nr_pages(unsigned long offset)
+{
+	static unsigned long prev_offset;
+	static atomic_t last_readahead_pages;
+	unsigned int hits, pages, max_pages;
+
+	max_pages = 1 << ACCESS_ONCE(page_cluster);
+	if (max_pages <= 1)
+		return 1;
+
+	hits = atomic_xchg(&swapin_readahead_hits, 0);
+	pages = __swapin_nr_pages(prev_offset, offset, hits, max_pages,
+				  atomic_read(&last_readahead_pages));
+	if (!hits)
+		prev_offset = offset;
+	atomic_set(&last_readahead_pages, pages);
+
+	return pages;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -358,9 +502,10 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read an aligned block of
- * (1 << page_cluster) entries in the swap area. This method is chosen
- * because it doesn't cost us any seek time.  We also make sure to queue
- * the 'original' request together with the readahead ones...
+ * entries in the swap area, up to (1 << page_cluster) of them, fewer when
+ * recent readahead went unused. This method is chosen because it doesn't
+ * cost us any seek time.  We also make sure to queue the 'original'
+ * request together with the readahead ones...
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -374,6 +519,7 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	struct page *page;
 	unsigned long offset;
 	unsigned long end_offset;
+	int allocated;
 
 	/*
 	 * Get starting offset for readaround, and number of pages to read.
@@ -382,15 +528,114 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 * more likely that neighbouring swap pages came from the same node:
 	 * so use the same "addr" to choose the same node for each swap read.
 	 */
-	nr_pages = valid_swaphandles(entry, &offset);
+	nr_pages = valid_swaphandles(entry, &offset,
+				     swapin_nr_pages(swp_offset(entry)));
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(swp_entry(swp_type(entry), offset),
+					       gfp_mask, vma, addr, &allocated);
 		if (!page)
 			break;
+		if (allocated && offset != swp_offset(entry)) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/**
+ * swap_vma_readahead - swap in pages around the faulting address
+ * @fentry: swap entry of the faulting page
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the faulting address belongs to
+ * @addr: the faulting address
+ * @pmd: pmd of the faulting address
+ *
+ * Returns the struct page for @fentry and @addr, after queueing swapin.
+ *
+ * Unlike swapin_readahead(), which reads the swap slots next to the
+ * faulting one, this reads the swap entries of the virtual pages next to
+ * the faulting address, wherever they are in swap.  Where seeks cost
+ * nothing, as on zram, those are the pages likely to be wanted next.
+ * The window grows with the hits of the last readahead in this vma and
+ * is placed ahead of the fault in the direction the faults move, or
+ * around it.  It stays within the vma and the page table page of the
+ * fault.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+				struct vm_area_struct *vma, unsigned long addr,
+				pmd_t *pmd)
+{
+	pte_t ptes[SWAP_RA_PTE_MAX], *pte;
+	unsigned long ra_val, faddr, pfn, fpfn, lpfn, start, end;
+	unsigned int max_win, win, left, i, nr;
+	struct page *page;
+	swp_entry_t entry;
+	int allocated;
+
+	max_win = 1 << min_t(unsigned int, ACCESS_ONCE(page_cluster),
+			     SWAP_RA_ORDER_CEILING);
+	if (max_win <= 1)
+		goto skip;
+
+	faddr = addr & PAGE_MASK;
+	fpfn = PFN_DOWN(faddr);
+	ra_val = GET_SWAP_RA_VAL(vma);
+	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
+	win = __swapin_nr_pages(pfn, fpfn, SWAP_RA_HITS(ra_val), max_win,
+				SWAP_RA_WIN(ra_val));
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(faddr, win, 0));
+	if (win == 1)
+		goto skip;
+
+	if (fpfn == pfn + 1)		/* forward */
+		left = 0;
+	else if (pfn == fpfn + 1)	/* backward */
+		left = win - 1;
+	else
+		left = (win - 1) / 2;
+	lpfn = fpfn > left ? fpfn - left : 0;
+
+	start = max(lpfn, PFN_DOWN(vma->vm_start));
+	start = max(start, PFN_DOWN(faddr & PMD_MASK));
+	end = min(lpfn + win, PFN_DOWN(vma->vm_end));
+	end = min(end, PFN_DOWN((faddr & PMD_MASK) + PMD_SIZE));
+	nr = end - start;
+
+	/*
+	 * Copy the ptes without the page table lock: they only tell what
+	 * to read ahead, and a stale one just costs a read.
+	 */
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0; i < nr; i++) {
+		if (pte_none(ptes[i]) || pte_present(ptes[i]) ||
+		    pte_file(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = __read_swap_cache_async(entry, gfp_mask, vma,
+					       (start + i) << PAGE_SHIFT,
+					       &allocated);
+		if (!page)
+			continue;
+		if (allocated && start + i != fpfn) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
+		page_cache_release(page);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
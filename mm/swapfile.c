@@ -42,6 +42,9 @@ long total_swap_pages;
 static int swap_overflow;
 static int least_priority;
 
+/* Swap devices in use that are not flagged SWP_SOLIDSTATE */
+atomic_t nr_rotate_swap = ATOMIC_INIT(0);
+
 static const char Bad_file[] = "Bad swap file entry ";
 static const char Unused_file[] = "Unused swap file entry ";
 static const char Bad_offset[] = "Bad swap offset entry ";
@@ -1660,6 +1663,8 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	p->max = 0;
 	swap_map = p->swap_map;
 	p->swap_map = NULL;
+	if (!(p->flags & SWP_SOLIDSTATE))
+		atomic_dec(&nr_rotate_swap);
 	p->flags = 0;
 	spin_unlock(&swap_lock);
 	mutex_unlock(&swapon_mutex);
@@ -2029,6 +2034,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 		p->prio = --least_priority;
 	p->swap_map = swap_map;
 	p->flags |= SWP_WRITEOK;
+	if (!(p->flags & SWP_SOLIDSTATE))
+		atomic_inc(&nr_rotate_swap);
 	nr_swap_pages += nr_good_pages;
 	total_swap_pages += nr_good_pages;
 
@@ -2208,21 +2215,21 @@ get_swap_info_struct(unsigned type)
  * swap_lock prevents swap_map being freed. Don't grab an extra
  * reference on the swaphandle, it doesn't matter if it becomes unused.
  */
-int valid_swaphandles(swp_entry_t entry, unsigned long *offset)
+int valid_swaphandles(swp_entry_t entry, unsigned long *offset,
+		      unsigned int window)
 {
 	struct swap_info_struct *si;
-	int our_page_cluster = page_cluster;
 	pgoff_t target, toff;
 	pgoff_t base, end;
 	int nr_pages = 0;
 
-	if (!our_page_cluster)	/* no readahead */
+	if (window <= 1)	/* no readahead */
 		return 0;
 
 	si = &swap_info[swp_type(entry)];
 	target = swp_offset(entry);
-	base = (target >> our_page_cluster) << our_page_cluster;
-	end = base + (1 << our_page_cluster);
+	base = target & ~((pgoff_t)window - 1);
+	end = base + window;
 	if (!base)		/* first page is swap header */
 		base++;
 
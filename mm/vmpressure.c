@@ -0,0 +1,302 @@
+/*
+ *  linux/mm/vmpressure.c
+ *
+ *  Memory pressure notifications for the memory controller
+ *
+ * Userspace that frees memory on demand, such as a low memory killer or
+ * a cache that can shrink, wants to know when reclaim starts to struggle,
+ * before the allocations that need the memory stall and long before the
+ * OOM killer.  The free page counts in /proc/meminfo don't tell: they are
+ * low on a healthy system with plenty of clean page cache.
+ *
+ * What does tell is how efficient reclaim is: the share of the pages it
+ * scans that it fails to reclaim.  Reclaim reports the pages it scanned
+ * and reclaimed to the memory cgroup it worked for, the root for global
+ * reclaim.  Every vmpressure_win scanned pages the ratio is turned into
+ * a level,
+ *
+ *  low       reclaim gets most of what it scans: memory is being reused,
+ *            caches are dropped, it may be time to trim them;
+ *  medium    most of what is scanned is in use, there is swapping or
+ *            refaulting: drop what can be recreated cheaply;
+ *  critical  reclaim gets almost nothing, or it had to scan at a very
+ *            high priority: the system is about to thrash or OOM, act now.
+ *
+ * and listeners registered through cgroup.event_control on the cgroup's
+ * memory.pressure_level file for that level or a lower one get an eventfd
+ * notification.  If the cgroup has no listener, the event goes up the
+ * hierarchy.  The window is counted in pages scanned, not in time: that
+ * limits the rate of events to the rate of reclaim, and there are none
+ * while there is no reclaim.
+ */
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/swap.h>
+#include <linux/eventfd.h>
+#include <linux/memcontrol.h>
+#include <linux/vmpressure.h>
+
+/*
+ * The window size is the number of scanned pages after which the
+ * pressure is evaluated.  A multiple of SWAP_CLUSTER_MAX, the unit reclaim
+ * works in; 512 pages is 2MB with 4K pages.
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+/* Thresholds, in % of scanned pages not reclaimed, of medium and critical */
+static const unsigned int vmpressure_level_med = 60;
+static const unsigned int vmpressure_level_critical = 95;
+
+/*
+ * Reclaim that has to go down to this priority, scanning an eighth of
+ * the LRU lists in one pass where it starts with 1/4096 of them, is in
+ * critical trouble whatever it reclaims.
+ */
+static const int vmpressure_level_critical_prio = 3;
+
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+static const char * const vmpressure_str_levels[] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+struct vmpressure_event {
+	struct eventfd_ctx *efd;
+	enum vmpressure_levels level;
+	struct list_head node;
+};
+
+static enum vmpressure_levels vmpressure_level(unsigned long pressure)
+{
+	if (pressure >= vmpressure_level_critical)
+		return VMPRESSURE_CRITICAL;
+	else if (pressure >= vmpressure_level_med)
+		return VMPRESSURE_MEDIUM;
+	return VMPRESSURE_LOW;
+}
+
+static enum vmpressure_levels vmpressure_calc_level(unsigned long scanned,
+						    unsigned long reclaimed)
+{
+	unsigned long pressure;
+
+	/*
+	 * Lumpy reclaim can free more pages than it scanned from the LRU
+	 * lists: that is no pressure at all.
+	 */
+	if (reclaimed >= scanned)
+		return VMPRESSURE_LOW;
+
+	pressure = (scanned - reclaimed) * 100 / scanned;
+	return vmpressure_level(pressure);
+}
+
+static bool vmpressure_event(struct vmpressure *vmpr,
+			     unsigned long scanned, unsigned long reclaimed)
+{
+	struct vmpressure_event *ev;
+	enum vmpressure_levels level;
+	bool signalled = false;
+
+	level = vmpressure_calc_level(scanned, reclaimed);
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (level >= ev->level) {
+			eventfd_signal(ev->efd, 1);
+			signalled = true;
+		}
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	return signalled;
+}
+
+static void vmpressure_work_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = container_of(work, struct vmpressure, work);
+	unsigned long scanned, reclaimed;
+
+	spin_lock(&vmpr->sr_lock);
+	scanned = vmpr->scanned;
+	reclaimed = vmpr->reclaimed;
+	vmpr->scanned = 0;
+	vmpr->reclaimed = 0;
+	spin_unlock(&vmpr->sr_lock);
+
+	/* another run of the work already took the window */
+	if (!scanned)
+		return;
+
+	/*
+	 * Pressure in a cgroup is pressure in its ancestors too, but
+	 * only the nearest listeners need to hear about it.
+	 */
+	do {
+		if (vmpressure_event(vmpr, scanned, reclaimed))
+			break;
+	} while ((vmpr = vmpressure_parent(vmpr)));
+}
+
+/**
+ * vmpressure - account memory pressure through scanned/reclaimed ratio
+ * @gfp: reclaimer's gfp mask
+ * @mem: cgroup memory controller handle, NULL for global reclaim
+ * @scanned: number of pages scanned
+ * @reclaimed: number of pages reclaimed
+ *
+ * Called by reclaim after each round of scanning a zone's LRU lists.
+ * Once a window's worth of pages has been scanned, the pressure is
+ * evaluated and signalled from a work item, outside reclaim.
+ */
+void vmpressure(gfp_t gfp, struct mem_cgroup *mem,
+		unsigned long scanned, unsigned long reclaimed)
+{
+	struct vmpressure *vmpr;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	/*
+	 * Only count pressure userspace can relieve: freeing memory in
+	 * userspace does not help an allocation that needs, say, DMA
+	 * memory, which userspace pages are unlikely to be.  kswapd
+	 * reclaims with GFP_KERNEL and counts.
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	/*
+	 * Nothing scanned means no LRU pages to scan at this priority,
+	 * which isn't pressure yet; if it gets serious, vmpressure_prio()
+	 * reports it.
+	 */
+	if (!scanned)
+		return;
+
+	vmpr = memcg_to_vmpressure(mem);
+	if (!vmpr)
+		return;
+
+	spin_lock(&vmpr->sr_lock);
+	vmpr->scanned += scanned;
+	vmpr->reclaimed += reclaimed;
+	scanned = vmpr->scanned;
+	spin_unlock(&vmpr->sr_lock);
+
+	if (scanned < vmpressure_win || work_pending(&vmpr->work))
+		return;
+	schedule_work(&vmpr->work);
+}
+
+/**
+ * vmpressure_prio - account memory pressure through reclaim priority level
+ * @gfp: reclaimer's gfp mask
+ * @mem: cgroup memory controller handle, NULL for global reclaim
+ * @prio: reclaim's priority
+ *
+ * Called by direct reclaim as it starts each priority level.  When
+ * reclaim has to go as deep as vmpressure_level_critical_prio, that is
+ * critical pressure: account a window with nothing reclaimed.
+ */
+void vmpressure_prio(gfp_t gfp, struct mem_cgroup *mem, int prio)
+{
+	if (prio > vmpressure_level_critical_prio)
+		return;
+
+	vmpressure(gfp, mem, vmpressure_win, 0);
+}
+
+/**
+ * vmpressure_register_event - bind an eventfd to a pressure level
+ * @cgrp: cgroup that is interested in vmpressure notifications
+ * @cft: cgroup control files handle
+ * @eventfd: eventfd context to link notifications with
+ * @args: event arguments: "low", "medium" or "critical"
+ *
+ * The eventfd is signalled when the pressure in @cgrp is at the given
+ * level or above.  Called by cgroup.event_control.
+ */
+int vmpressure_register_event(struct cgroup *cgrp, struct cftype *cft,
+			      struct eventfd_ctx *eventfd, const char *args)
+{
+	struct vmpressure *vmpr = cgroup_to_vmpressure(cgrp);
+	struct vmpressure_event *ev;
+	int level;
+
+	for (level = 0; level < VMPRESSURE_NUM_LEVELS; level++) {
+		if (!strcmp(vmpressure_str_levels[level], args))
+			break;
+	}
+	if (level == VMPRESSURE_NUM_LEVELS)
+		return -EINVAL;
+
+	ev = kzalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+
+	ev->efd = eventfd;
+	ev->level = level;
+
+	mutex_lock(&vmpr->events_lock);
+	list_add(&ev->node, &vmpr->events);
+	mutex_unlock(&vmpr->events_lock);
+
+	return 0;
+}
+
+/**
+ * vmpressure_unregister_event - unbind an eventfd from vmpressure
+ * @cgrp: cgroup the eventfd was registered with
+ * @cft: cgroup control files handle
+ * @eventfd: eventfd context that was used to link vmpressure with @cgrp
+ *
+ * Called when the eventfd is closed or the cgroup removed.
+ */
+int vmpressure_unregister_event(struct cgroup *cgrp, struct cftype *cft,
+				struct eventfd_ctx *eventfd)
+{
+	struct vmpressure *vmpr = cgroup_to_vmpressure(cgrp);
+	struct vmpressure_event *ev;
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (ev->efd != eventfd)
+			continue;
+		list_del(&ev->node);
+		kfree(ev);
+		break;
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	return 0;
+}
+
+/**
+ * vmpressure_init - initialize vmpressure control structure
+ * @vmpr: structure to be initialized
+ */
+void vmpressure_init(struct vmpressure *vmpr)
+{
+	spin_lock_init(&vmpr->sr_lock);
+	mutex_init(&vmpr->events_lock);
+	INIT_LIST_HEAD(&vmpr->events);
+	INIT_WORK(&vmpr->work, vmpressure_work_fn);
+}
+
+/**
+ * vmpressure_cleanup - wait for a pending notification before freeing
+ * @vmpr: structure that is going away
+ */
+void vmpressure_cleanup(struct vmpressure *vmpr)
+{
+	flush_work(&vmpr->work);
+}
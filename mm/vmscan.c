@@ -40,6 +40,7 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -475,6 +476,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap, page);
 	} else {
+		workingset_eviction(mapping, page);
 		__remove_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -1651,7 +1653,11 @@ static void get_scan_ratio(struct zone *zone, struct scan_control *sc,
 
 	/*
 	 * With swappiness at 100, anonymous and file have the same priority.
-	 * This scanning priority is essentially the inverse of IO cost.
+	 * This scanning priority is essentially the inverse of IO cost:
+	 * above 100, for swap that is cheaper than file IO such as zram,
+	 * anon is preferred.  File pages that refault soon after eviction
+	 * are activated, which counts them as rotated here and shifts the
+	 * balance towards anon as the page cache starts to thrash.
 	 */
 	anon_prio = sc->swappiness;
 	file_prio = 200 - sc->swappiness;
@@ -1718,6 +1724,7 @@ static void shrink_zone(int priority, struct zone *zone,
 	unsigned long percent[2];	/* anon @ 0; file @ 1 */
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
+	unsigned long nr_scanned = sc->nr_scanned;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
 	int noswap = 0;
@@ -1769,6 +1776,9 @@ static void shrink_zone(int priority, struct zone *zone,
 			break;
 	}
 
+	vmpressure(sc->gfp_mask, sc->mem_cgroup,
+		   sc->nr_scanned - nr_scanned,
+		   nr_reclaimed - sc->nr_reclaimed);
 	sc->nr_reclaimed = nr_reclaimed;
 
 	/*
@@ -1886,6 +1896,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token();
+		vmpressure_prio(sc->gfp_mask, sc->mem_cgroup, priority);
 		shrink_zones(priority, zonelist, sc);
 		/*
 		 * Don't shrink slabs when reclaiming memory from
@@ -0,0 +1,203 @@
+/*
+ *  linux/mm/workingset.c
+ *
+ *  Workingset detection: refault distances of evicted page cache pages
+ */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/init.h>
+
+/*
+ * Reclaim can't tell a file page that is used once from one that is
+ * part of the working set but gets evicted before its second access
+ * promotes it: the inactive list is too short to hold it.  When the
+ * whole working set doesn't fit, as after an app switch on a phone,
+ * the page cache thrashes while cold anonymous memory stays resident.
+ *
+ * So remember when pages were evicted.  Each zone counts its evictions
+ * and activations in zone->inactive_age.  When a page refaults, the
+ * evictions and activations since its eviction, the refault distance,
+ * are how much longer the inactive list would have had to be to keep it
+ * until the second access.  Deactivating that many active pages would
+ * have done it, so when the distance is at most the size of the active
+ * file list the page is activated right away.  It then competes with
+ * the active pages; only a real working set change pushes them out.
+ *
+ * The refault activation also counts as a rotated file page in the
+ * zone's reclaim statistics, which makes get_scan_ratio() move pressure
+ * from the file lists to anon.
+ *
+ * The page cache radix tree has no room for the eviction information,
+ * so it is kept in a separate hash table of non-resident pages, indexed
+ * by mapping and offset.  Each bucket holds NONRES_SLOTS slots reused in
+ * FIFO order, 64 bytes with its lock: one cache line on most CPUs, two
+ * aligned ones with the 32 byte lines of the Cortex-A9.  A slot holds a
+ * cookie of the mapping and offset, and the zone and inactive_age at
+ * eviction.  Entries are not removed when the file is truncated: they
+ * age out, and a false match at worst activates a page.
+ */
+
+#define NONRES_SLOTS	7
+
+struct nonres_slot {
+	u32	cookie;		/* 0 if unused */
+	u32	eviction;	/* inactive_age | zone */
+};
+
+struct nonres_bucket {
+	spinlock_t		lock;
+	unsigned int		hand;
+	struct nonres_slot	slots[NONRES_SLOTS];
+} ____cacheline_aligned_in_smp;
+
+#define EVICTION_SHIFT	(ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0U >> EVICTION_SHIFT)
+
+static struct nonres_bucket *nonres_table __read_mostly;
+static unsigned int nonres_mask __read_mostly;
+
+static struct nonres_bucket *nonres_hash(struct address_space *mapping,
+					 pgoff_t index, u32 *cookie)
+{
+	u32 key = hash_ptr(mapping, 32);
+
+	*cookie = jhash_2words(key, (u32)index, 0x5f3759df) | 1;
+	return &nonres_table[jhash_2words(key, (u32)index, 0) & nonres_mask];
+}
+
+static u32 pack_eviction(struct zone *zone)
+{
+	u32 eviction = atomic_long_read(&zone->inactive_age);
+
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	return eviction;
+}
+
+static struct zone *unpack_eviction(u32 eviction, u32 *age)
+{
+	int zid = eviction & ((1U << ZONES_SHIFT) - 1);
+	int nid = (eviction >> ZONES_SHIFT) & ((1U << NODES_SHIFT) - 1);
+
+	*age = eviction >> EVICTION_SHIFT;
+	return NODE_DATA(nid)->node_zones + zid;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page cache page
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Called by reclaim, under the mapping's tree_lock, as it removes @page
+ * from the page cache.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	struct nonres_bucket *b;
+	u32 cookie;
+
+	atomic_long_inc(&zone->inactive_age);
+	if (!nonres_table)
+		return;
+
+	b = nonres_hash(mapping, page->index, &cookie);
+	spin_lock(&b->lock);
+	b->slots[b->hand].cookie = cookie;
+	b->slots[b->hand].eviction = pack_eviction(zone);
+	if (++b->hand == NONRES_SLOTS)
+		b->hand = 0;
+	spin_unlock(&b->lock);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @mapping: address space the page is read into
+ * @index: offset of the page in @mapping
+ *
+ * Returns 1 if the page at @index was evicted recently enough to be part
+ * of the working set, and should go straight to the active list.
+ */
+int workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	struct nonres_bucket *b;
+	struct zone *zone;
+	u32 cookie, eviction = 0, age;
+	unsigned long distance;
+	int i;
+
+	if (!nonres_table)
+		return 0;
+
+	b = nonres_hash(mapping, index, &cookie);
+	spin_lock(&b->lock);
+	for (i = 0; i < NONRES_SLOTS; i++) {
+		if (b->slots[i].cookie == cookie) {
+			b->slots[i].cookie = 0;
+			eviction = b->slots[i].eviction;
+			break;
+		}
+	}
+	spin_unlock(&b->lock);
+	if (i == NONRES_SLOTS)
+		return 0;
+
+	zone = unpack_eviction(eviction, &age);
+	distance = ((u32)atomic_long_read(&zone->inactive_age) - age) &
+		   EVICTION_MASK;
+
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+	if (distance > zone_page_state(zone, NR_ACTIVE_FILE))
+		return 0;
+
+	inc_zone_state(zone, WORKINGSET_ACTIVATE);
+	return 1;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/*
+ * Remember as many evicted pages as half the pages of memory: refault
+ * distances larger than the active file lists don't matter.
+ */
+static int __init workingset_init(void)
+{
+	struct nonres_bucket *table;
+	unsigned long buckets, i;
+
+	buckets = totalram_pages / 2 / NONRES_SLOTS;
+	buckets = roundup_pow_of_two(max(buckets, 1UL));
+	table = vmalloc(buckets * sizeof(*table));
+	if (!table) {
+		printk(KERN_WARNING "workingset: no memory for %lu buckets, "
+		       "refault detection disabled\n", buckets);
+		return -ENOMEM;
+	}
+	for (i = 0; i < buckets; i++) {
+		spin_lock_init(&table[i].lock);
+		table[i].hand = 0;
+		memset(table[i].slots, 0, sizeof(table[i].slots));
+	}
+	nonres_mask = buckets - 1;
+	/* publish the table only once it is set up */
+	smp_wmb();
+	nonres_table = table;
+
+	printk(KERN_INFO "workingset: tracking %lu evicted pages\n",
+	       buckets * NONRES_SLOTS);
+	return 0;
+}
+module_init(workingset_init);
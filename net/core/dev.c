@@ -2063,7 +2063,14 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb)
 			goto done;
 
 		ip = (struct iphdr *) skb->data;
-		ip_proto = ip->protocol;
+		/*
+		 * Only the first fragment has the ports: hash all of them
+		 * by address, so they meet on one CPU for reassembly.
+		 */
+		if (ip->frag_off & htons(IP_MF | IP_OFFSET))
+			ip_proto = 0;
+		else
+			ip_proto = ip->protocol;
 		addr1 = ip->saddr;
 		addr2 = ip->daddr;
 		ihl = ip->ihl;
@@ -2580,18 +2587,30 @@ int netif_receive_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(netif_receive_skb);
 
-/* Network device is going away, flush any packets still pending  */
+/*
+ * Network device is going away, flush any packets still pending.
+ * Called with interrupts off; other CPUs may be steering packets to
+ * this CPU's input_pkt_queue, so that one is walked under its lock.
+ */
 static void flush_backlog(void *arg)
 {
 	struct net_device *dev = arg;
 	struct softnet_data *queue = &__get_cpu_var(softnet_data);
 	struct sk_buff *skb, *tmp;
 
+	spin_lock(&queue->input_pkt_queue.lock);
 	skb_queue_walk_safe(&queue->input_pkt_queue, skb, tmp)
 		if (skb->dev == dev) {
 			__skb_unlink(skb, &queue->input_pkt_queue);
 			kfree_skb(skb);
 		}
+	spin_unlock(&queue->input_pkt_queue.lock);
+
+	skb_queue_walk_safe(&queue->process_queue, skb, tmp)
+		if (skb->dev == dev) {
+			__skb_unlink(skb, &queue->process_queue);
+			kfree_skb(skb);
+		}
 }
 
 static int napi_gro_complete(struct sk_buff *skb)
@@ -2903,27 +2922,50 @@ int napi_gro_frags(struct napi_struct *napi)
 }
 EXPORT_SYMBOL(napi_gro_frags);
 
+/*
+ * With RPS, the CPU taking the interrupts keeps appending to this CPU's
+ * input_pkt_queue.  Rather than bounce its lock between the two for
+ * every packet, move everything queued so far to process_queue, which
+ * only this CPU touches, and work from there.  Interrupts are off while
+ * process_queue is manipulated, against flush_backlog().
+ */
 static int process_backlog(struct napi_struct *napi, int quota)
 {
 	int work = 0;
-	struct softnet_data *queue = &__get_cpu_var(softnet_data);
-	unsigned long start_time = jiffies;
+	struct softnet_data *queue = container_of(napi, struct softnet_data,
+						  backlog);
 
 	napi->weight = weight_p;
-	do {
+	local_irq_disable();
+	while (work < quota) {
 		struct sk_buff *skb;
+		unsigned int qlen;
+
+		while ((skb = __skb_dequeue(&queue->process_queue))) {
+			local_irq_enable();
+			__netif_receive_skb(skb);
+			if (++work >= quota)
+				return work;
+			local_irq_disable();
+		}
 
-		spin_lock_irq(&queue->input_pkt_queue.lock);
-		skb = __skb_dequeue(&queue->input_pkt_queue);
-		if (!skb) {
+		spin_lock(&queue->input_pkt_queue.lock);
+		qlen = skb_queue_len(&queue->input_pkt_queue);
+		if (qlen)
+			skb_queue_splice_tail_init(&queue->input_pkt_queue,
+						   &queue->process_queue);
+		/*
+		 * Complete once what is left fits in the quota: the next
+		 * packet enqueued finds input_pkt_queue empty and schedules
+		 * the backlog again.
+		 */
+		if (qlen < quota - work) {
 			__napi_complete(napi);
-			spin_unlock_irq(&queue->input_pkt_queue.lock);
-			break;
+			quota = work + qlen;
 		}
-		spin_unlock_irq(&queue->input_pkt_queue.lock);
-
-		__netif_receive_skb(skb);
-	} while (++work < quota && jiffies == start_time);
+		spin_unlock(&queue->input_pkt_queue.lock);
+	}
+	local_irq_enable();
 
 	return work;
 }
@@ -3348,10 +3390,12 @@ static int softnet_seq_show(struct seq_file *seq, void *v)
 {
 	struct netif_rx_stats *s = v;
 
-	seq_printf(seq, "%08x %08x %08x %08x %08x %08x %08x %08x %08x %08x\n",
+	seq_printf(seq, "%08x %08x %08x %08x %08x %08x %08x %08x %08x %08x "
+		   "%08x %08x\n",
 		   s->total, s->dropped, s->time_squeeze, 0,
 		   0, 0, 0, 0, /* was fastroute */
-		   s->cpu_collision, s->received_rps);
+		   s->cpu_collision, s->received_rps,
+		   s->skb_recycled, s->skb_reused);
 	return 0;
 }
 
@@ -5718,9 +5762,30 @@ static int dev_cpu_callback(struct notifier_block *nfb,
 	oldsd->output_queue = NULL;
 
 	raise_softirq_irqoff(NET_TX_SOFTIRQ);
+
+	/*
+	 * Take over the NAPI instances scheduled on the offline CPU.  Its
+	 * backlog is drained below instead; it may also have been marked
+	 * scheduled by an RPS sender whose IPI never arrived, so reset it
+	 * or it would never be scheduled again once the CPU is back.
+	 */
+	while (!list_empty(&oldsd->poll_list)) {
+		struct napi_struct *napi = list_first_entry(&oldsd->poll_list,
+							    struct napi_struct,
+							    poll_list);
+
+		if (napi == &oldsd->backlog)
+			list_del_init(&napi->poll_list);
+		else
+			list_move_tail(&napi->poll_list, &sd->poll_list);
+	}
+	oldsd->backlog.state = 0;
+	raise_softirq_irqoff(NET_RX_SOFTIRQ);
 	local_irq_enable();
 
-	/* Process offline CPU's input_pkt_queue */
+	/* Process offline CPU's backlog */
+	while ((skb = __skb_dequeue(&oldsd->process_queue)))
+		netif_rx(skb);
 	while ((skb = __skb_dequeue(&oldsd->input_pkt_queue)))
 		netif_rx(skb);
 
@@ -5921,6 +5986,7 @@ static int __init net_dev_init(void)
 
 		queue = &per_cpu(softnet_data, i);
 		skb_queue_head_init(&queue->input_pkt_queue);
+		skb_queue_head_init(&queue->process_queue);
 		queue->completion_queue = NULL;
 		INIT_LIST_HEAD(&queue->poll_list);
 
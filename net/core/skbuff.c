@@ -57,6 +57,7 @@
 #include <linux/init.h>
 #include <linux/scatterlist.h>
 #include <linux/errqueue.h>
+#include <linux/cpu.h>
 
 #include <net/protocol.h>
 #include <net/dst.h>
@@ -240,6 +241,65 @@ nodata:
 }
 EXPORT_SYMBOL(__alloc_skb);
 
+/*
+ * When forwarding, every packet received costs an skb allocation and
+ * every packet sent an skb free, two trips through the slab allocator
+ * each.  Drivers that free their completed transmit skbs with
+ * dev_kfree_skb_recycle() or dev_kfree_skb_bulk() have the ones big
+ * enough for a full sized Ethernet frame kept on a per-CPU list, and
+ * __netdev_alloc_skb() hands them out again for receive.
+ *
+ * Requests between half and all of SKB_RECYCLE_SIZE are served from the
+ * list, or else rounded up so that the skb can be recycled in turn; both
+ * sizes come from the same kmalloc cache.  The list holds a NAPI poll's
+ * worth of skbs.
+ */
+#define SKB_RECYCLE_SIZE	(1536 + L1_CACHE_BYTES)
+#define SKB_RECYCLE_MAX		64
+
+static DEFINE_PER_CPU(struct sk_buff_head, skb_recycle_cache);
+
+static inline bool skb_recycle_fits(unsigned int length, gfp_t gfp_mask)
+{
+	return length > SKB_RECYCLE_SIZE / 2 && length <= SKB_RECYCLE_SIZE &&
+	       !(gfp_mask & GFP_DMA);
+}
+
+static struct sk_buff *__netdev_alloc_skb_slab(struct net_device *dev,
+		unsigned int length, gfp_t gfp_mask)
+{
+	int node = dev->dev.parent ? dev_to_node(dev->dev.parent) : -1;
+	struct sk_buff *skb;
+
+	if (skb_recycle_fits(length, gfp_mask))
+		length = SKB_RECYCLE_SIZE;
+
+	skb = __alloc_skb(length + NET_SKB_PAD, gfp_mask, 0, node);
+	if (likely(skb)) {
+		skb_reserve(skb, NET_SKB_PAD);
+		skb->dev = dev;
+	}
+	return skb;
+}
+
+/* Take up to n skbs off this CPU's recycle list */
+static unsigned int skb_recycle_get(struct net_device *dev,
+				    struct sk_buff **skbs, unsigned int n)
+{
+	struct sk_buff_head *cache;
+	unsigned long flags;
+	unsigned int i = 0;
+
+	local_irq_save(flags);
+	cache = &__get_cpu_var(skb_recycle_cache);
+	while (i < n && (skbs[i] = __skb_dequeue(cache)))
+		skbs[i++]->dev = dev;
+	__get_cpu_var(netdev_rx_stat).skb_reused += i;
+	local_irq_restore(flags);
+
+	return i;
+}
+
 /**
  *	__netdev_alloc_skb - allocate an skbuff for rx on a specific device
  *	@dev: network device to receive on
@@ -256,18 +316,46 @@ EXPORT_SYMBOL(__alloc_skb);
 struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 		unsigned int length, gfp_t gfp_mask)
 {
-	int node = dev->dev.parent ? dev_to_node(dev->dev.parent) : -1;
 	struct sk_buff *skb;
 
-	skb = __alloc_skb(length + NET_SKB_PAD, gfp_mask, 0, node);
-	if (likely(skb)) {
-		skb_reserve(skb, NET_SKB_PAD);
-		skb->dev = dev;
-	}
-	return skb;
+	if (skb_recycle_fits(length, gfp_mask) &&
+	    skb_recycle_get(dev, &skb, 1))
+		return skb;
+
+	return __netdev_alloc_skb_slab(dev, length, gfp_mask);
 }
 EXPORT_SYMBOL(__netdev_alloc_skb);
 
+/**
+ *	__netdev_alloc_skb_bulk - allocate skbuffs for rx on a specific device
+ *	@dev: network device to receive on
+ *	@length: length to allocate for each
+ *	@gfp_mask: get_free_pages mask, passed to alloc_skb
+ *	@skbs: array to store the skbuffs in
+ *	@n: number of skbuffs wanted
+ *
+ *	Allocate @n skbuffs as __netdev_alloc_skb() would, taking the
+ *	recycled ones in one go.  Returns the number allocated, fewer than
+ *	@n if there is no free memory.
+ */
+unsigned int __netdev_alloc_skb_bulk(struct net_device *dev,
+		unsigned int length, gfp_t gfp_mask,
+		struct sk_buff **skbs, unsigned int n)
+{
+	unsigned int i = 0;
+
+	if (skb_recycle_fits(length, gfp_mask))
+		i = skb_recycle_get(dev, skbs, n);
+
+	for (; i < n; i++) {
+		skbs[i] = __netdev_alloc_skb_slab(dev, length, gfp_mask);
+		if (!skbs[i])
+			break;
+	}
+	return i;
+}
+EXPORT_SYMBOL(__netdev_alloc_skb_bulk);
+
 struct page *__netdev_alloc_page(struct net_device *dev, gfp_t gfp_mask)
 {
 	int node = dev->dev.parent ? dev_to_node(dev->dev.parent) : -1;
@@ -525,6 +613,81 @@ int skb_recycle_check(struct sk_buff *skb, int skb_size)
 }
 EXPORT_SYMBOL(skb_recycle_check);
 
+/**
+ *	dev_kfree_skb_bulk - free skbuffs, keeping some for receive
+ *	@skbs: array of buffers to free
+ *	@n: number of buffers
+ *
+ *	Drop a reference to each buffer, as dev_kfree_skb() does.  The
+ *	ones that are freed and can hold a full sized Ethernet frame are
+ *	kept on a per-CPU list for netdev_alloc_skb() while there is room.
+ *
+ *	Callers with interrupts disabled always take the plain free path:
+ *	nothing is recycled, each buffer goes to dev_kfree_skb().  That is
+ *	still not dev_kfree_skb_irq(), so this must not be called from
+ *	hard interrupt context.  Meant for transmit completion from a NAPI
+ *	poll, which is where mv643xx_eth, the only user, calls it.
+ */
+void dev_kfree_skb_bulk(struct sk_buff **skbs, unsigned int n)
+{
+	struct sk_buff_head recycle, *cache;
+	struct sk_buff *skb;
+	unsigned long flags;
+	unsigned int i, room;
+	bool recycle_ok = !irqs_disabled();
+
+	__skb_queue_head_init(&recycle);
+	for (i = 0; i < n; i++) {
+		skb = skbs[i];
+		if (!skb)
+			continue;
+		/* no jumbo buffers: they would be wasted on small requests */
+		if (recycle_ok && skb_end_pointer(skb) - skb->head <=
+		    2 * (SKB_RECYCLE_SIZE + NET_SKB_PAD) &&
+		    skb_recycle_check(skb, SKB_RECYCLE_SIZE))
+			__skb_queue_tail(&recycle, skb);
+		else
+			dev_kfree_skb(skb);
+	}
+	if (skb_queue_empty(&recycle))
+		return;
+
+	local_irq_save(flags);
+	cache = &__get_cpu_var(skb_recycle_cache);
+	room = SKB_RECYCLE_MAX - min_t(unsigned int, skb_queue_len(cache),
+				       SKB_RECYCLE_MAX);
+	for (i = 0; i < room && (skb = __skb_dequeue(&recycle)); i++)
+		__skb_queue_head(cache, skb);
+	__get_cpu_var(netdev_rx_stat).skb_recycled += i;
+	local_irq_restore(flags);
+
+	while ((skb = __skb_dequeue(&recycle)))
+		__kfree_skb(skb);
+}
+EXPORT_SYMBOL(dev_kfree_skb_bulk);
+
+/**
+ *	dev_kfree_skb_recycle - free an skbuff, keeping it for receive
+ *	@skb: buffer to free
+ *
+ *	dev_kfree_skb_bulk() for a single buffer.
+ */
+void dev_kfree_skb_recycle(struct sk_buff *skb)
+{
+	dev_kfree_skb_bulk(&skb, 1);
+}
+EXPORT_SYMBOL(dev_kfree_skb_recycle);
+
+static int skb_recycle_cpu_callback(struct notifier_block *nfb,
+				    unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		__skb_queue_purge(&per_cpu(skb_recycle_cache, cpu));
+	return NOTIFY_OK;
+}
+
 static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 {
 	new->tstamp		= old->tstamp;
@@ -1423,7 +1586,7 @@ static inline int spd_fill_page(struct splice_pipe_desc *spd, struct page *page,
 				struct sk_buff *skb, int linear,
 				struct sock *sk)
 {
-	if (unlikely(spd->nr_pages == PIPE_BUFFERS))
+	if (unlikely(spd->nr_pages == spd->nr_pages_max))
 		return 1;
 
 	if (linear) {
@@ -1536,17 +1699,22 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 		    struct pipe_inode_info *pipe, unsigned int tlen,
 		    unsigned int flags)
 {
-	struct partial_page partial[PIPE_BUFFERS];
-	struct page *pages[PIPE_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct page *pages[PIPE_DEF_BUFFERS];
 	struct splice_pipe_desc spd = {
 		.pages = pages,
 		.partial = partial,
+		.nr_pages_max = PIPE_DEF_BUFFERS,
 		.flags = flags,
 		.ops = &sock_pipe_buf_ops,
 		.spd_release = sock_spd_release,
 	};
 	struct sk_buff *frag_iter;
 	struct sock *sk = skb->sk;
+	int ret = 0;
+
+	if (splice_grow_spd(pipe, &spd))
+		return -ENOMEM;
 
 	/*
 	 * __skb_splice_bits() only fails if the output has no room left,
@@ -1569,8 +1737,6 @@ int skb_splice_bits(struct sk_buff *skb, unsigned int offset,
 
 done:
 	if (spd.nr_pages) {
-		int ret;
-
 		/*
 		 * Drop the socket lock, otherwise we have reverse
 		 * locking dependencies between sk_lock and i_mutex
@@ -1583,10 +1749,10 @@ done:
 		release_sock(sk);
 		ret = splice_to_pipe(pipe, &spd);
 		lock_sock(sk);
-		return ret;
 	}
 
-	return 0;
+	splice_shrink_spd(&spd);
+	return ret;
 }
 
 /**
@@ -2778,6 +2944,8 @@ EXPORT_SYMBOL_GPL(skb_gro_receive);
 
 void __init skb_init(void)
 {
+	int cpu;
+
 	skbuff_head_cache = kmem_cache_create("skbuff_head_cache",
 					      sizeof(struct sk_buff),
 					      0,
@@ -2789,6 +2957,10 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+
+	for_each_possible_cpu(cpu)
+		__skb_queue_head_init(&per_cpu(skb_recycle_cache, cpu));
+	hotcpu_notifier(skb_recycle_cpu_callback, 0);
 }
 
 /**
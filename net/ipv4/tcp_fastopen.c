@@ -0,0 +1,263 @@
+/*
+ * TCP fast open: data in the SYN, for clients that have a cookie from
+ * the server.
+ *
+ * A client that connects with sendmsg(MSG_FASTOPEN) asks for a cookie in
+ * its SYN; a listener with fast open enabled gives one in the SYN-ACK,
+ * a MAC of the client's address under a secret of the host.  The client
+ * caches it, and on its next connection to the server puts the cookie
+ * and the first segment of data in the SYN.  The listener checks the
+ * cookie, creates the child right away with the data in its receive
+ * queue and puts it on the accept queue: the application reads the
+ * request and may answer it one round trip before the handshake ends.
+ * Without a valid cookie all this falls back to the usual handshake,
+ * and the client sends the data again after it.
+ *
+ * The cookie travels in the experimental option, 254, with a magic
+ * number, as in draft-ietf-tcpm-fastopen.  IPv4 only: an IPv6 listener
+ * gets here for the v4-mapped SYNs tcp_v6_conn_request() hands over.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/tcp.h>
+#include <linux/random.h>
+#include <linux/cryptohash.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <net/inet_common.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly;
+
+/*
+ * The server side: cookies, and children created from a SYN.
+ */
+
+static __u32 tcp_fastopen_secret[16 - 2 + SHA_DIGEST_WORDS];
+
+static __init int tcp_fastopen_init(void)
+{
+	get_random_bytes(tcp_fastopen_secret, sizeof(tcp_fastopen_secret));
+	return 0;
+}
+__initcall(tcp_fastopen_init);
+
+static DEFINE_PER_CPU(__u32 [16 + SHA_DIGEST_WORDS + SHA_WORKSPACE_WORDS],
+		      tcp_fastopen_scratch);
+
+/* The cookie of the client at saddr, for our address daddr */
+void tcp_fastopen_cookie_gen(__be32 saddr, __be32 daddr,
+			     struct tcp_fastopen_cookie *foc)
+{
+	__u32 *tmp = get_cpu_var(tcp_fastopen_scratch);
+
+	memcpy(tmp + 2, tcp_fastopen_secret, sizeof(tcp_fastopen_secret));
+	tmp[0] = (__force u32)saddr;
+	tmp[1] = (__force u32)daddr;
+	sha_transform(tmp + 16, (__u8 *)tmp, tmp + 16 + SHA_DIGEST_WORDS);
+
+	memcpy(foc->val, tmp + 16, TCP_FASTOPEN_COOKIE_SIZE);
+	foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	put_cpu_var(tcp_fastopen_scratch);
+}
+
+/* Is the data of the SYN acceptable, with the cookie it came with? */
+static int tcp_fastopen_cookie_valid(struct sk_buff *skb,
+				     struct tcp_fastopen_cookie *foc)
+{
+	struct tcp_fastopen_cookie valid;
+
+	if (sysctl_tcp_fastopen & TFO_SERVER_COOKIE_NOT_REQD)
+		return 1;
+	if (foc->len != TCP_FASTOPEN_COOKIE_SIZE)
+		return 0;
+	tcp_fastopen_cookie_gen(ip_hdr(skb)->saddr, ip_hdr(skb)->daddr,
+				&valid);
+	return !memcmp(foc->val, valid.val, TCP_FASTOPEN_COOKIE_SIZE);
+}
+
+/*
+ * Called by tcp_v4_conn_request() for a SYN it answers without a
+ * syncookie, with the fast open option of the SYN in foc.  Returns 1
+ * when the SYN had a valid cookie and req became the request sock of a
+ * child on the accept queue: the SYN-ACK acked its data, and the caller
+ * is done with req.  Otherwise the handshake is the usual one, and the
+ * SYN-ACK gives a cookie if the SYN asked for one or had a stale one.
+ */
+int tcp_fastopen_conn_request(struct sock *sk, struct sk_buff *skb,
+			      struct request_sock *req,
+			      struct tcp_fastopen_cookie *foc)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	int syn_data = TCP_SKB_CB(skb)->end_seq != TCP_SKB_CB(skb)->seq + 1;
+	struct request_sock *acc_req;
+	struct dst_entry *dst;
+	struct tcp_sock *ctp;
+	struct sock *child;
+
+	if (!(sysctl_tcp_fastopen & TFO_SERVER_ENABLE) ||
+	    !tp->fastopen_max_qlen)
+		return 0;
+	/* A client that does not know about fast open */
+	if (foc->len < 0 &&
+	    (!syn_data || !(sysctl_tcp_fastopen & TFO_SERVER_COOKIE_NOT_REQD)))
+		return 0;
+
+	if (!tcp_fastopen_cookie_valid(skb, foc)) {
+		tcp_rsk(req)->fastopen_cookie_req = foc->len >= 0;
+		return 0;
+	}
+
+	/* The SYN goes through the usual handshake, its data is sent
+	 * again after it, when there are too many children yet to
+	 * complete theirs.
+	 */
+	if (tcp_hdr(skb)->fin ||
+	    atomic_read(&tp->fastopen_qlen) >= tp->fastopen_max_qlen ||
+	    sk_acceptq_is_full(sk))
+		return 0;
+
+	/* Takes the child to the accept queue, the child has req */
+	acc_req = inet_reqsk_alloc(&tcp_request_sock_ops);
+	if (!acc_req)
+		return 0;
+
+	dst = inet_csk_route_req(sk, req);
+	if (!dst)
+		goto free_acc_req;
+	tcp_openreq_init_rwin(req, sk, dst);
+	req->retrans = 0;
+	req->sk = NULL;
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
+	if (!child)
+		goto free_acc_req;
+
+	ctp = tcp_sk(child);
+	ctp->fastopen_rsk = req;
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+	tcp_rsk(req)->listener = sk;
+	sock_hold(sk);
+	atomic_inc(&tp->fastopen_qlen);
+
+	/* RFC1323: The window in SYN & SYN/ACK segments is never scaled. */
+	ctp->snd_wnd = ntohs(tcp_hdr(skb)->window);
+
+	tcp_init_metrics(child);
+	tcp_init_congestion_control(child);
+	tcp_init_buffer_space(child);
+	ctp->lsndtime = tcp_time_stamp;
+
+	/* The caller frees the skb, this is the child's reference */
+	if (syn_data) {
+		skb = skb_get(skb);
+		skb_dst_drop(skb);
+		__skb_pull(skb, tcp_hdr(skb)->doff * 4);
+		skb_set_owner_r(skb, child);
+		__skb_queue_tail(&child->sk_receive_queue, skb);
+	}
+	ctp->rcv_nxt = tcp_rsk(req)->rcv_nxt;
+
+	/* The SYN-ACK is the child's to retransmit, req is not hashed in
+	 * the listener's SYN table.
+	 */
+	req->rsk_ops->rtx_syn_ack(child, req);
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+
+	inet_csk_reqsk_queue_add(sk, acc_req, child);
+	sk->sk_data_ready(sk, 0);
+	bh_unlock_sock(child);
+	sock_put(child);
+	return 1;
+
+free_acc_req:
+	__reqsk_free(acc_req);
+	return 0;
+}
+
+/* The child is done with its SYN-ACK: acked, or the child is done */
+void tcp_fastopen_remove(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct request_sock *req = tp->fastopen_rsk;
+	struct sock *lsk = tcp_rsk(req)->listener;
+
+	tp->fastopen_rsk = NULL;
+	atomic_dec(&tcp_sk(lsk)->fastopen_qlen);
+	sock_put(lsk);
+	reqsk_free(req);
+}
+
+/*
+ * The client side: the cookies of the servers, by address, in a table
+ * of TCP_FASTOPEN_CACHE_SIZE entries.  A server whose entry is taken by
+ * another one costs a round trip to get its cookie again.
+ */
+
+#define TCP_FASTOPEN_CACHE_BITS	8
+#define TCP_FASTOPEN_CACHE_SIZE	(1 << TCP_FASTOPEN_CACHE_BITS)
+
+struct tcp_fastopen_cache {
+	__be32				daddr;	/* 0 for an empty entry */
+	u16				mss;	/* of the SYN-ACK */
+	u16				syn_loss; /* SYNs with data lost */
+	unsigned long			last_syn_loss;	/* in jiffies */
+	struct tcp_fastopen_cookie	cookie;
+};
+
+static struct tcp_fastopen_cache tcp_fastopen_cache[TCP_FASTOPEN_CACHE_SIZE];
+static DEFINE_SPINLOCK(tcp_fastopen_cache_lock);
+
+static struct tcp_fastopen_cache *tcp_fastopen_cache_entry(__be32 daddr)
+{
+	return &tcp_fastopen_cache[hash_32((__force u32)daddr,
+					   TCP_FASTOPEN_CACHE_BITS)];
+}
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	__be32 daddr = inet_sk(sk)->daddr;
+	struct tcp_fastopen_cache *e = tcp_fastopen_cache_entry(daddr);
+
+	spin_lock_bh(&tcp_fastopen_cache_lock);
+	if (e->daddr == daddr) {
+		if (e->mss)
+			*mss = e->mss;
+		*cookie = e->cookie;
+		*syn_loss = e->syn_loss;
+		*last_syn_loss = e->last_syn_loss;
+	}
+	spin_unlock_bh(&tcp_fastopen_cache_lock);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, int syn_lost)
+{
+	__be32 daddr = inet_sk(sk)->daddr;
+	struct tcp_fastopen_cache *e = tcp_fastopen_cache_entry(daddr);
+
+	spin_lock_bh(&tcp_fastopen_cache_lock);
+	if (e->daddr != daddr) {
+		memset(e, 0, sizeof(*e));
+		e->daddr = daddr;
+	}
+	if (mss)
+		e->mss = mss;
+	if (cookie->len > 0)
+		e->cookie = *cookie;
+	if (syn_lost) {
+		e->syn_loss++;
+		e->last_syn_loss = jiffies;
+	} else {
+		e->syn_loss = 0;
+	}
+	spin_unlock_bh(&tcp_fastopen_cache_lock);
+}
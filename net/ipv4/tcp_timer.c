@@ -278,6 +278,28 @@ static void tcp_probe_timer(struct sock *sk)
 	}
 }
 
+/* The SYN-ACK of a passive fast open child goes again as the listener
+ * would retransmit it for a request sock, with one more try: the
+ * application may have the child already.
+ */
+static void tcp_fastopen_synack_timer(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct request_sock *req = tcp_sk(sk)->fastopen_rsk;
+	int max_retries = icsk->icsk_syn_retries ? :
+			  sysctl_tcp_synack_retries + 1;
+
+	if (req->retrans >= max_retries) {
+		tcp_write_err(sk);
+		return;
+	}
+	req->rsk_ops->rtx_syn_ack(sk, req);
+	req->retrans++;
+	inet_csk_reset_xmit_timer(sk, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT << req->retrans,
+				  TCP_RTO_MAX);
+}
+
 /*
  *	The TCP retransmit timer.
  */
@@ -287,6 +309,12 @@ void tcp_retransmit_timer(struct sock *sk)
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct inet_connection_sock *icsk = inet_csk(sk);
 
+	/* Nothing else goes again before the SYN-ACK is acked */
+	if (tp->fastopen_rsk) {
+		tcp_fastopen_synack_timer(sk);
+		return;
+	}
+
 	if (!tp->packets_out)
 		goto out;
 
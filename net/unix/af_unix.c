@@ -114,12 +114,19 @@
 #include <linux/mount.h>
 #include <net/checksum.h>
 #include <linux/security.h>
+#include <linux/hash.h>
 
-static struct hlist_head unix_socket_table[UNIX_HASH_SIZE + 1];
-static DEFINE_SPINLOCK(unix_table_lock);
-static atomic_t unix_nr_socks = ATOMIC_INIT(0);
+/*
+ * Bound sockets are hashed by name, or by inode for filesystem sockets,
+ * into the first UNIX_HASH_SIZE buckets; unbound sockets by address into
+ * the second half.  Each bucket has its own lock, sk->sk_hash is the
+ * bucket of a socket.
+ */
+#define UNIX_TABLE_SIZE		(2 * UNIX_HASH_SIZE)
 
-#define unix_sockets_unbound	(&unix_socket_table[UNIX_HASH_SIZE])
+static struct hlist_head unix_socket_table[UNIX_TABLE_SIZE];
+static spinlock_t unix_table_locks[UNIX_TABLE_SIZE];
+static atomic_t unix_nr_socks = ATOMIC_INIT(0);
 
 #define UNIX_ABSTRACT(sk)	(unix_sk(sk)->addr->hash != UNIX_HASH_SIZE)
 
@@ -143,7 +150,9 @@ static inline void unix_set_secdata(struct scm_cookie *scm, struct sk_buff *skb)
 
 /*
  *  SMP locking strategy:
- *    hash table is protected with spinlock unix_table_lock
+ *    each hash table bucket is protected with its spinlock in
+ *    unix_table_locks, binding takes the bound bucket's then the unbound
+ *    bucket's.
  *    each socket state is protected by separate rwlock.
  */
 
@@ -225,24 +234,47 @@ static void __unix_remove_socket(struct sock *sk)
 	sk_del_node_init(sk);
 }
 
-static void __unix_insert_socket(struct hlist_head *list, struct sock *sk)
+static void __unix_insert_socket(unsigned int hash, struct sock *sk)
 {
 	WARN_ON(!sk_unhashed(sk));
-	sk_add_node(sk, list);
+	sk->sk_hash = hash;
+	sk_add_node(sk, &unix_socket_table[hash]);
 }
 
 static inline void unix_remove_socket(struct sock *sk)
 {
-	spin_lock(&unix_table_lock);
+	spinlock_t *lock = &unix_table_locks[sk->sk_hash];
+
+	spin_lock(lock);
 	__unix_remove_socket(sk);
-	spin_unlock(&unix_table_lock);
+	spin_unlock(lock);
+}
+
+static inline void unix_insert_unbound_socket(struct sock *sk)
+{
+	unsigned int hash = UNIX_HASH_SIZE + hash_ptr(sk, UNIX_HASH_BITS);
+
+	spin_lock(&unix_table_locks[hash]);
+	__unix_insert_socket(hash, sk);
+	spin_unlock(&unix_table_locks[hash]);
 }
 
-static inline void unix_insert_socket(struct hlist_head *list, struct sock *sk)
+/*
+ * Lock the bucket a socket is bound into, @hash, and its unbound bucket,
+ * @old_hash.  The bound buckets come first in the table and are locked
+ * first.  The socket moves to @hash under the locks: the caller keeps
+ * @old_hash to unlock.
+ */
+static void unix_table_double_lock(unsigned int old_hash, unsigned int hash)
 {
-	spin_lock(&unix_table_lock);
-	__unix_insert_socket(list, sk);
-	spin_unlock(&unix_table_lock);
+	spin_lock(&unix_table_locks[hash]);
+	spin_lock_nested(&unix_table_locks[old_hash], SINGLE_DEPTH_NESTING);
+}
+
+static void unix_table_double_unlock(unsigned int old_hash, unsigned int hash)
+{
+	spin_unlock(&unix_table_locks[old_hash]);
+	spin_unlock(&unix_table_locks[hash]);
 }
 
 static struct sock *__unix_find_socket_byname(struct net *net,
@@ -272,24 +304,25 @@ static inline struct sock *unix_find_socket_byname(struct net *net,
 						   int len, int type,
 						   unsigned hash)
 {
+	spinlock_t *lock = &unix_table_locks[hash ^ type];
 	struct sock *s;
 
-	spin_lock(&unix_table_lock);
+	spin_lock(lock);
 	s = __unix_find_socket_byname(net, sunname, len, type, hash);
 	if (s)
 		sock_hold(s);
-	spin_unlock(&unix_table_lock);
+	spin_unlock(lock);
 	return s;
 }
 
 static struct sock *unix_find_socket_byinode(struct net *net, struct inode *i)
 {
+	unsigned int hash = i->i_ino & (UNIX_HASH_SIZE - 1);
 	struct sock *s;
 	struct hlist_node *node;
 
-	spin_lock(&unix_table_lock);
-	sk_for_each(s, node,
-		    &unix_socket_table[i->i_ino & (UNIX_HASH_SIZE - 1)]) {
+	spin_lock(&unix_table_locks[hash]);
+	sk_for_each(s, node, &unix_socket_table[hash]) {
 		struct dentry *dentry = unix_sk(s)->dentry;
 
 		if (!net_eq(sock_net(s), net))
@@ -302,7 +335,7 @@ static struct sock *unix_find_socket_byinode(struct net *net, struct inode *i)
 	}
 	s = NULL;
 found:
-	spin_unlock(&unix_table_lock);
+	spin_unlock(&unix_table_locks[hash]);
 	return s;
 }
 
@@ -611,7 +644,7 @@ static struct sock *unix_create1(struct net *net, struct socket *sock)
 	INIT_LIST_HEAD(&u->link);
 	mutex_init(&u->readlock); /* single task reading lock */
 	init_waitqueue_head(&u->peer_wait);
-	unix_insert_socket(unix_sockets_unbound, sk);
+	unix_insert_unbound_socket(sk);
 out:
 	if (sk == NULL)
 		atomic_dec(&unix_nr_socks);
@@ -673,7 +706,7 @@ static int unix_autobind(struct socket *sock)
 	static u32 ordernum = 1;
 	struct unix_address *addr;
 	int err;
-	unsigned int retries = 0;
+	unsigned int old_hash, hash, retries = 0;
 
 	mutex_lock(&u->readlock);
 
@@ -693,12 +726,14 @@ retry:
 	addr->len = sprintf(addr->name->sun_path+1, "%05x", ordernum) + 1 + sizeof(short);
 	addr->hash = unix_hash_fold(csum_partial(addr->name, addr->len, 0));
 
-	spin_lock(&unix_table_lock);
+	hash = addr->hash ^ sk->sk_type;
+	old_hash = sk->sk_hash;
+	unix_table_double_lock(old_hash, hash);
 	ordernum = (ordernum+1)&0xFFFFF;
 
 	if (__unix_find_socket_byname(net, addr->name, addr->len, sock->type,
 				      addr->hash)) {
-		spin_unlock(&unix_table_lock);
+		unix_table_double_unlock(old_hash, hash);
 		/*
 		 * __unix_find_socket_byname() may take long time if many names
 		 * are already in use.
@@ -712,12 +747,12 @@ retry:
 		}
 		goto retry;
 	}
-	addr->hash ^= sk->sk_type;
+	addr->hash = hash;
 
 	__unix_remove_socket(sk);
 	u->addr = addr;
-	__unix_insert_socket(&unix_socket_table[addr->hash], sk);
-	spin_unlock(&unix_table_lock);
+	__unix_insert_socket(hash, sk);
+	unix_table_double_unlock(old_hash, hash);
 	err = 0;
 
 out:	mutex_unlock(&u->readlock);
@@ -789,9 +824,8 @@ static int unix_bind(struct socket *sock, struct sockaddr *uaddr, int addr_len)
 	struct dentry *dentry = NULL;
 	struct nameidata nd;
 	int err;
-	unsigned hash;
+	unsigned hash, bucket, old_hash;
 	struct unix_address *addr;
-	struct hlist_head *list;
 
 	err = -EINVAL;
 	if (sunaddr->sun_family != AF_UNIX)
@@ -862,7 +896,13 @@ out_mknod_drop_write:
 		addr->hash = UNIX_HASH_SIZE;
 	}
 
-	spin_lock(&unix_table_lock);
+	if (!sunaddr->sun_path[0])
+		bucket = addr->hash;
+	else
+		bucket = dentry->d_inode->i_ino & (UNIX_HASH_SIZE - 1);
+
+	old_hash = sk->sk_hash;
+	unix_table_double_lock(old_hash, bucket);
 
 	if (!sunaddr->sun_path[0]) {
 		err = -EADDRINUSE;
@@ -871,10 +911,7 @@ out_mknod_drop_write:
 			unix_release_addr(addr);
 			goto out_unlock;
 		}
-
-		list = &unix_socket_table[addr->hash];
 	} else {
-		list = &unix_socket_table[dentry->d_inode->i_ino & (UNIX_HASH_SIZE-1)];
 		u->dentry = nd.path.dentry;
 		u->mnt    = nd.path.mnt;
 	}
@@ -882,10 +919,10 @@ out_mknod_drop_write:
 	err = 0;
 	__unix_remove_socket(sk);
 	u->addr = addr;
-	__unix_insert_socket(list, sk);
+	__unix_insert_socket(bucket, sk);
 
 out_unlock:
-	spin_unlock(&unix_table_lock);
+	unix_table_double_unlock(old_hash, bucket);
 out_up:
 	mutex_unlock(&u->readlock);
 out:
@@ -1382,6 +1419,7 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	long timeo;
 	struct scm_cookie tmp_scm;
 	int max_level = 0;
+	int data_len = 0;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1415,7 +1453,17 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	if (len > sk->sk_sndbuf - 32)
 		goto out;
 
-	skb = sock_alloc_send_skb(sk, len, msg->msg_flags&MSG_DONTWAIT, &err);
+	/*
+	 * A large datagram goes in page fragments beyond an order-2 linear
+	 * part: allocations of higher order are slow, or fail, once memory
+	 * is fragmented.
+	 */
+	if (len > SKB_MAX_ALLOC)
+		data_len = min_t(size_t, len - SKB_MAX_ALLOC,
+				 MAX_SKB_FRAGS * PAGE_SIZE);
+
+	skb = sock_alloc_send_pskb(sk, len - data_len, data_len,
+				   msg->msg_flags & MSG_DONTWAIT, &err);
 	if (skb == NULL)
 		goto out;
 
@@ -1428,8 +1476,11 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	}
 	unix_get_secdata(siocb->scm, skb);
 
+	skb_put(skb, len - data_len);
+	skb->data_len = data_len;
+	skb->len = len;
 	skb_reset_transport_header(skb);
-	err = memcpy_fromiovec(skb_put(skb, len), msg->msg_iov, len);
+	err = skb_copy_datagram_from_iovec(skb, 0, msg->msg_iov, 0, len);
 	if (err)
 		goto out_free;
 
@@ -2127,55 +2178,43 @@ static unsigned int unix_dgram_poll(struct file *file, struct socket *sock,
 }
 
 #ifdef CONFIG_PROC_FS
-static struct sock *first_unix_socket(int *i)
-{
-	for (*i = 0; *i <= UNIX_HASH_SIZE; (*i)++) {
-		if (!hlist_empty(&unix_socket_table[*i]))
-			return __sk_head(&unix_socket_table[*i]);
-	}
-	return NULL;
-}
-
-static struct sock *next_unix_socket(int *i, struct sock *s)
-{
-	struct sock *next = sk_next(s);
-	/* More in this chain? */
-	if (next)
-		return next;
-	/* Look for next non-empty chain. */
-	for ((*i)++; *i <= UNIX_HASH_SIZE; (*i)++) {
-		if (!hlist_empty(&unix_socket_table[*i]))
-			return __sk_head(&unix_socket_table[*i]);
-	}
-	return NULL;
-}
-
+/*
+ * The socket returned by the iterator is in bucket iter->i, whose lock is
+ * held until the iterator moves to the next bucket or stops.
+ */
 struct unix_iter_state {
 	struct seq_net_private p;
 	int i;
 };
 
-static struct sock *unix_seq_idx(struct seq_file *seq, loff_t pos)
+/* The @skip'th socket of the net from bucket iter->i onwards, locked */
+static struct sock *unix_seq_bucket(struct seq_file *seq, loff_t skip)
 {
 	struct unix_iter_state *iter = seq->private;
-	loff_t off = 0;
+	struct hlist_node *node;
 	struct sock *s;
 
-	for (s = first_unix_socket(&iter->i); s; s = next_unix_socket(&iter->i, s)) {
-		if (sock_net(s) != seq_file_net(seq))
-			continue;
-		if (off == pos)
-			return s;
-		++off;
+	for (; iter->i < UNIX_TABLE_SIZE; iter->i++) {
+		spin_lock(&unix_table_locks[iter->i]);
+		sk_for_each(s, node, &unix_socket_table[iter->i]) {
+			if (sock_net(s) != seq_file_net(seq))
+				continue;
+			if (!skip--)
+				return s;
+		}
+		spin_unlock(&unix_table_locks[iter->i]);
 	}
 	return NULL;
 }
 
 static void *unix_seq_start(struct seq_file *seq, loff_t *pos)
-	__acquires(unix_table_lock)
 {
-	spin_lock(&unix_table_lock);
-	return *pos ? unix_seq_idx(seq, *pos - 1) : SEQ_START_TOKEN;
+	struct unix_iter_state *iter = seq->private;
+
+	if (!*pos)
+		return SEQ_START_TOKEN;
+	iter->i = 0;
+	return unix_seq_bucket(seq, *pos - 1);
 }
 
 static void *unix_seq_next(struct seq_file *seq, void *v, loff_t *pos)
@@ -2184,19 +2223,24 @@ static void *unix_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	struct sock *sk = v;
 	++*pos;
 
-	if (v == SEQ_START_TOKEN)
-		sk = first_unix_socket(&iter->i);
-	else
-		sk = next_unix_socket(&iter->i, sk);
-	while (sk && (sock_net(sk) != seq_file_net(seq)))
-		sk = next_unix_socket(&iter->i, sk);
-	return sk;
+	if (v == SEQ_START_TOKEN) {
+		iter->i = 0;
+		return unix_seq_bucket(seq, 0);
+	}
+
+	for (sk = sk_next(sk); sk; sk = sk_next(sk))
+		if (sock_net(sk) == seq_file_net(seq))
+			return sk;
+	spin_unlock(&unix_table_locks[iter->i++]);
+	return unix_seq_bucket(seq, 0);
 }
 
 static void unix_seq_stop(struct seq_file *seq, void *v)
-	__releases(unix_table_lock)
 {
-	spin_unlock(&unix_table_lock);
+	struct unix_iter_state *iter = seq->private;
+
+	if (v && v != SEQ_START_TOKEN)
+		spin_unlock(&unix_table_locks[iter->i]);
 }
 
 static int unix_seq_show(struct seq_file *seq, void *v)
@@ -2305,11 +2349,14 @@ static struct pernet_operations unix_net_ops = {
 
 static int __init af_unix_init(void)
 {
-	int rc = -1;
+	int rc = -1, i;
 	struct sk_buff *dummy_skb;
 
 	BUILD_BUG_ON(sizeof(struct unix_skb_parms) > sizeof(dummy_skb->cb));
 
+	for (i = 0; i < UNIX_TABLE_SIZE; i++)
+		spin_lock_init(&unix_table_locks[i]);
+
 	rc = proto_register(&unix_proto, 1);
 	if (rc != 0) {
 		printk(KERN_CRIT "%s: Cannot create unix_sock SLAB cache!\n",
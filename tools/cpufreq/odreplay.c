@@ -0,0 +1,298 @@
+/*
+ * odreplay.c - replay load traces through the ondemand governor
+ *
+ * Runs the frequency selection of drivers/cpufreq/cpufreq_ondemand.h,
+ * the code the governor itself uses, on a trace of CPU demand and
+ * reports for each trace
+ *
+ *  - the number of frequency transitions (what cpufreq_stats counts),
+ *  - the delay: work left waiting at the end of each sampling window,
+ *    summed over the trace, in percent-of-max-capacity windows,
+ *  - the average frequency, as a rough proxy for power.
+ *
+ * A trace has one sampling window per line: the work arriving in that
+ * window, in percent of what the CPU gets done in one window at the
+ * maximum frequency.  '#' starts a comment.  Work the CPU cannot finish
+ * in a window is carried over to the next one.  Without file arguments
+ * a few synthetic traces are used.
+ *
+ * Every trace is run twice, once with load_history and
+ * sampling_down_factor at 1, which is the old behaviour, and once with
+ * the values given by -H and -d.  The exit status is non-zero when the
+ * second run makes more transitions or delays more work than the first.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../drivers/cpufreq/cpufreq_ondemand.h"
+
+/* Frequency table in kHz, lowest first. */
+static const unsigned int freqs[] = {
+	216000, 312000, 456000, 608000, 760000, 816000, 912000, 1000000,
+};
+#define NR_FREQS	(sizeof(freqs) / sizeof(freqs[0]))
+#define FREQ_MIN	freqs[0]
+#define FREQ_MAX	freqs[NR_FREQS - 1]
+
+static unsigned int up_threshold = 95;
+static unsigned int down_differential = 3;
+static unsigned int load_history = 4;
+static unsigned int sampling_down_factor = 2;
+static unsigned long long seed = 1;
+
+struct result {
+	unsigned int transitions;
+	unsigned long long delay;
+	unsigned long long freq_sum;
+};
+
+static unsigned int rnd(unsigned int n)
+{
+	seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (seed >> 33) % n;
+}
+
+/* Lowest frequency at or above @target, like CPUFREQ_RELATION_L. */
+static unsigned int relation_l(unsigned int target)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_FREQS; i++)
+		if (freqs[i] >= target)
+			return freqs[i];
+	return FREQ_MAX;
+}
+
+static void replay(const unsigned int *demand, unsigned int len,
+		   unsigned int history, unsigned int down_factor,
+		   struct result *r)
+{
+	unsigned int cur = FREQ_MIN, load_avg = 0, rate_mult = 1;
+	unsigned long long backlog = 0;
+	unsigned int i = 0;
+
+	memset(r, 0, sizeof(*r));
+
+	while (i < len) {
+		unsigned long long busy = 0, capacity = 0;
+		unsigned int w, load, load_freq, freq_next, next;
+
+		/* One sampling period is rate_mult windows long. */
+		for (w = 0; w < rate_mult && i < len; w++, i++) {
+			unsigned int cap = 100ULL * cur / FREQ_MAX;
+			unsigned int served;
+
+			backlog += demand[i];
+			served = backlog < cap ? backlog : cap;
+			backlog -= served;
+			busy += served;
+			capacity += cap;
+			r->delay += backlog;
+			r->freq_sum += cur;
+		}
+
+		load = 100 * busy / capacity;
+		load_avg = od_load_avg(load_avg, load, history);
+		load_freq = load * cur;
+
+		next = cur;
+		switch (od_next_freq(load_freq, od_avg_load_freq(load_avg, cur),
+				     cur, FREQ_MIN, up_threshold,
+				     down_differential, &freq_next)) {
+		case OD_UP:
+			if (cur < FREQ_MAX)
+				rate_mult = down_factor;
+			next = FREQ_MAX;
+			break;
+		case OD_DOWN:
+			rate_mult = 1;
+			next = relation_l(freq_next);
+			break;
+		}
+		if (next != cur)
+			r->transitions++;
+		cur = next;
+	}
+}
+
+static int failures;
+
+static void run(const char *name, const unsigned int *demand,
+		unsigned int len)
+{
+	struct result base, tuned;
+
+	replay(demand, len, 1, 1, &base);
+	replay(demand, len, load_history, sampling_down_factor, &tuned);
+
+	printf("%-12s %7u %8u %8u %10llu %10llu %7llu %7llu\n", name, len,
+	       base.transitions, tuned.transitions, base.delay, tuned.delay,
+	       base.freq_sum / len / 1000, tuned.freq_sum / len / 1000);
+
+	if (tuned.transitions > base.transitions || tuned.delay > base.delay) {
+		fprintf(stderr, "%s: load_history %u sampling_down_factor %u "
+			"is worse than the old behaviour\n", name,
+			load_history, sampling_down_factor);
+		failures++;
+	}
+}
+
+#define SYNTH_LEN	10000
+
+/* Busy stretches broken up by single quiet windows, like UI work. */
+static void synth_bursty(unsigned int *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < SYNTH_LEN; i++) {
+		if ((i / 50) % 2)
+			d[i] = rnd(8);
+		else
+			d[i] = rnd(5) ? 70 + rnd(30) : rnd(20);
+	}
+}
+
+/* A frame of work every fourth window. */
+static void synth_frames(unsigned int *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < SYNTH_LEN; i++)
+		d[i] = i % 4 ? rnd(5) : 60 + rnd(40);
+}
+
+/* Long idle and busy phases. */
+static void synth_phases(unsigned int *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < SYNTH_LEN; i++)
+		d[i] = (i / 200) % 2 ? 90 + rnd(10) : rnd(5);
+}
+
+/* A steady medium load. */
+static void synth_steady(unsigned int *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < SYNTH_LEN; i++)
+		d[i] = 40 + rnd(20);
+}
+
+static void synthetic(void)
+{
+	unsigned int *d = malloc(SYNTH_LEN * sizeof(*d));
+
+	if (!d) {
+		perror("malloc");
+		exit(1);
+	}
+	synth_bursty(d);
+	run("bursty", d, SYNTH_LEN);
+	synth_frames(d);
+	run("frames", d, SYNTH_LEN);
+	synth_phases(d);
+	run("phases", d, SYNTH_LEN);
+	synth_steady(d);
+	run("steady", d, SYNTH_LEN);
+	free(d);
+}
+
+static unsigned int *read_trace(const char *path, unsigned int *len)
+{
+	unsigned int *d = NULL, n = 0, size = 0;
+	char line[256];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char *end;
+		unsigned long v;
+
+		line[strcspn(line, "#")] = 0;
+		v = strtoul(line, &end, 0);
+		if (end == line)
+			continue;
+		if (n == size) {
+			size = size ? 2 * size : 1024;
+			d = realloc(d, size * sizeof(*d));
+			if (!d) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		d[n++] = v;
+	}
+	fclose(f);
+	*len = n;
+	return d;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: odreplay [-H load_history] [-d sampling_down_factor] "
+		"[-u up_threshold] [-D down_differential] [-s seed] "
+		"[trace...]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int *d, len;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "H:d:u:D:s:")) != -1) {
+		switch (opt) {
+		case 'H':
+			load_history = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			sampling_down_factor = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			up_threshold = strtoul(optarg, NULL, 0);
+			break;
+		case 'D':
+			down_differential = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!load_history || !sampling_down_factor ||
+	    up_threshold > 100 || down_differential >= up_threshold)
+		usage();
+
+	printf("%-12s %7s %8s %8s %10s %10s %7s %7s\n", "trace", "windows",
+	       "trans", "trans'", "delay", "delay'", "MHz", "MHz'");
+
+	if (optind == argc)
+		synthetic();
+	for (; optind < argc; optind++) {
+		const char *name = strrchr(argv[optind], '/');
+
+		d = read_trace(argv[optind], &len);
+		if (len)
+			run(name ? name + 1 : argv[optind], d, len);
+		free(d);
+	}
+
+	if (failures)
+		return 1;
+	return 0;
+}
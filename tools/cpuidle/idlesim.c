@@ -0,0 +1,237 @@
+/*
+ * idlesim.c - simulated cpuidle driver for the pattern idle governor
+ *
+ * Runs the prediction code of drivers/cpuidle/governors/pattern.h on a
+ * simulated CPU with the two Tegra idle states:
+ *
+ *   LP3  clock gated: exit latency 10us, no target residency
+ *   LP2  power gated: exit latency 2500us, target residency 781us
+ *        (the defaults of arch/arm/mach-tegra/cpuidle.c)
+ *
+ * Like the Tegra driver, the simulated driver demotes LP2 to LP3 when
+ * the next timer is closer than LP2's exit latency plus its target
+ * residency.  Wakeups come from timers, whose time the governor knows,
+ * and from device interrupts, whose time it has to guess.  For each
+ * workload and each way of predicting the idle duration it reports
+ *
+ *  - LP2 entries, and the "wrong" ones: idle for less than LP2's exit
+ *    latency plus target residency, the driver's own threshold,
+ *  - "missed": LP3 periods as long as that threshold,
+ *  - energy, counting LP3 time at LP3 power and each LP2 entry as its
+ *    exit latency plus target residency worth of LP3 time, which is
+ *    where it breaks even, in LP3-milliseconds,
+ *  - latency: LP2 exit latency added to interrupts that ended LP2,
+ *    in milliseconds.  Timer wakeups are programmed early by the
+ *    driver and don't suffer it.
+ *
+ * The predictions compared are
+ *
+ *   timer    the time to the next timer, as the driver used alone
+ *   menu     the same scaled by per-magnitude correction factors
+ *   pattern  the pattern governor
+ *
+ * The exit status is non-zero if pattern makes more wrong LP2 entries
+ * than menu, or more than 2% more than timer, on any workload.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../drivers/cpuidle/governors/pattern.h"
+
+#define LP3_EXIT	10
+#define LP2_EXIT	2500
+#define LP2_RESIDENCY	((80 * LP2_EXIT) >> 8)
+
+#define NEVER		(~0ULL)
+
+enum { PRED_TIMER, PRED_MENU, PRED_PATTERN, NR_PRED };
+static const char * const pred_names[] = { "timer", "menu", "pattern" };
+
+static unsigned int periods = 100000;
+static unsigned long long seed = 1;
+
+struct workload {
+	const char *name;
+	/* timer interval range, us */
+	unsigned int timer_min, timer_max;
+	/* periodic interrupt: period and jitter, us; 0 for none */
+	unsigned int irq_period, irq_jitter;
+	/* random interrupts: mean interval, us; 0 for none */
+	unsigned int irq_mean;
+	/* switch the interrupt sources on and off every this many us */
+	unsigned int phase;
+};
+
+static const struct workload workloads[] = {
+	{ "timers",	1000, 20000,	0, 0,		0,	0 },
+	{ "audio",	50000, 200000,	1500, 50,	0,	0 },
+	{ "touch",	10000, 100000,	8000, 300,	0,	500000 },
+	{ "random",	1000, 50000,	0, 0,		3000,	0 },
+	{ "mixed",	5000, 100000,	2000, 100,	20000,	300000 },
+};
+#define NR_WORKLOADS	(sizeof(workloads) / sizeof(workloads[0]))
+
+struct result {
+	unsigned long lp2, wrong, missed;
+	unsigned long long energy, latency;
+};
+
+static unsigned int rnd(unsigned int n)
+{
+	seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return n ? (seed >> 33) % n : 0;
+}
+
+static unsigned int between(unsigned int lo, unsigned int hi)
+{
+	return lo + rnd(hi - lo + 1);
+}
+
+static void simulate(const struct workload *w, int pred, struct result *r)
+{
+	unsigned long long t = 0, next_timer, next_irq, next_rnd, wake;
+	struct pattern_device data;
+	unsigned int i;
+	int irqs_on = 1;
+
+	pattern_init(&data);
+	memset(r, 0, sizeof(*r));
+
+	next_timer = between(w->timer_min, w->timer_max);
+	next_irq = w->irq_period ? w->irq_period : NEVER;
+	next_rnd = w->irq_mean ? rnd(2 * w->irq_mean) : NEVER;
+
+	for (i = 0; i < periods; i++) {
+		unsigned int expected, predicted, idle, exit_us;
+		unsigned long long irq;
+		int lp2, by_timer;
+
+		if (w->phase)
+			irqs_on = (t / w->phase) % 2 == 0;
+		irq = irqs_on ? (next_irq < next_rnd ? next_irq : next_rnd)
+			      : NEVER;
+
+		expected = next_timer - t;
+		switch (pred) {
+		case PRED_TIMER:
+			predicted = expected;
+			pattern_correct(&data, expected, 0);
+			break;
+		case PRED_MENU:
+			predicted = pattern_correct(&data, expected, 0);
+			break;
+		default:
+			predicted = pattern_predict(&data, expected, 0);
+			break;
+		}
+
+		/* the governor */
+		lp2 = predicted >= LP2_RESIDENCY && predicted >= LP2_EXIT;
+		/* the driver */
+		if (expected <= LP2_EXIT + LP2_RESIDENCY)
+			lp2 = 0;
+		exit_us = lp2 ? LP2_EXIT : LP3_EXIT;
+		data.exit_us = exit_us;
+
+		by_timer = next_timer <= irq;
+		wake = by_timer ? next_timer : irq;
+		idle = wake - t;
+
+		if (lp2) {
+			r->lp2++;
+			if (idle < LP2_EXIT + LP2_RESIDENCY)
+				r->wrong++;
+			r->energy += LP2_EXIT + LP2_RESIDENCY;
+			if (!by_timer)
+				r->latency += LP2_EXIT;
+		} else {
+			if (idle >= LP2_EXIT + LP2_RESIDENCY)
+				r->missed++;
+			r->energy += idle;
+		}
+
+		/* cpuidle measures the exit latency as part of the residency */
+		pattern_update(&data, idle + exit_us);
+
+		/*
+		 * Handle the wakeup, after the exit latency if woken early,
+		 * along with whatever else came up in the meantime.
+		 */
+		t = wake + (by_timer ? 0 : exit_us) + between(50, 300);
+		if (by_timer)
+			next_timer = wake + between(w->timer_min, w->timer_max);
+		if (next_timer <= t)
+			next_timer = t + 1;
+		while (next_irq <= t)
+			next_irq += w->irq_period - w->irq_jitter +
+				    rnd(2 * w->irq_jitter + 1);
+		while (next_rnd <= t)
+			next_rnd += rnd(2 * w->irq_mean) + 1;
+	}
+}
+
+static int failures;
+
+static void run(const struct workload *w)
+{
+	struct result r[NR_PRED];
+	int p;
+
+	for (p = 0; p < NR_PRED; p++) {
+		unsigned long long s = seed;
+
+		simulate(w, p, &r[p]);
+		seed = s;	/* same random sequence for every predictor */
+		printf("%-8s %-8s %8lu %8lu %8lu %10llu %9llu\n",
+		       p ? "" : w->name, pred_names[p], r[p].lp2, r[p].wrong,
+		       r[p].missed, r[p].energy / 1000, r[p].latency / 1000);
+	}
+	rnd(1);
+
+	if (r[PRED_PATTERN].wrong > r[PRED_MENU].wrong ||
+	    r[PRED_PATTERN].wrong > r[PRED_TIMER].wrong +
+				    r[PRED_TIMER].wrong / 50) {
+		fprintf(stderr, "%s: pattern makes more wrong LP2 entries\n",
+			w->name);
+		failures++;
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: idlesim [-n idle_periods] [-s seed]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			periods = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	printf("%-8s %-8s %8s %8s %8s %10s %9s\n", "workload", "predict",
+	       "LP2", "wrong", "missed", "energy", "latency");
+	for (i = 0; i < NR_WORKLOADS; i++)
+		run(&workloads[i]);
+
+	return failures ? 1 : 0;
+}
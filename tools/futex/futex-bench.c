@@ -0,0 +1,216 @@
+/*
+ * futex-bench.c - futex hash bucket contention between processes
+ *
+ * Starts -p processes of -t threads each.  Every thread loops over -f
+ * futexes of its own, calling FUTEX_WAKE, which finds no waiter, and
+ * FUTEX_WAIT with a value that doesn't match, which returns EAGAIN at
+ * once.  Both only take the lock of the futex's hash bucket, so the
+ * operation rate measures how much the threads contend on those locks:
+ * with one hash table for all processes, unrelated futexes share
+ * buckets.  It reports the operations per second, per run and as the
+ * median, e.g.
+ *
+ *   futex-bench -p 4 -t 4
+ *   echo 1 > /proc/sys/kernel/futex_private_hash
+ *   futex-bench -p 4 -t 4
+ *
+ * The futexes are private (FUTEX_PRIVATE_FLAG) unless -S is given.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+static unsigned int nr_procs = 2;
+static unsigned int nr_threads = 4;
+static unsigned int nr_futexes = 64;
+static unsigned int seconds = 2;
+static unsigned int runs = 5;
+static int private_flag = FUTEX_PRIVATE_FLAG;
+
+/* shared between the processes */
+struct shared {
+	volatile int start, stop;
+	unsigned long long ops[];	/* per thread */
+};
+
+static struct shared *shared;
+
+struct thread {
+	unsigned int index;
+	int *futexes;
+};
+
+static int futex(int *uaddr, int op, int val)
+{
+	return syscall(SYS_futex, uaddr, op | private_flag, val, NULL, NULL, 0);
+}
+
+static void *thread_fn(void *arg)
+{
+	struct thread *t = arg;
+	unsigned long long ops = 0;
+	unsigned int i;
+
+	while (!shared->start)
+		;
+	while (!shared->stop) {
+		for (i = 0; i < nr_futexes; i++) {
+			futex(&t->futexes[i], FUTEX_WAKE, 1);
+			if (futex(&t->futexes[i], FUTEX_WAIT, 1) == 0 ||
+			    errno != EAGAIN) {
+				perror("FUTEX_WAIT");
+				exit(1);
+			}
+		}
+		ops += 2 * nr_futexes;
+	}
+	shared->ops[t->index] = ops;
+	return NULL;
+}
+
+static void process(unsigned int proc)
+{
+	pthread_t *tids = calloc(nr_threads, sizeof(*tids));
+	struct thread *threads = calloc(nr_threads, sizeof(*threads));
+	unsigned int i;
+
+	if (!tids || !threads)
+		exit(1);
+	for (i = 0; i < nr_threads; i++) {
+		threads[i].index = proc * nr_threads + i;
+		threads[i].futexes = calloc(nr_futexes, sizeof(int));
+		if (!threads[i].futexes ||
+		    pthread_create(&tids[i], NULL, thread_fn, &threads[i])) {
+			fprintf(stderr, "can't start thread\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(tids[i], NULL);
+	exit(0);
+}
+
+static double run(void)
+{
+	unsigned int i, total = nr_procs * nr_threads;
+	unsigned long long ops = 0;
+	struct timespec ts;
+
+	memset(shared, 0, sizeof(*shared) + total * sizeof(shared->ops[0]));
+	/* the children exit(), don't let them flush our output again */
+	fflush(stdout);
+	for (i = 0; i < nr_procs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (!pid)
+			process(i);
+	}
+
+	/* let the threads get ready before starting the clock */
+	usleep(100000);
+	shared->start = 1;
+	ts.tv_sec = seconds;
+	ts.tv_nsec = 0;
+	nanosleep(&ts, NULL);
+	shared->stop = 1;
+
+	for (i = 0; i < nr_procs; i++) {
+		int status;
+
+		if (wait(&status) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status)) {
+			fprintf(stderr, "a process failed\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < total; i++)
+		ops += shared->ops[i];
+	return (double)ops / seconds;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: futex-bench [-p processes] [-t threads] "
+		"[-f futexes] [-s seconds] [-n runs] [-S]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	double *rates;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:t:f:s:n:S")) != -1) {
+		switch (opt) {
+		case 'p':
+			nr_procs = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			nr_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			nr_futexes = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			runs = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			private_flag = 0;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || !nr_procs || !nr_threads || !nr_futexes ||
+	    !seconds || !runs)
+		usage();
+
+	shared = mmap(NULL, sizeof(*shared) +
+		      nr_procs * nr_threads * sizeof(shared->ops[0]),
+		      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	rates = calloc(runs, sizeof(*rates));
+	if (shared == MAP_FAILED || !rates)
+		return 1;
+
+	printf("%u processes x %u threads, %u %s futexes per thread\n",
+	       nr_procs, nr_threads, nr_futexes,
+	       private_flag ? "private" : "shared");
+	printf("%-8s %14s\n", "run", "ops/s");
+	for (i = 0; i < runs; i++) {
+		rates[i] = run();
+		printf("%-8u %14.0f\n", i + 1, rates[i]);
+	}
+	qsort(rates, runs, sizeof(*rates), cmp_double);
+	printf("%-8s %14.0f\n", "median", rates[runs / 2]);
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Just enough of the kernel environment for lib/lzo to build in user
+ * space.  lzotest.c includes the lib/lzo sources with STATIC defined,
+ * the same way the pre-boot decompressors do.
+ */
+#ifndef _LZOTEST_UNALIGNED_H
+#define _LZOTEST_UNALIGNED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+/* The kernel defines only the one that applies; libc defines both. */
+#undef __LITTLE_ENDIAN
+#undef __BIG_ENDIAN
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define __LITTLE_ENDIAN 1234
+#else
+# define __BIG_ENDIAN 4321
+#endif
+
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+#define noinline	__attribute__((noinline))
+#define swab32(x)	__builtin_bswap32(x)
+#define BUILD_BUG_ON(c)	((void)sizeof(char[1 - 2 * !!(c)]))
+
+#define get_unaligned(p) ({					\
+	const struct { __typeof__(*(p)) v; }			\
+		__attribute__((packed)) *__p = (const void *)(p);	\
+	__p->v; })
+
+#define put_unaligned(val, p) do {				\
+	struct { __typeof__(*(p)) v; }				\
+		__attribute__((packed)) *__p = (void *)(p);	\
+	__p->v = (val);						\
+} while (0)
+
+static inline u16 get_unaligned_le16(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8;
+}
+
+static inline u32 get_unaligned_le32(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] | b[1] << 8 | b[2] << 16 | (u32)b[3] << 24;
+}
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * lzotest.c - round trip test and benchmark for lib/lzo in user space
+ *
+ * Builds lib/lzo/lzo1x_compress.c and lib/lzo/lzo1x_decompress.c as
+ * they are, splits each input into blocks (4KB pages by default, as
+ * zram and hibernation use them), and for every block checks that
+ *
+ *  - decompression gives back the original data,
+ *  - an output buffer one byte short is reported as an overrun,
+ *  - truncated input is never reported as a success,
+ *  - corrupted input never makes the decompressor write past the
+ *    end of its output buffer (with -f).
+ *
+ * Then it reports the compression ratio and compression and
+ * decompression throughput.  Without file arguments a small synthetic
+ * corpus is used; for comparable numbers pass the files of a standard
+ * corpus such as Silesia or Canterbury.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define STATIC static
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../../lib/lzo/lzo1x_compress.c"
+#include "../../lib/lzo/lzo1x_decompress.c"
+
+#define CANARY		0xa5
+#define CANARY_LEN	64
+
+static size_t block_size = 4096;
+static unsigned int iterations = 20;
+static unsigned int fuzz_rounds;
+static unsigned long long seed = 1;
+static int failures;
+
+static unsigned int rnd(void)
+{
+	seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return seed >> 33;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fail(const char *name, size_t off, const char *what, int ret)
+{
+	if (failures++ < 20)
+		fprintf(stderr, "%s: block at %zu: %s (ret %d)\n",
+			name, off, what, ret);
+}
+
+static int canary_intact(const unsigned char *p)
+{
+	int i;
+
+	for (i = 0; i < CANARY_LEN; i++)
+		if (p[i] != CANARY)
+			return 0;
+	return 1;
+}
+
+/* Decompress @clen bytes into a buffer of exactly @dlen bytes. */
+static int decompress_checked(const unsigned char *c, size_t clen,
+			      unsigned char *d, size_t dlen, size_t *out_len,
+			      int *overflow)
+{
+	int ret;
+
+	memset(d + dlen, CANARY, CANARY_LEN);
+	*out_len = dlen;
+	ret = lzo1x_decompress_safe(c, clen, d, out_len);
+	*overflow = !canary_intact(d + dlen);
+	return ret;
+}
+
+static void check_block(const char *name, size_t off,
+			const unsigned char *src, size_t len,
+			const unsigned char *c, size_t clen, unsigned char *d)
+{
+	unsigned char *fz;
+	size_t out_len, l;
+	int ret, overflow;
+	unsigned int i, j;
+
+	ret = decompress_checked(c, clen, d, len, &out_len, &overflow);
+	if (ret != LZO_E_OK || out_len != len || memcmp(src, d, len))
+		fail(name, off, "round trip mismatch", ret);
+	if (overflow)
+		fail(name, off, "wrote past output buffer", ret);
+
+	if (len) {
+		ret = decompress_checked(c, clen, d, len - 1, &out_len,
+					 &overflow);
+		if (ret != LZO_E_OUTPUT_OVERRUN)
+			fail(name, off, "short output not detected", ret);
+		if (overflow)
+			fail(name, off, "short output: wrote past buffer", ret);
+	}
+
+	for (l = 0; l < clen; l += clen / 7 + 1) {
+		ret = decompress_checked(c, l, d, len, &out_len, &overflow);
+		if (ret == LZO_E_OK)
+			fail(name, off, "truncated input accepted", ret);
+		if (overflow)
+			fail(name, off, "truncated input: wrote past buffer",
+			     ret);
+	}
+
+	if (!fuzz_rounds || !clen)
+		return;
+	fz = malloc(clen);
+	for (i = 0; i < fuzz_rounds; i++) {
+		memcpy(fz, c, clen);
+		for (j = rnd() % 3; j < 3; j++)
+			fz[rnd() % clen] ^= 1 << (rnd() % 8);
+		decompress_checked(fz, clen, d, len, &out_len, &overflow);
+		if (overflow || out_len > len)
+			fail(name, off, "fuzzed input: wrote past buffer", 0);
+	}
+	free(fz);
+}
+
+static void run(const char *name, const unsigned char *buf, size_t size)
+{
+	size_t nblocks = (size + block_size - 1) / block_size;
+	size_t cap = lzo1x_worst_compress(block_size);
+	unsigned char *cbuf, *dbuf, *wrkmem;
+	size_t *clen, off, ctotal = 0, out_len;
+	double t, tc = 1e30, td = 1e30;
+	unsigned int it;
+	size_t b;
+
+	cbuf = malloc(nblocks * cap);
+	clen = malloc(nblocks * sizeof(*clen));
+	dbuf = malloc(block_size + CANARY_LEN);
+	wrkmem = malloc(LZO1X_MEM_COMPRESS);
+	if (!cbuf || !clen || !dbuf || !wrkmem) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (it = 0; it < iterations; it++) {
+		t = now();
+		for (b = 0, off = 0; b < nblocks; b++, off += block_size) {
+			size_t len = size - off < block_size ?
+				     size - off : block_size;
+
+			lzo1x_1_compress(buf + off, len, cbuf + b * cap,
+					 &clen[b], wrkmem);
+		}
+		t = now() - t;
+		if (t < tc)
+			tc = t;
+	}
+
+	for (b = 0, off = 0; b < nblocks; b++, off += block_size) {
+		size_t len = size - off < block_size ? size - off : block_size;
+
+		if (clen[b] > lzo1x_worst_compress(len))
+			fail(name, off, "exceeds lzo1x_worst_compress()", 0);
+		ctotal += clen[b];
+		check_block(name, off, buf + off, len, cbuf + b * cap,
+			    clen[b], dbuf);
+	}
+
+	for (it = 0; it < iterations; it++) {
+		t = now();
+		for (b = 0, off = 0; b < nblocks; b++, off += block_size) {
+			out_len = block_size;
+			lzo1x_decompress_safe(cbuf + b * cap, clen[b], dbuf,
+					      &out_len);
+		}
+		t = now() - t;
+		if (t < td)
+			td = t;
+	}
+
+	printf("%-16s %10zu %10zu %6.2f%% %9.1f %9.1f\n", name, size, ctotal,
+	       size ? 100.0 * ctotal / size : 0.0,
+	       size / tc / 1e6, size / td / 1e6);
+
+	free(wrkmem);
+	free(dbuf);
+	free(clen);
+	free(cbuf);
+}
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	unsigned char *buf;
+	struct stat st;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		perror(path);
+		exit(1);
+	}
+	buf = malloc(st.st_size + 1);
+	if (!buf || fread(buf, 1, st.st_size, f) != (size_t)st.st_size) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*size = st.st_size;
+	return buf;
+}
+
+#define SYNTH_SIZE	(1 << 20)
+
+static const char * const words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"kernel", "page", "memory", "struct", "return", "if", "else",
+	"static", "int", "unsigned", "long", "void", "while", "lock",
+};
+
+/* English-like text, structured binary records, random bytes, zeros. */
+static void synthetic(void)
+{
+	unsigned char *buf = malloc(SYNTH_SIZE);
+	size_t i, w;
+
+	for (i = 0; i < SYNTH_SIZE; ) {
+		const char *s = words[rnd() % (sizeof(words) / sizeof(*words))];
+
+		for (w = 0; s[w] && i < SYNTH_SIZE; w++)
+			buf[i++] = s[w];
+		if (i < SYNTH_SIZE)
+			buf[i++] = rnd() % 16 ? ' ' : '\n';
+	}
+	run("text", buf, SYNTH_SIZE);
+
+	for (i = 0; i < SYNTH_SIZE; i += 16) {
+		u32 rec[4] = { i / 16, rnd() % 64, 0xc0000000 | (rnd() % 4096),
+			       rnd() % 8 ? 0 : rnd() };
+
+		memcpy(buf + i, rec, sizeof(rec));
+	}
+	run("binary", buf, SYNTH_SIZE);
+
+	for (i = 0; i < SYNTH_SIZE; i++)
+		buf[i] = rnd();
+	run("random", buf, SYNTH_SIZE);
+
+	memset(buf, 0, SYNTH_SIZE);
+	run("zero", buf, SYNTH_SIZE);
+
+	free(buf);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: lzotest [-b block_size] [-i iterations] "
+		"[-f fuzz_rounds] [-s seed] [file...]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *buf;
+	size_t size;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:i:f:s:")) != -1) {
+		switch (opt) {
+		case 'b':
+			block_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			fuzz_rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!block_size || !iterations)
+		usage();
+
+	printf("%-16s %10s %10s %7s %9s %9s\n", "input", "bytes",
+	       "compressed", "ratio", "comp MB/s", "dec MB/s");
+
+	if (optind == argc)
+		synthetic();
+	for (; optind < argc; optind++) {
+		const char *name = strrchr(argv[optind], '/');
+
+		buf = read_file(argv[optind], &size);
+		run(name ? name + 1 : argv[optind], buf, size);
+		free(buf);
+	}
+
+	if (failures) {
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+	return 0;
+}
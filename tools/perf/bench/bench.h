@@ -0,0 +1,43 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
+extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix);
+extern int bench_mem_memset(int argc, const char **argv, const char *prefix);
+extern int bench_futex_hash(int argc, const char **argv, const char *prefix);
+extern int bench_futex_wake(int argc, const char **argv, const char *prefix);
+extern int bench_futex_requeue(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_wait(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_ctl(int argc, const char **argv, const char *prefix);
+extern int bench_epoll_herd(int argc, const char **argv, const char *prefix);
+extern int bench_pipe_throughput(int argc, const char **argv, const char *prefix);
+extern int bench_pipe_splice(int argc, const char **argv, const char *prefix);
+extern int bench_binder_transaction(int argc, const char **argv, const char *prefix);
+extern int bench_unix_dgram(int argc, const char **argv, const char *prefix);
+extern int bench_net_rps(int argc, const char **argv, const char *prefix);
+extern int bench_net_fastopen(int argc, const char **argv, const char *prefix);
+
+#define BENCH_FORMAT_DEFAULT_STR	"default"
+#define BENCH_FORMAT_DEFAULT		0
+#define BENCH_FORMAT_SIMPLE_STR		"simple"
+#define BENCH_FORMAT_SIMPLE		1
+
+#define BENCH_FORMAT_UNKNOWN		-1
+
+extern int bench_format;
+
+/*
+ * Report one result of the running benchmark.  The default format is
+ * for humans; the simple one prints a line per result,
+ *
+ *   <collection> <benchmark> <metric> <value> <unit>
+ *
+ * for scripts, so metric and unit must be single words.
+ */
+extern void bench_print(const char *metric, double value, const char *unit);
+
+/* Informational output, only in the default format */
+extern void bench_info(const char *fmt, ...)
+	__attribute__((format (printf, 1, 2)));
+
+#endif
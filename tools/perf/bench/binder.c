@@ -0,0 +1,306 @@
+/*
+ * binder.c
+ *
+ * transaction: binder transaction round trip between two processes
+ *
+ * A child process becomes the binder context manager, handle 0, and
+ * replies to every transaction; the parent sends transactions to it
+ * and waits for the replies, as a client of an Android system service
+ * does.  That is two trips through the driver's transaction path, the
+ * buffer allocator and two wakeups per round trip.
+ *
+ * The context manager is normally the servicemanager, so this has to
+ * run before Android starts, or with it stopped.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../../../drivers/staging/android/binder.h"
+
+#define BINDER_MAP_SIZE	(128 * 1024)
+
+#define CODE_PING	1
+#define CODE_EXIT	2
+
+static const char *device = "/dev/binder";
+static int loops = 100000;
+static int payload = 64;
+
+struct binder_conn {
+	int fd;
+	void *map;
+	/* commands to send with the next read */
+	char wbuf[256];
+	size_t wlen;
+	char rbuf[256];
+};
+
+static int binder_open(struct binder_conn *conn)
+{
+	struct binder_version version;
+
+	conn->fd = open(device, O_RDWR);
+	if (conn->fd < 0) {
+		fprintf(stderr, "%s: %s\n", device, strerror(errno));
+		return -1;
+	}
+	if (ioctl(conn->fd, BINDER_VERSION, &version) ||
+	    version.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "%s: binder protocol version mismatch\n",
+			device);
+		return -1;
+	}
+	/* the driver hands in the received transactions through this */
+	conn->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE,
+			 conn->fd, 0);
+	if (conn->map == MAP_FAILED) {
+		fprintf(stderr, "%s: mmap: %s\n", device, strerror(errno));
+		return -1;
+	}
+	conn->wlen = 0;
+	return 0;
+}
+
+static void binder_close(struct binder_conn *conn)
+{
+	munmap(conn->map, BINDER_MAP_SIZE);
+	close(conn->fd);
+}
+
+static void binder_put(struct binder_conn *conn, uint32_t cmd,
+		       const void *data, size_t len)
+{
+	memcpy(conn->wbuf + conn->wlen, &cmd, sizeof(cmd));
+	conn->wlen += sizeof(cmd);
+	if (len)
+		memcpy(conn->wbuf + conn->wlen, data, len);
+	conn->wlen += len;
+}
+
+static void binder_put_txn(struct binder_conn *conn, uint32_t cmd,
+			   uint32_t code, const void *data, size_t len)
+{
+	struct binder_transaction_data txn;
+
+	memset(&txn, 0, sizeof(txn));
+	txn.target.handle = 0;
+	txn.code = code;
+	txn.data_size = len;
+	txn.data.ptr.buffer = data;
+	binder_put(conn, cmd, &txn, sizeof(txn));
+}
+
+static void binder_put_free(struct binder_conn *conn, const void *buffer)
+{
+	binder_put(conn, BC_FREE_BUFFER, &buffer, sizeof(buffer));
+}
+
+/*
+ * Send the queued commands, then read until a BR_TRANSACTION or
+ * BR_REPLY arrives, which is returned in @txn.  Returns the command,
+ * or 0 on error.
+ */
+static uint32_t binder_talk(struct binder_conn *conn,
+		       struct binder_transaction_data *txn)
+{
+	struct binder_write_read bwr;
+
+	bwr.write_size = conn->wlen;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)conn->wbuf;
+	for (;;) {
+		char *p, *end;
+
+		bwr.read_size = sizeof(conn->rbuf);
+		bwr.read_consumed = 0;
+		bwr.read_buffer = (unsigned long)conn->rbuf;
+		if (ioctl(conn->fd, BINDER_WRITE_READ, &bwr) < 0) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+		conn->wlen = 0;
+		bwr.write_size = 0;
+
+		p = conn->rbuf;
+		end = p + bwr.read_consumed;
+		while (p + sizeof(uint32_t) <= end) {
+			uint32_t cmd;
+
+			memcpy(&cmd, p, sizeof(cmd));
+			p += sizeof(cmd);
+			switch (cmd) {
+			case BR_NOOP:
+			case BR_TRANSACTION_COMPLETE:
+			case BR_SPAWN_LOOPER:
+				break;
+			case BR_TRANSACTION:
+			case BR_REPLY:
+				memcpy(txn, p, sizeof(*txn));
+				return cmd;
+			default:
+				fprintf(stderr, "binder: unexpected return "
+					"0x%x\n", cmd);
+				return 0;
+			}
+			p += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+/* The context manager: reply to everything until told to exit */
+static int server(int ready_fd)
+{
+	struct binder_transaction_data txn;
+	struct binder_write_read bwr;
+	struct binder_conn conn;
+	char status = 1;
+	uint32_t cmd;
+
+	if (binder_open(&conn))
+		goto out;
+	if (ioctl(conn.fd, BINDER_SET_CONTEXT_MGR, 0)) {
+		fprintf(stderr, "binder: can't become the context manager, "
+			"is the servicemanager running? (%s)\n",
+			strerror(errno));
+		goto out;
+	}
+	binder_put(&conn, BC_ENTER_LOOPER, NULL, 0);
+	status = 0;
+out:
+	if (write(ready_fd, &status, 1) != 1 || status)
+		return 1;
+	close(ready_fd);
+
+	for (;;) {
+		cmd = binder_talk(&conn, &txn);
+		if (cmd != BR_TRANSACTION)
+			return 1;
+
+		/*
+		 * Echo the data back, then free the request buffer: the
+		 * reply is copied out of it.
+		 */
+		binder_put_txn(&conn, BC_REPLY, 0, txn.data.ptr.buffer,
+			       txn.data_size);
+		binder_put_free(&conn, txn.data.ptr.buffer);
+		if (txn.code == CODE_EXIT)
+			break;
+	}
+	/* push out the last reply */
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_size = conn.wlen;
+	bwr.write_buffer = (unsigned long)conn.wbuf;
+	ioctl(conn.fd, BINDER_WRITE_READ, &bwr);
+	binder_close(&conn);
+	return 0;
+}
+
+static int transact(struct binder_conn *conn, uint32_t code, void *data)
+{
+	struct binder_transaction_data txn;
+
+	binder_put_txn(conn, BC_TRANSACTION, code, data, payload);
+	if (binder_talk(conn, &txn) != BR_REPLY)
+		return -1;
+	binder_put_free(conn, txn.data.ptr.buffer);
+	return 0;
+}
+
+static const struct option options[] = {
+	OPT_STRING('d', "device", &device, "/dev/binder",
+		    "Specify the binder device"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of round trips"),
+	OPT_INTEGER('s', "size", &payload,
+		    "Specify bytes of data per transaction"),
+	OPT_END()
+};
+
+static const char * const bench_binder_transaction_usage[] = {
+	"perf bench binder transaction <options>",
+	NULL
+};
+
+int bench_binder_transaction(int argc, const char **argv,
+			     const char *prefix __used)
+{
+	unsigned long long start, ns;
+	struct binder_conn conn;
+	int fds[2], i, status, ret = 1;
+	char ready;
+	void *data;
+	pid_t pid;
+
+	argc = parse_options(argc, argv, options,
+			     bench_binder_transaction_usage, 0);
+	if (loops <= 0 || payload < 0)
+		usage_with_options(bench_binder_transaction_usage, options);
+
+	data = calloc(1, payload + 1);
+	if (!data)
+		die("calloc");
+	if (pipe(fds))
+		die("pipe");
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(fds[0]);
+		exit(server(fds[1]));
+	}
+	close(fds[1]);
+
+	if (read(fds[0], &ready, 1) != 1 || ready)
+		goto wait;
+	close(fds[0]);
+
+	if (binder_open(&conn)) {
+		kill(pid, SIGKILL);
+		goto wait;
+	}
+
+	start = rdclock();
+	for (i = 0; i < loops; i++) {
+		if (transact(&conn, CODE_PING, data)) {
+			fprintf(stderr, "binder: transaction failed\n");
+			kill(pid, SIGKILL);
+			goto close;
+		}
+	}
+	ns = rdclock() - start;
+
+	if (transact(&conn, CODE_EXIT, data))
+		kill(pid, SIGKILL);
+	ret = 0;
+
+	bench_info("# %d round trips with %d bytes of data\n\n", loops,
+		   payload);
+	bench_print("round-trips", loops / (ns / 1e9), "trips/sec");
+	bench_print("round-trip", (double)ns / loops / 1e3, "usec");
+close:
+	binder_close(&conn);
+wait:
+	waitpid(pid, &status, 0);
+	free(data);
+	return ret;
+}
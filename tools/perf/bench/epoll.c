@@ -0,0 +1,490 @@
+/*
+ * epoll.c
+ *
+ * wait: events delivered by epoll_wait() with many file descriptors
+ * ctl:  cost of epoll_ctl() ADD, MOD and DEL with many file descriptors
+ * herd: wakeups of epoll instances that all watch the same descriptor
+ *
+ * The file descriptors are eventfds.  In wait, writer threads make them
+ * readable round robin and waiter threads collect the events, each from
+ * an epoll instance of its own, or all from the same one with --shared,
+ * where they contend on its ready list.
+ *
+ * herd is the thundering herd of servers with one epoll instance per
+ * thread, all watching the listening socket: every event wakes up all
+ * of them, but only one gets it.  With --exclusive, EPOLLEXCLUSIVE, it
+ * should wake up one.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE	(1u << 28)
+#endif
+
+#define EPOLL_MAXEVENTS	64
+
+static int nthreads;
+static int nwriters = 1;
+static int nfds = 4096;
+static int runtime = 5;
+static int repeat = 10;
+static int shared;
+static int edge;
+static int exclusive;
+
+static int default_threads(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cpus > 0 ? cpus : 1;
+}
+
+/* Thousands of fds need a higher limit than the usual 1024 */
+static void raise_nofile(int n)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl))
+		die("getrlimit");
+	if (rl.rlim_cur >= (rlim_t)n)
+		return;
+	rl.rlim_cur = n;
+	if (rl.rlim_max < (rlim_t)n)
+		rl.rlim_max = n;
+	if (setrlimit(RLIMIT_NOFILE, &rl))
+		die("setrlimit: %d fds need CAP_SYS_RESOURCE", n);
+}
+
+static int *open_fds(int n)
+{
+	int *fds, i;
+
+	raise_nofile(n + 64);
+	fds = calloc(n, sizeof(int));
+	if (!fds)
+		die("calloc");
+	for (i = 0; i < n; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0)
+			die("eventfd");
+	}
+	return fds;
+}
+
+static void close_fds(int *fds, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		close(fds[i]);
+	free(fds);
+}
+
+/* wait */
+
+struct epoll_waiter {
+	pthread_t thread;
+	int epfd;
+	unsigned long events;
+};
+
+struct epoll_writer {
+	pthread_t thread;
+	int *fds;
+	int nr;
+	unsigned long writes;
+};
+
+static volatile int done;
+
+static void *waiter_thread(void *arg)
+{
+	struct epoll_waiter *w = arg;
+	struct epoll_event ev[EPOLL_MAXEVENTS];
+	unsigned long events = 0;
+	uint64_t val;
+	int i, n;
+
+	while (!done) {
+		n = epoll_wait(w->epfd, ev, EPOLL_MAXEVENTS, 100);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			die("epoll_wait");
+		}
+		for (i = 0; i < n; i++) {
+			/* another waiter may have been told too */
+			if (read(ev[i].data.fd, &val, sizeof(val)) > 0)
+				events++;
+		}
+	}
+	w->events = events;
+	return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+	struct epoll_writer *w = arg;
+	unsigned long writes = 0;
+	uint64_t val = 1;
+	int i;
+
+	while (!done) {
+		for (i = 0; i < w->nr && !done; i++)
+			if (write(w->fds[i], &val, sizeof(val)) > 0)
+				writes++;
+	}
+	w->writes = writes;
+	return NULL;
+}
+
+static const struct option wait_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of waiter threads (default: online cpus)"),
+	OPT_INTEGER('w', "writers", &nwriters,
+		    "Specify number of writer threads"),
+	OPT_INTEGER('f', "fds", &nfds,
+		    "Specify number of file descriptors"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime (in seconds)"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Share one epoll instance between the waiters"),
+	OPT_BOOLEAN('E', "edge", &edge,
+		    "Use edge-triggered events"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+int bench_epoll_wait(int argc, const char **argv, const char *prefix __used)
+{
+	struct epoll_waiter *waiters;
+	struct epoll_writer *writers;
+	unsigned long long start, ns;
+	double events = 0, writes = 0;
+	struct epoll_event ev;
+	int *fds, i, per_writer;
+
+	argc = parse_options(argc, argv, wait_options,
+			     bench_epoll_wait_usage, 0);
+	if (!nthreads)
+		nthreads = default_threads();
+	if (nthreads <= 0 || nwriters <= 0 || nfds < nthreads ||
+	    nfds < nwriters || runtime <= 0)
+		usage_with_options(bench_epoll_wait_usage, wait_options);
+
+	fds = open_fds(nfds);
+	waiters = calloc(nthreads, sizeof(*waiters));
+	writers = calloc(nwriters, sizeof(*writers));
+	if (!waiters || !writers)
+		die("calloc");
+
+	/* the fds are spread over the instances, all on a shared one */
+	for (i = 0; i < nthreads; i++) {
+		if (shared && i) {
+			waiters[i].epfd = waiters[0].epfd;
+			continue;
+		}
+		waiters[i].epfd = epoll_create(nfds);
+		if (waiters[i].epfd < 0)
+			die("epoll_create");
+	}
+	for (i = 0; i < nfds; i++) {
+		ev.events = EPOLLIN | (edge ? EPOLLET : 0);
+		ev.data.fd = fds[i];
+		if (epoll_ctl(waiters[shared ? 0 : i % nthreads].epfd,
+			      EPOLL_CTL_ADD, fds[i], &ev))
+			die("epoll_ctl");
+	}
+
+	done = 0;
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&waiters[i].thread, NULL, waiter_thread,
+				   &waiters[i]))
+			die("pthread_create");
+
+	per_writer = nfds / nwriters;
+	start = rdclock();
+	for (i = 0; i < nwriters; i++) {
+		writers[i].fds = fds + i * per_writer;
+		writers[i].nr = per_writer;
+		if (pthread_create(&writers[i].thread, NULL, writer_thread,
+				   &writers[i]))
+			die("pthread_create");
+	}
+	sleep(runtime);
+	done = 1;
+	for (i = 0; i < nwriters; i++) {
+		pthread_join(writers[i].thread, NULL);
+		writes += writers[i].writes;
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(waiters[i].thread, NULL);
+		events += waiters[i].events;
+	}
+	ns = rdclock() - start;
+
+	for (i = 0; i < nthreads; i++)
+		if (!shared || !i)
+			close(waiters[i].epfd);
+	close_fds(fds, nfds);
+	free(waiters);
+	free(writers);
+
+	bench_info("# %d waiters on %s, %d writers, %d fds, %s-triggered\n\n",
+		   nthreads, shared ? "one epoll instance" : "their own epolls",
+		   nwriters, nfds, edge ? "edge" : "level");
+	bench_print("events", events / (ns / 1e9), "events/sec");
+	bench_print("events-per-waiter", events / (ns / 1e9) / nthreads,
+		    "events/sec");
+	bench_print("writes", writes / (ns / 1e9), "writes/sec");
+	return 0;
+}
+
+/* ctl */
+
+struct epoll_ctl_worker {
+	pthread_t thread;
+	int epfd;
+	int *fds;
+	int nr;
+	unsigned long long ns[3];	/* ADD, MOD, DEL */
+};
+
+static void *ctl_thread(void *arg)
+{
+	struct epoll_ctl_worker *w = arg;
+	static const int ops[3] = {
+		EPOLL_CTL_ADD, EPOLL_CTL_MOD, EPOLL_CTL_DEL
+	};
+	struct epoll_event ev;
+	unsigned long long start;
+	int r, op, i;
+
+	for (r = 0; r < repeat; r++) {
+		for (op = 0; op < 3; op++) {
+			start = rdclock();
+			for (i = 0; i < w->nr; i++) {
+				ev.events = op == 1 ? EPOLLOUT : EPOLLIN;
+				ev.data.fd = w->fds[i];
+				if (epoll_ctl(w->epfd, ops[op], w->fds[i], &ev))
+					die("epoll_ctl");
+			}
+			w->ns[op] += rdclock() - start;
+		}
+	}
+	return NULL;
+}
+
+static const struct option ctl_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "fds", &nfds,
+		    "Specify number of file descriptors"),
+	OPT_INTEGER('r', "repeat", &repeat,
+		    "Specify number of times to repeat"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Share one epoll instance between the threads"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_ctl_usage[] = {
+	"perf bench epoll ctl <options>",
+	NULL
+};
+
+int bench_epoll_ctl(int argc, const char **argv, const char *prefix __used)
+{
+	static const char * const names[3] = { "add", "mod", "del" };
+	struct epoll_ctl_worker *workers;
+	unsigned long long ns[3] = { 0, 0, 0 };
+	int *fds, i, op, per_thread;
+
+	argc = parse_options(argc, argv, ctl_options,
+			     bench_epoll_ctl_usage, 0);
+	if (!nthreads)
+		nthreads = default_threads();
+	if (nthreads <= 0 || nfds < nthreads || repeat <= 0)
+		usage_with_options(bench_epoll_ctl_usage, ctl_options);
+
+	fds = open_fds(nfds);
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers)
+		die("calloc");
+
+	per_thread = nfds / nthreads;
+	for (i = 0; i < nthreads; i++) {
+		if (shared && i) {
+			workers[i].epfd = workers[0].epfd;
+		} else {
+			workers[i].epfd = epoll_create(per_thread);
+			if (workers[i].epfd < 0)
+				die("epoll_create");
+		}
+		workers[i].fds = fds + i * per_thread;
+		workers[i].nr = per_thread;
+	}
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&workers[i].thread, NULL, ctl_thread,
+				   &workers[i]))
+			die("pthread_create");
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		for (op = 0; op < 3; op++)
+			ns[op] += workers[i].ns[op];
+		if (!shared || !i)
+			close(workers[i].epfd);
+	}
+	close_fds(fds, nfds);
+	free(workers);
+
+	bench_info("# %d threads, %d fds each, on %s, %d times\n\n",
+		   nthreads, per_thread,
+		   shared ? "one epoll instance" : "their own epolls", repeat);
+	for (op = 0; op < 3; op++)
+		bench_print(names[op], (double)ns[op] /
+			    ((double)per_thread * nthreads * repeat), "nsec/op");
+	return 0;
+}
+
+/* herd */
+
+static int herd_fd;
+static unsigned long herd_events;
+
+/* Times the threads of the process went to sleep */
+static long voluntary_switches(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru))
+		die("getrusage");
+	return ru.ru_nvcsw;
+}
+
+static void *herd_thread(void *arg)
+{
+	struct epoll_event ev;
+	int epfd = (long)arg;
+	uint64_t val;
+
+	while (!done) {
+		/*
+		 * Those woken up for nothing don't return, epoll_wait()
+		 * finds the fd isn't readable anymore and sleeps again.
+		 */
+		if (epoll_wait(epfd, &ev, 1, 100) <= 0)
+			continue;
+		if (read(herd_fd, &val, sizeof(val)) > 0)
+			__sync_fetch_and_add(&herd_events, 1);
+	}
+	return NULL;
+}
+
+static const struct option herd_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime (in seconds)"),
+	OPT_BOOLEAN('X', "exclusive", &exclusive,
+		    "Watch the descriptor with EPOLLEXCLUSIVE"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_herd_usage[] = {
+	"perf bench epoll herd <options>",
+	NULL
+};
+
+int bench_epoll_herd(int argc, const char **argv, const char *prefix __used)
+{
+	unsigned long long start, ns, end;
+	unsigned long sent = 0;
+	long switches;
+	struct epoll_event ev;
+	pthread_t *threads;
+	int *epfds, i;
+	uint64_t val = 1;
+
+	argc = parse_options(argc, argv, herd_options,
+			     bench_epoll_herd_usage, 0);
+	if (!nthreads)
+		nthreads = default_threads();
+	if (nthreads <= 0 || runtime <= 0)
+		usage_with_options(bench_epoll_herd_usage, herd_options);
+
+	herd_fd = eventfd(0, EFD_NONBLOCK);
+	threads = calloc(nthreads, sizeof(*threads));
+	epfds = calloc(nthreads, sizeof(*epfds));
+	if (herd_fd < 0 || !threads || !epfds)
+		die("herd setup");
+
+	for (i = 0; i < nthreads; i++) {
+		epfds[i] = epoll_create(1);
+		if (epfds[i] < 0)
+			die("epoll_create");
+		ev.events = EPOLLIN | (exclusive ? EPOLLEXCLUSIVE : 0);
+		ev.data.fd = herd_fd;
+		if (epoll_ctl(epfds[i], EPOLL_CTL_ADD, herd_fd, &ev)) {
+			fprintf(stderr, "epoll_ctl: %s%s\n", strerror(errno),
+				exclusive ? ", no EPOLLEXCLUSIVE support?" : "");
+			return 1;
+		}
+	}
+
+	done = 0;
+	herd_events = 0;
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, herd_thread,
+				   (void *)(long)epfds[i]))
+			die("pthread_create");
+
+	/* one event at a time, each taken before the next one comes */
+	switches = voluntary_switches();
+	start = rdclock();
+	end = start + runtime * 1000000000ULL;
+	while (rdclock() < end) {
+		if (write(herd_fd, &val, sizeof(val)) != sizeof(val))
+			die("write");
+		sent++;
+		while (herd_events < sent && rdclock() < end)
+			sched_yield();
+	}
+	switches = voluntary_switches() - switches;
+	ns = rdclock() - start;
+	done = 1;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+		close(epfds[i]);
+	}
+	close(herd_fd);
+	free(threads);
+	free(epfds);
+
+	bench_info("# %d threads with an epoll instance each, %s\n\n",
+		   nthreads, exclusive ? "EPOLLEXCLUSIVE" : "not exclusive");
+	bench_print("events", herd_events / (ns / 1e9), "events/sec");
+	bench_print("wakeups-per-event",
+		    herd_events ? (double)switches / herd_events : 0,
+		    "wakeups");
+	return 0;
+}
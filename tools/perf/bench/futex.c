@@ -0,0 +1,362 @@
+/*
+ * futex.c
+ *
+ * hash:    contention on the futex hash bucket locks
+ * wake:    time to wake up all the waiters of a futex
+ * requeue: time to requeue all the waiters of a futex to another one
+ *
+ * hash has threads look up futexes of their own as fast as they can,
+ * with FUTEX_WAIT on a value that doesn't match, which takes and drops
+ * the bucket lock and returns.  With private futexes (the default) and
+ * a kernel that gives each process its own hash table, the operations
+ * per second scale with the threads; with --shared they all go through
+ * the global table.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static int nthreads;
+static int nfutexes = 1024;
+static int runtime = 5;
+static int repeat = 10;
+static int nrequeue = 1;
+static int shared;
+
+static int futex_flag(void)
+{
+	return shared ? 0 : FUTEX_PRIVATE_FLAG;
+}
+
+static int futex_wait(int *uaddr, int val)
+{
+	return syscall(SYS_futex, uaddr, FUTEX_WAIT | futex_flag(), val,
+		       NULL, NULL, 0);
+}
+
+static int futex_wake(int *uaddr, int nr)
+{
+	return syscall(SYS_futex, uaddr, FUTEX_WAKE | futex_flag(), nr,
+		       NULL, NULL, 0);
+}
+
+static int futex_cmp_requeue(int *uaddr, int val, int *uaddr2, int nr_wake,
+			     int nr_requeue)
+{
+	return syscall(SYS_futex, uaddr, FUTEX_CMP_REQUEUE | futex_flag(),
+		       nr_wake, (void *)(long)nr_requeue, uaddr2, val);
+}
+
+static int default_threads(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return cpus > 0 ? cpus : 1;
+}
+
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int nready;
+static int go;
+
+/* Count the thread in, then wait for the signal to start */
+static void thread_ready(void)
+{
+	pthread_mutex_lock(&start_lock);
+	nready++;
+	pthread_cond_broadcast(&start_cond);
+	while (!go)
+		pthread_cond_wait(&start_cond, &start_lock);
+	pthread_mutex_unlock(&start_lock);
+}
+
+static void wait_ready(int n)
+{
+	pthread_mutex_lock(&start_lock);
+	while (nready < n)
+		pthread_cond_wait(&start_cond, &start_lock);
+	pthread_mutex_unlock(&start_lock);
+}
+
+static void start_threads(void)
+{
+	pthread_mutex_lock(&start_lock);
+	go = 1;
+	pthread_cond_broadcast(&start_cond);
+	pthread_mutex_unlock(&start_lock);
+}
+
+static void reset_start(void)
+{
+	nready = 0;
+	go = 0;
+}
+
+/* hash */
+
+struct hash_worker {
+	pthread_t thread;
+	int *futexes;
+	unsigned long ops;
+};
+
+static volatile int done;
+
+static void *hash_worker(void *arg)
+{
+	struct hash_worker *w = arg;
+	unsigned long ops = 0;
+	int i;
+
+	thread_ready();
+	while (!done) {
+		for (i = 0; i < nfutexes; i++)
+			futex_wait(&w->futexes[i], 1234);
+		ops += nfutexes;
+	}
+	w->ops = ops;
+	return NULL;
+}
+
+static const struct option hash_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of threads (default: online cpus)"),
+	OPT_INTEGER('f', "futexes", &nfutexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime (in seconds)"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+int bench_futex_hash(int argc, const char **argv, const char *prefix __used)
+{
+	unsigned long long start, ns;
+	struct hash_worker *workers;
+	double total = 0;
+	int i;
+
+	argc = parse_options(argc, argv, hash_options,
+			     bench_futex_hash_usage, 0);
+	if (!nthreads)
+		nthreads = default_threads();
+	if (nthreads <= 0 || nfutexes <= 0 || runtime <= 0)
+		usage_with_options(bench_futex_hash_usage, hash_options);
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers)
+		die("calloc");
+
+	reset_start();
+	done = 0;
+	for (i = 0; i < nthreads; i++) {
+		workers[i].futexes = calloc(nfutexes, sizeof(int));
+		if (!workers[i].futexes)
+			die("calloc");
+		if (pthread_create(&workers[i].thread, NULL, hash_worker,
+				   &workers[i]))
+			die("pthread_create");
+	}
+	wait_ready(nthreads);
+
+	start = rdclock();
+	start_threads();
+	sleep(runtime);
+	done = 1;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total += workers[i].ops;
+		free(workers[i].futexes);
+	}
+	ns = rdclock() - start;
+
+	bench_info("# %d threads operating on %d %s futexes each\n\n",
+		   nthreads, nfutexes, shared ? "shared" : "private");
+	bench_print("operations", total / (ns / 1e9), "ops/sec");
+	bench_print("operations-per-thread",
+		    total / (ns / 1e9) / nthreads, "ops/sec");
+
+	free(workers);
+	return 0;
+}
+
+/* wake and requeue: waiters blocked on one futex */
+
+static int futex1, futex2;
+
+static void *waiter(void *arg __used)
+{
+	thread_ready();
+	while (futex_wait(&futex1, 0) && errno == EINTR)
+		;
+	return NULL;
+}
+
+static pthread_t *block_waiters(void)
+{
+	pthread_t *threads;
+	int i;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads)
+		die("calloc");
+
+	futex1 = 0;
+	futex2 = 0;
+	reset_start();
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, waiter, NULL))
+			die("pthread_create");
+	wait_ready(nthreads);
+	start_threads();
+	/*
+	 * There is no telling from here when they are all queued on the
+	 * futex; give them the time.
+	 */
+	usleep(100000);
+	return threads;
+}
+
+static void reap_waiters(pthread_t *threads)
+{
+	int i;
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+static const struct option wake_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of waiters (default: online cpus)"),
+	OPT_INTEGER('r', "repeat", &repeat,
+		    "Specify number of times to repeat"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_wake_usage[] = {
+	"perf bench futex wake <options>",
+	NULL
+};
+
+int bench_futex_wake(int argc, const char **argv, const char *prefix __used)
+{
+	unsigned long long start, ns = 0;
+	pthread_t *threads;
+	int i, woken;
+
+	argc = parse_options(argc, argv, wake_options,
+			     bench_futex_wake_usage, 0);
+	if (!nthreads)
+		nthreads = default_threads();
+	if (nthreads <= 0 || repeat <= 0)
+		usage_with_options(bench_futex_wake_usage, wake_options);
+
+	for (i = 0; i < repeat; i++) {
+		threads = block_waiters();
+
+		/* one at a time, as a condition variable signal would */
+		woken = 0;
+		start = rdclock();
+		while (woken < nthreads) {
+			int ret = futex_wake(&futex1, 1);
+
+			if (ret < 0)
+				die("futex_wake");
+			woken += ret;
+		}
+		ns += rdclock() - start;
+
+		reap_waiters(threads);
+	}
+
+	bench_info("# Waking %d %s waiters, %d times\n\n", nthreads,
+		   shared ? "shared" : "private", repeat);
+	bench_print("wakeup-all", (double)ns / repeat / 1e3, "usec");
+	bench_print("wakeup-one", (double)ns / repeat / nthreads / 1e3,
+		    "usec");
+	return 0;
+}
+
+static const struct option requeue_options[] = {
+	OPT_INTEGER('t', "threads", &nthreads,
+		    "Specify number of waiters (default: online cpus)"),
+	OPT_INTEGER('q', "nrequeue", &nrequeue,
+		    "Specify number of waiters to requeue per call"),
+	OPT_INTEGER('r', "repeat", &repeat,
+		    "Specify number of times to repeat"),
+	OPT_BOOLEAN('S', "shared", &shared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_requeue_usage[] = {
+	"perf bench futex requeue <options>",
+	NULL
+};
+
+int bench_futex_requeue(int argc, const char **argv,
+			const char *prefix __used)
+{
+	unsigned long long start, ns = 0;
+	pthread_t *threads;
+	int i, requeued;
+
+	argc = parse_options(argc, argv, requeue_options,
+			     bench_futex_requeue_usage, 0);
+	if (!nthreads)
+		nthreads = default_threads();
+	if (nthreads <= 0 || repeat <= 0 || nrequeue <= 0)
+		usage_with_options(bench_futex_requeue_usage,
+				   requeue_options);
+
+	for (i = 0; i < repeat; i++) {
+		threads = block_waiters();
+
+		requeued = 0;
+		start = rdclock();
+		while (requeued < nthreads) {
+			int ret = futex_cmp_requeue(&futex1, 0, &futex2, 0,
+						    nrequeue);
+
+			if (ret < 0)
+				die("futex_cmp_requeue");
+			requeued += ret;
+		}
+		ns += rdclock() - start;
+
+		/* the waiters are on futex2 now */
+		futex1 = 1;
+		requeued = 0;
+		while (requeued < nthreads)
+			requeued += futex_wake(&futex2, nthreads);
+		reap_waiters(threads);
+	}
+
+	bench_info("# Requeuing %d %s waiters, %d per call, %d times\n\n",
+		   nthreads, shared ? "shared" : "private", nrequeue, repeat);
+	bench_print("requeue-all", (double)ns / repeat / 1e3, "usec");
+	bench_print("requeue-one", (double)ns / repeat / nthreads / 1e3,
+		    "usec");
+	return 0;
+}
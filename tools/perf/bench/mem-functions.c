@@ -0,0 +1,184 @@
+/*
+ * mem-functions.c
+ *
+ * memcpy, memset: throughput of the C library's memory functions
+ *
+ * The buffers are touched once before the timed loops, so that page
+ * faults are not measured; pass --prefault=0 to include them, with
+ * fresh buffers for every loop.  The buffers are mmap()ed: malloc()
+ * would hand the same, already faulted, memory back after the first
+ * free() once glibc raised its mmap threshold.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define K 1024
+
+static const char *length_str = "1MB";
+static int loops = 100;
+static int prefault = 1;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "1MB",
+		    "Specify length of memory to operate on "
+		    "(default: 1MB, available unit: B, KB, MB, GB)"),
+	OPT_INTEGER('i', "iterations", &loops,
+		    "Number of times to repeat the operation"),
+	OPT_INTEGER('p', "prefault", &prefault,
+		    "Fault in the buffers before measuring (default: 1)"),
+	OPT_END()
+};
+
+static const char * const bench_mem_memcpy_usage[] = {
+	"perf bench mem memcpy <options>",
+	NULL
+};
+
+static const char * const bench_mem_memset_usage[] = {
+	"perf bench mem memset <options>",
+	NULL
+};
+
+/* "4096", "16KB", "1MB", ... in bytes, or -1 */
+static long long parse_length(const char *str)
+{
+	long long len;
+	char *end;
+
+	len = strtoll(str, &end, 10);
+	if (end == str || len <= 0)
+		return -1;
+
+	if (!*end || !strcasecmp(end, "B"))
+		return len;
+	if (!strcasecmp(end, "KB"))
+		return len * K;
+	if (!strcasecmp(end, "MB"))
+		return len * K * K;
+	if (!strcasecmp(end, "GB"))
+		return len * K * K * K;
+	return -1;
+}
+
+static void *map_mem(size_t length)
+{
+	void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED)
+		die("memory allocation failed - maybe length is too large?\n");
+	return p;
+}
+
+static void alloc_mem(void **dst, void **src, size_t length)
+{
+	*dst = map_mem(length);
+
+	if (!src)
+		return;
+
+	*src = map_mem(length);
+	/* the source must be really there, not the zero page */
+	memset(*src, 0, length);
+}
+
+static void free_mem(void *p, size_t length)
+{
+	munmap(p, length);
+}
+
+static void print_result(size_t length, unsigned long long ns)
+{
+	double total = (double)length * loops;
+
+	bench_info("# %s, %d times, %s\n\n", length_str, loops,
+		   prefault ? "prefaulted" : "faulting");
+	bench_print("throughput", total / (ns / 1e9) / (K * K), "MB/sec");
+	bench_print("time-per-op", (double)ns / loops / 1e3, "usec");
+}
+
+int bench_mem_memcpy(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	unsigned long long start, ns = 0;
+	void *src, *dst;
+	long long length;
+	int i;
+
+	argc = parse_options(argc, argv, options, bench_mem_memcpy_usage, 0);
+
+	length = parse_length(length_str);
+	if (length < 0 || loops <= 0) {
+		fprintf(stderr, "Invalid length:%s or iterations:%d\n",
+			length_str, loops);
+		return 1;
+	}
+
+	if (prefault) {
+		alloc_mem(&dst, &src, length);
+		memcpy(dst, src, length);
+		start = rdclock();
+		for (i = 0; i < loops; i++)
+			memcpy(dst, src, length);
+		ns = rdclock() - start;
+		free_mem(dst, length);
+	} else {
+		alloc_mem(&dst, &src, length);
+		for (i = 0; i < loops; i++) {
+			start = rdclock();
+			memcpy(dst, src, length);
+			ns += rdclock() - start;
+			free_mem(dst, length);
+			alloc_mem(&dst, NULL, length);
+		}
+		free_mem(dst, length);
+	}
+	free_mem(src, length);
+
+	print_result(length, ns);
+	return 0;
+}
+
+int bench_mem_memset(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	unsigned long long start, ns = 0;
+	long long length;
+	void *dst;
+	int i;
+
+	argc = parse_options(argc, argv, options, bench_mem_memset_usage, 0);
+
+	length = parse_length(length_str);
+	if (length < 0 || loops <= 0) {
+		fprintf(stderr, "Invalid length:%s or iterations:%d\n",
+			length_str, loops);
+		return 1;
+	}
+
+	alloc_mem(&dst, NULL, length);
+	if (prefault)
+		memset(dst, -1, length);
+	for (i = 0; i < loops; i++) {
+		start = rdclock();
+		memset(dst, i, length);
+		ns += rdclock() - start;
+		if (!prefault) {
+			free_mem(dst, length);
+			alloc_mem(&dst, NULL, length);
+		}
+	}
+	free_mem(dst, length);
+
+	print_result(length, ns);
+	return 0;
+}
@@ -0,0 +1,465 @@
+/*
+ * net.c
+ *
+ * rps:      receive packet steering scaling, with pktgen over a veth pair
+ * fastopen: request/response latency with TCP fast open on and off
+ *
+ * pktgen, bound to CPU 0, sends UDP packets of many flows out of one
+ * end of a veth pair; the other end receives them through netif_rx(),
+ * like a single queue NIC interrupting CPU 0.  The run is repeated with
+ * RPS off and with the given mask in the receiving end's
+ * queues/rx-0/rps_cpus.  Set up the pair with, e.g.
+ *
+ *   modprobe pktgen
+ *   ip link add veth0 type veth peer name veth1
+ *   ip addr add 10.0.0.2/24 dev veth1
+ *   ip link set veth0 up && ip link set veth1 up
+ *
+ * Each run reports the rate pktgen managed to send, which is bounded by
+ * the whole receive path when it all runs on CPU 0, the packets dropped
+ * because a backlog queue was full, the RPS IPIs received, and the
+ * share of the softirq time spent on each CPU, which shows where the
+ * protocol processing went.
+ *
+ * fastopen times short request/response exchanges, each on a new
+ * connection, with net.ipv4.tcp_fastopen at 0 and at 3, client and
+ * server.  With fast open the request goes in the SYN and the response
+ * comes one round trip earlier, from the second connection on, when the
+ * client has the server's cookie.  The round trip is that of connect()
+ * without fast open; on loopback it is too short to see the difference,
+ * add a delay first, e.g.
+ *
+ *   tc qdisc add dev lo root netem delay 10ms
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifndef MSG_FASTOPEN
+#define MSG_FASTOPEN	0x20000000
+#endif
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN	23
+#endif
+
+#define PKTGEN		"/proc/net/pktgen/"
+#define MAX_CPUS	64
+
+static const char *txdev = "veth0";
+static const char *rxdev = "veth1";
+static const char *mask;
+static int count = 2000000;
+static int flows = 256;
+static const char *dst_ip = "10.0.0.2";
+static const char *src_ip = "10.0.0.1";
+
+struct cpu_stat {
+	unsigned long dropped, rps;	/* from /proc/net/softnet_stat */
+	unsigned long long softirq;	/* from /proc/stat, in ticks */
+};
+
+static int write_file(const char *path, const char *s)
+{
+	FILE *f = fopen(path, "w");
+
+	if (!f || fputs(s, f) < 0 || fclose(f)) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int pgset(const char *file, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static int pgset(const char *file, const char *fmt, ...)
+{
+	char path[128], cmd[128];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(cmd, sizeof(cmd), fmt, ap);
+	va_end(ap);
+	snprintf(path, sizeof(path), PKTGEN "%s", file);
+	return write_file(path, cmd);
+}
+
+static int read_line(const char *path, char *buf, int size)
+{
+	FILE *f = fopen(path, "r");
+
+	if (!f || !fgets(buf, size, f)) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		if (f)
+			fclose(f);
+		return -1;
+	}
+	fclose(f);
+	buf[strcspn(buf, "\n")] = 0;
+	return 0;
+}
+
+/* Returns the number of CPUs found in softnet_stat */
+static int read_stats(struct cpu_stat *st)
+{
+	unsigned long v[10];
+	char line[256];
+	int n = 0, cpu;
+	FILE *f;
+
+	memset(st, 0, MAX_CPUS * sizeof(*st));
+	f = fopen("/proc/net/softnet_stat", "r");
+	if (!f)
+		die("/proc/net/softnet_stat: %s", strerror(errno));
+	while (n < MAX_CPUS && fgets(line, sizeof(line), f)) {
+		memset(v, 0, sizeof(v));
+		sscanf(line, "%lx %lx %lx %lx %lx %lx %lx %lx %lx %lx",
+		       &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+		       &v[7], &v[8], &v[9]);
+		st[n].dropped = v[1];
+		st[n].rps = v[9];
+		n++;
+	}
+	fclose(f);
+
+	/* user nice system idle iowait irq softirq */
+	f = fopen("/proc/stat", "r");
+	if (!f)
+		die("/proc/stat: %s", strerror(errno));
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long t[7];
+
+		if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu",
+			   &cpu, &t[0], &t[1], &t[2], &t[3], &t[4], &t[5],
+			   &t[6]) == 8 && cpu >= 0 && cpu < n)
+			st[cpu].softirq = t[6];
+	}
+	fclose(f);
+	return n;
+}
+
+/* The packets per second in the device's pktgen result */
+static unsigned long pktgen_pps(void)
+{
+	char path[128], line[256];
+	unsigned long pps = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), PKTGEN "%s", txdev);
+	f = fopen(path, "r");
+	if (!f)
+		die("%s: %s", path, strerror(errno));
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, " %lupps", &pps) == 1)
+			break;
+	fclose(f);
+	return pps;
+}
+
+/* One run with @rps_cpus in the receiving end, results named @name-* */
+static int run(const char *name, const char *rps_cpus)
+{
+	struct cpu_stat before[MAX_CPUS], after[MAX_CPUS];
+	unsigned long long softirq = 0;
+	unsigned long dropped = 0, rps = 0;
+	char path[128], mac[32], metric[32];
+	int cpu, ncpus;
+
+	snprintf(path, sizeof(path),
+		 "/sys/class/net/%s/queues/rx-0/rps_cpus", rxdev);
+	if (write_file(path, rps_cpus))
+		return -1;
+	snprintf(path, sizeof(path), "/sys/class/net/%s/address", rxdev);
+	if (read_line(path, mac, sizeof(mac)))
+		return -1;
+
+	if (pgset("kpktgend_0", "rem_device_all") ||
+	    pgset("kpktgend_0", "add_device %s", txdev) ||
+	    pgset(txdev, "count %d", count) ||
+	    /* veth hands the skb itself to netif_rx(), it must not be shared */
+	    pgset(txdev, "clone_skb 0") ||
+	    pgset(txdev, "pkt_size 60") ||
+	    pgset(txdev, "delay 0") ||
+	    pgset(txdev, "src_min %s", src_ip) ||
+	    pgset(txdev, "dst %s", dst_ip) ||
+	    pgset(txdev, "dst_mac %s", mac) ||
+	    pgset(txdev, "udp_src_min 1024") ||
+	    pgset(txdev, "udp_src_max %d", 1024 + flows - 1))
+		return -1;
+
+	ncpus = read_stats(before);
+	if (pgset("pgctrl", "start"))	/* returns when done */
+		return -1;
+	read_stats(after);
+
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		dropped += after[cpu].dropped - before[cpu].dropped;
+		rps += after[cpu].rps - before[cpu].rps;
+		softirq += after[cpu].softirq - before[cpu].softirq;
+	}
+
+	snprintf(metric, sizeof(metric), "%s-sent", name);
+	bench_print(metric, pktgen_pps(), "pkts/sec");
+	snprintf(metric, sizeof(metric), "%s-dropped", name);
+	bench_print(metric, dropped, "pkts");
+	snprintf(metric, sizeof(metric), "%s-rps-ipis", name);
+	bench_print(metric, rps, "IPIs");
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		snprintf(metric, sizeof(metric), "%s-cpu%d-softirq", name, cpu);
+		bench_print(metric, softirq ? (after[cpu].softirq -
+			    before[cpu].softirq) * 100.0 / softirq : 0, "%");
+	}
+	return 0;
+}
+
+static const struct option options[] = {
+	OPT_STRING('t', "txdev", &txdev, "veth0",
+		    "Specify the device pktgen sends out of"),
+	OPT_STRING('r', "rxdev", &rxdev, "veth1",
+		    "Specify the device receiving, its peer"),
+	OPT_STRING('m', "mask", &mask, "mask",
+		    "Specify the rps_cpus mask, in hex (default: all CPUs)"),
+	OPT_INTEGER('n', "count", &count,
+		    "Specify number of packets to send in each run"),
+	OPT_INTEGER('f', "flows", &flows,
+		    "Specify number of UDP flows, by source port"),
+	OPT_STRING('s', "src", &src_ip, "10.0.0.1",
+		    "Specify the source address"),
+	OPT_STRING('d', "dst", &dst_ip, "10.0.0.2",
+		    "Specify the destination address, the receiving end's"),
+	OPT_END()
+};
+
+static const char * const bench_net_rps_usage[] = {
+	"perf bench net rps <options>",
+	NULL
+};
+
+int bench_net_rps(int argc, const char **argv, const char *prefix __used)
+{
+	static char all[32];
+	struct cpu_stat st[MAX_CPUS];
+	int ncpus;
+
+	argc = parse_options(argc, argv, options, bench_net_rps_usage, 0);
+	if (count <= 0 || flows <= 0 || flows > 65536 - 1024)
+		usage_with_options(bench_net_rps_usage, options);
+
+	if (access(PKTGEN "pgctrl", W_OK)) {
+		fprintf(stderr, "pktgen is not available, as root "
+			"'modprobe pktgen' (%s)\n", strerror(errno));
+		return 1;
+	}
+	if (!mask) {
+		ncpus = read_stats(st);
+		snprintf(all, sizeof(all), "%llx", ncpus < 64 ?
+			 (1ULL << ncpus) - 1 : ~0ULL);
+		mask = all;
+	}
+
+	bench_info("# %d packets of %d flows from %s to %s, rps_cpus %s\n\n",
+		   count, flows, txdev, rxdev, mask);
+	if (run("off", "0") || run("on", mask))
+		return 1;
+	return 0;
+}
+
+#define FASTOPEN_SYSCTL	"/proc/sys/net/ipv4/tcp_fastopen"
+
+static int fo_count = 20;
+static int fo_size = 64;
+static const char *fo_addr = "127.0.0.1";
+
+/* Answers fo_count requests of fo_size bytes, each on its connection */
+static void fastopen_server(int lfd, char *buf)
+{
+	int i, fd, len;
+	ssize_t ret;
+
+	for (i = 0; i < fo_count; i++) {
+		fd = accept(lfd, NULL, NULL);
+		if (fd < 0)
+			exit(1);
+		for (len = 0; len < fo_size; len += ret) {
+			ret = read(fd, buf + len, fo_size - len);
+			if (ret <= 0)
+				exit(1);
+		}
+		if (write(fd, buf, fo_size) != fo_size)
+			exit(1);
+		close(fd);
+	}
+	exit(0);
+}
+
+/*
+ * One request/response on a new connection to sin, with fast open or
+ * not.  Returns its time in ns; *rtt is that of connect(), without.
+ */
+static unsigned long long fastopen_request(struct sockaddr_in *sin,
+					   int fastopen, char *buf,
+					   unsigned long long *rtt)
+{
+	unsigned long long start = rdclock();
+	int fd, len;
+	ssize_t ret;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		die("socket: %s", strerror(errno));
+	if (fastopen) {
+		ret = sendto(fd, buf, fo_size, MSG_FASTOPEN,
+			     (struct sockaddr *)sin, sizeof(*sin));
+	} else {
+		if (connect(fd, (struct sockaddr *)sin, sizeof(*sin)))
+			die("connect: %s", strerror(errno));
+		*rtt = rdclock() - start;
+		ret = write(fd, buf, fo_size);
+	}
+	if (ret != fo_size)
+		die("send: %s", ret < 0 ? strerror(errno) : "short write");
+
+	for (len = 0; len < fo_size; len += ret) {
+		ret = read(fd, buf + len, fo_size - len);
+		if (ret <= 0)
+			die("read: %s", ret < 0 ? strerror(errno) : "EOF");
+	}
+	close(fd);
+	return rdclock() - start;
+}
+
+/*
+ * Mean latency in ns of the requests with net.ipv4.tcp_fastopen at
+ * @mode, leaving out the first one, which gets the cookie.  *rtt is the
+ * mean time of connect(), when fast open is off.
+ */
+static double fastopen_run(int mode, double *rtt)
+{
+	unsigned long long total = 0, total_rtt = 0, conn_rtt = 0;
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int lfd, i, status, one = 1;
+	char *buf, val[16];
+	pid_t pid;
+
+	snprintf(val, sizeof(val), "%d", mode);
+	if (write_file(FASTOPEN_SYSCTL, val))
+		return -1;
+
+	buf = calloc(1, fo_size);
+	if (!buf)
+		die("calloc");
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	if (inet_pton(AF_INET, fo_addr, &sin.sin_addr) != 1)
+		die("invalid address: %s", fo_addr);
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		die("socket: %s", strerror(errno));
+	if (setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+	    bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) ||
+	    getsockname(lfd, (struct sockaddr *)&sin, &len))
+		die("bind: %s", strerror(errno));
+	/* as many children as requests may wait for their handshake */
+	if (setsockopt(lfd, IPPROTO_TCP, TCP_FASTOPEN, &fo_count,
+		       sizeof(fo_count)))
+		die("TCP_FASTOPEN: %s", strerror(errno));
+	if (listen(lfd, fo_count))
+		die("listen: %s", strerror(errno));
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid)
+		fastopen_server(lfd, buf);
+	close(lfd);
+
+	for (i = 0; i < fo_count; i++) {
+		unsigned long long ns;
+
+		ns = fastopen_request(&sin, mode, buf, &conn_rtt);
+		if (i) {
+			total += ns;
+			total_rtt += conn_rtt;
+		}
+	}
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		die("server failed");
+
+	free(buf);
+	*rtt = (double)total_rtt / (fo_count - 1);
+	return (double)total / (fo_count - 1);
+}
+
+static const struct option fastopen_options[] = {
+	OPT_INTEGER('n', "count", &fo_count,
+		    "Specify number of requests in each run, one per connection"),
+	OPT_INTEGER('s', "size", &fo_size,
+		    "Specify size of the request and of the response in bytes"),
+	OPT_STRING('a', "addr", &fo_addr, "127.0.0.1",
+		    "Specify the local address the server listens on"),
+	OPT_END()
+};
+
+static const char * const bench_net_fastopen_usage[] = {
+	"perf bench net fastopen <options>",
+	NULL
+};
+
+int bench_net_fastopen(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	double off, on, rtt, unused;
+	char old[16];
+	int ret = 0;
+
+	argc = parse_options(argc, argv, fastopen_options,
+			     bench_net_fastopen_usage, 0);
+	/* a request must fit in the SYN */
+	if (fo_count < 2 || fo_size <= 0 || fo_size > 512)
+		usage_with_options(bench_net_fastopen_usage, fastopen_options);
+
+	if (read_line(FASTOPEN_SYSCTL, old, sizeof(old))) {
+		fprintf(stderr, "no TCP fast open in this kernel\n");
+		return 1;
+	}
+
+	bench_info("# %d requests of %d bytes to %s, each on a connection\n\n",
+		   fo_count, fo_size, fo_addr);
+	off = fastopen_run(0, &rtt);
+	on = off < 0 ? -1 : fastopen_run(3, &unused);
+	if (write_file(FASTOPEN_SYSCTL, old) || on < 0)
+		return 1;
+
+	bench_print("off-latency", off / 1e3, "usecs");
+	bench_print("on-latency", on / 1e3, "usecs");
+	bench_print("rtt", rtt / 1e3, "usecs");
+	bench_print("saved", (off - on) / 1e3, "usecs");
+
+	/* Fast open saves a round trip, half of one is a safe margin */
+	if (off - on < rtt / 2) {
+		fprintf(stderr, "fast open saved no round trip, "
+			"is there a delay on %s?\n", fo_addr);
+		ret = 1;
+	}
+	return ret;
+}
@@ -0,0 +1,301 @@
+/*
+ * pipe.c
+ *
+ * throughput: pipe throughput between two processes, at several sizes
+ * splice:     splice throughput from a file through a pipe to /dev/null
+ *
+ * splice moves page references instead of copying the data; it is
+ * measured against read() and write() through a buffer, which copies
+ * twice.  The file is read from the page cache.
+ *
+ * Both take --pipe-size to resize the pipe with F_SETPIPE_SZ, instead of
+ * the default of 16 pages.
+ */
+
+#define _GNU_SOURCE 1	/* splice() */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ	(1024 + 7)
+#define F_GETPIPE_SZ	(1024 + 8)
+#endif
+
+#define MB (1024 * 1024)
+
+static const char *sizes_str = "64,512,4096,65536";
+static int total_mb = 256;
+static int chunk = 65536;
+static int repeat = 5;
+static const char *file_path;
+static int pipe_size;
+
+static void make_pipe(int fds[2])
+{
+	if (pipe(fds))
+		die("pipe");
+	if (pipe_size && fcntl(fds[1], F_SETPIPE_SZ, pipe_size) < 0)
+		die("F_SETPIPE_SZ: %s", strerror(errno));
+}
+
+/* the size the pipes really get, rounded up by the kernel */
+static int real_pipe_size(void)
+{
+	int fds[2], size;
+
+	make_pipe(fds);
+	size = fcntl(fds[1], F_GETPIPE_SZ);
+	close(fds[0]);
+	close(fds[1]);
+	return size;
+}
+
+/* throughput */
+
+static void reader(int fd, int size)
+{
+	char *buf = malloc(size);
+	ssize_t ret;
+
+	if (!buf)
+		exit(1);
+	while ((ret = read(fd, buf, size)) > 0)
+		;
+	exit(ret < 0);
+}
+
+/* Bytes per second through a pipe in writes and reads of size */
+static double pipe_throughput(int size)
+{
+	unsigned long long total = (unsigned long long)total_mb * MB;
+	unsigned long long written = 0, start, ns;
+	int fds[2], status;
+	char *buf;
+	pid_t pid;
+
+	buf = calloc(1, size);
+	if (!buf)
+		die("calloc");
+	make_pipe(fds);
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(fds[1]);
+		reader(fds[0], size);
+	}
+	close(fds[0]);
+
+	start = rdclock();
+	while (written < total) {
+		ssize_t ret = write(fds[1], buf, size);
+
+		if (ret < 0)
+			die("write: %s", strerror(errno));
+		written += ret;
+	}
+	close(fds[1]);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		die("reader failed");
+	ns = rdclock() - start;
+
+	free(buf);
+	return written / (ns / 1e9);
+}
+
+static const struct option throughput_options[] = {
+	OPT_STRING('s', "sizes", &sizes_str, "64,512,4096,65536",
+		    "Comma separated sizes of the writes and reads in bytes"),
+	OPT_INTEGER('t', "total", &total_mb,
+		    "Specify MBs to transfer at each size"),
+	OPT_INTEGER('p', "pipe-size", &pipe_size,
+		    "Resize the pipe to this many bytes"),
+	OPT_END()
+};
+
+static const char * const bench_pipe_throughput_usage[] = {
+	"perf bench pipe throughput <options>",
+	NULL
+};
+
+int bench_pipe_throughput(int argc, const char **argv,
+			  const char *prefix __used)
+{
+	const char *p;
+	char metric[32];
+	int size;
+
+	argc = parse_options(argc, argv, throughput_options,
+			     bench_pipe_throughput_usage, 0);
+	if (total_mb <= 0)
+		usage_with_options(bench_pipe_throughput_usage,
+				   throughput_options);
+
+	bench_info("# %d MB through a pipe of %d bytes at each size\n\n",
+		   total_mb, real_pipe_size());
+	for (p = sizes_str; *p; ) {
+		char *end;
+
+		size = strtol(p, &end, 0);
+		if (end == p || size <= 0 || (*end && *end != ',')) {
+			fprintf(stderr, "Invalid sizes:%s\n", sizes_str);
+			return 1;
+		}
+		p = *end ? end + 1 : end;
+
+		snprintf(metric, sizeof(metric), "%d-bytes", size);
+		bench_print(metric, pipe_throughput(size) / MB, "MB/sec");
+	}
+	return 0;
+}
+
+/* splice */
+
+static int open_file(unsigned long long length)
+{
+	char tmp[] = "/tmp/perf-bench-pipe-XXXXXX";
+	unsigned long long done;
+	char *buf;
+	int fd;
+
+	if (file_path) {
+		fd = open(file_path, O_RDONLY);
+		if (fd < 0)
+			die("%s: %s", file_path, strerror(errno));
+		return fd;
+	}
+
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		die("mkstemp: %s", strerror(errno));
+	unlink(tmp);
+
+	buf = malloc(MB);
+	if (!buf)
+		die("malloc");
+	memset(buf, 0x5a, MB);
+	for (done = 0; done < length; done += MB)
+		if (write(fd, buf, MB) != MB)
+			die("write: %s", strerror(errno));
+	free(buf);
+	return fd;
+}
+
+/* Move the whole file to out through a pipe, or copy it via a buffer */
+static unsigned long long splice_file(int fd, int out, int use_splice)
+{
+	unsigned long long total = 0;
+	char *buf = NULL;
+	int fds[2];
+	ssize_t ret;
+
+	if (lseek(fd, 0, SEEK_SET))
+		die("lseek");
+
+	if (!use_splice) {
+		buf = malloc(chunk);
+		if (!buf)
+			die("malloc");
+		while ((ret = read(fd, buf, chunk)) > 0) {
+			if (write(out, buf, ret) != ret)
+				die("write: %s", strerror(errno));
+			total += ret;
+		}
+		if (ret < 0)
+			die("read: %s", strerror(errno));
+		free(buf);
+		return total;
+	}
+
+	make_pipe(fds);
+	while ((ret = splice(fd, NULL, fds[1], NULL, chunk,
+			     SPLICE_F_MOVE)) > 0) {
+		ssize_t left = ret;
+
+		while (left) {
+			ssize_t n = splice(fds[0], NULL, out, NULL, left,
+					   SPLICE_F_MOVE);
+
+			if (n <= 0)
+				die("splice to output: %s", strerror(errno));
+			left -= n;
+		}
+		total += ret;
+	}
+	if (ret < 0)
+		die("splice from file: %s", strerror(errno));
+	close(fds[0]);
+	close(fds[1]);
+	return total;
+}
+
+static const struct option splice_options[] = {
+	OPT_STRING('F', "file", &file_path, "file",
+		    "Read this file instead of a temporary one"),
+	OPT_INTEGER('t', "total", &total_mb,
+		    "Specify size of the temporary file in MBs"),
+	OPT_INTEGER('c', "chunk", &chunk,
+		    "Specify bytes per splice or read"),
+	OPT_INTEGER('r', "repeat", &repeat,
+		    "Specify number of times to repeat"),
+	OPT_INTEGER('p', "pipe-size", &pipe_size,
+		    "Resize the pipe to this many bytes"),
+	OPT_END()
+};
+
+static const char * const bench_pipe_splice_usage[] = {
+	"perf bench pipe splice <options>",
+	NULL
+};
+
+int bench_pipe_splice(int argc, const char **argv,
+		      const char *prefix __used)
+{
+	unsigned long long start, bytes[2] = { 0, 0 }, ns[2] = { 0, 0 };
+	int fd, out, i, use_splice;
+
+	argc = parse_options(argc, argv, splice_options,
+			     bench_pipe_splice_usage, 0);
+	if (total_mb <= 0 || chunk <= 0 || repeat <= 0)
+		usage_with_options(bench_pipe_splice_usage, splice_options);
+
+	fd = open_file((unsigned long long)total_mb * MB);
+	out = open("/dev/null", O_WRONLY);
+	if (out < 0)
+		die("/dev/null: %s", strerror(errno));
+
+	/* once to have the file in the page cache */
+	splice_file(fd, out, 0);
+
+	for (i = 0; i < repeat; i++) {
+		for (use_splice = 0; use_splice < 2; use_splice++) {
+			start = rdclock();
+			bytes[use_splice] += splice_file(fd, out, use_splice);
+			ns[use_splice] += rdclock() - start;
+		}
+	}
+	close(out);
+	close(fd);
+
+	bench_info("# %llu MB file, %d bytes at a time, %d times, "
+		   "pipe of %d bytes\n\n",
+		   bytes[0] / repeat / MB, chunk, repeat, real_pipe_size());
+	bench_print("splice", bytes[1] / (ns[1] / 1e9) / MB, "MB/sec");
+	bench_print("read-write", bytes[0] / (ns[0] / 1e9) / MB, "MB/sec");
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * unix.c
+ *
+ * dgram: AF_UNIX datagram throughput between two processes, at several
+ *        message sizes
+ *
+ * Datagrams above a page or so are where the allocation of the skb
+ * shows: the kernel builds them from order-0 pages rather than one
+ * physically contiguous buffer.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define MB (1024 * 1024)
+
+static const char *sizes_str = "4096,32768,131072";
+static int total_mb = 256;
+
+static void receiver(int fd, int size)
+{
+	char *buf = malloc(size);
+	ssize_t ret;
+
+	if (!buf)
+		exit(1);
+	/* a zero length datagram marks the end */
+	while ((ret = recv(fd, buf, size, 0)) > 0)
+		;
+	exit(ret < 0);
+}
+
+/* Bytes per second through a datagram socketpair in messages of size */
+static double dgram_throughput(int size)
+{
+	unsigned long long total = (unsigned long long)total_mb * MB;
+	unsigned long long sent = 0, start, ns;
+	int fds[2], status, bufsize = 4 * size;
+	char *buf;
+	pid_t pid;
+
+	buf = calloc(1, size);
+	if (!buf)
+		die("calloc");
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds))
+		die("socketpair: %s", strerror(errno));
+	/* the default send buffer is too small for the larger sizes */
+	if (setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufsize,
+		       sizeof(bufsize)))
+		die("SO_SNDBUF: %s", strerror(errno));
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid) {
+		close(fds[0]);
+		receiver(fds[1], size);
+	}
+	close(fds[1]);
+
+	start = rdclock();
+	while (sent < total) {
+		ssize_t ret = send(fds[0], buf, size, 0);
+
+		if (ret < 0)
+			die("send: %s", strerror(errno));
+		sent += ret;
+	}
+	if (send(fds[0], buf, 0, 0) < 0)
+		die("send: %s", strerror(errno));
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		die("receiver failed");
+	ns = rdclock() - start;
+	close(fds[0]);
+
+	free(buf);
+	return sent / (ns / 1e9);
+}
+
+static const struct option dgram_options[] = {
+	OPT_STRING('s', "sizes", &sizes_str, "4096,32768,131072",
+		    "Comma separated sizes of the datagrams in bytes"),
+	OPT_INTEGER('t', "total", &total_mb,
+		    "Specify MBs to transfer at each size"),
+	OPT_END()
+};
+
+static const char * const bench_unix_dgram_usage[] = {
+	"perf bench unix dgram <options>",
+	NULL
+};
+
+int bench_unix_dgram(int argc, const char **argv, const char *prefix __used)
+{
+	const char *p;
+	char metric[32];
+	int size;
+
+	argc = parse_options(argc, argv, dgram_options,
+			     bench_unix_dgram_usage, 0);
+	if (total_mb <= 0)
+		usage_with_options(bench_unix_dgram_usage, dgram_options);
+
+	bench_info("# %d MB through a datagram socketpair at each size\n\n",
+		   total_mb);
+	for (p = sizes_str; *p; ) {
+		char *end;
+
+		size = strtol(p, &end, 0);
+		if (end == p || size <= 0 || (*end && *end != ',')) {
+			fprintf(stderr, "Invalid sizes:%s\n", sizes_str);
+			return 1;
+		}
+		p = *end ? end + 1 : end;
+
+		snprintf(metric, sizeof(metric), "%d-bytes", size);
+		bench_print(metric, dgram_throughput(size) / MB, "MB/sec");
+	}
+	return 0;
+}
@@ -0,0 +1,338 @@
+/*
+ * builtin-bench.c
+ *
+ * General benchmarking subsystem provided by perf
+ *
+ * Available collections:
+ *
+ *  sched   ... scheduler and IPC
+ *  mem     ... memory access performance
+ *  futex   ... futex hashing, wakeup and requeue
+ *  epoll   ... epoll scalability with many file descriptors
+ *  pipe    ... pipe and splice throughput
+ *  binder  ... Android binder IPC
+ *  unix    ... AF_UNIX socket throughput
+ *  net     ... network receive scaling and TCP connection latency
+ *
+ * Every benchmark reports its results through bench_print(), so that
+ * with --format=simple the output of any of them, or of 'perf bench
+ * all', can be compared by scripts between kernels.
+ */
+
+#include "perf.h"
+#include "util/util.h"
+#include "util/parse-options.h"
+#include "builtin.h"
+#include "bench/bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+struct bench_suite {
+	const char *name;
+	const char *summary;
+	int (*fn)(int, const char **, const char *);
+};
+
+static struct bench_suite sched_suites[] = {
+	{ "messaging",
+	  "Benchmark for scheduler and IPC mechanisms",
+	  bench_sched_messaging },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite mem_suites[] = {
+	{ "memcpy",
+	  "Simple memory copy in various ways",
+	  bench_mem_memcpy },
+	{ "memset",
+	  "Simple memory set in various ways",
+	  bench_mem_memset },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite futex_suites[] = {
+	{ "hash",
+	  "Contention on the futex hash bucket locks",
+	  bench_futex_hash },
+	{ "wake",
+	  "Time to wake up the waiters of a futex",
+	  bench_futex_wake },
+	{ "requeue",
+	  "Time to requeue the waiters of a futex",
+	  bench_futex_requeue },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite epoll_suites[] = {
+	{ "wait",
+	  "Events delivered by epoll_wait() with many fds",
+	  bench_epoll_wait },
+	{ "ctl",
+	  "Cost of epoll_ctl() with many fds",
+	  bench_epoll_ctl },
+	{ "herd",
+	  "Wakeups of epoll instances watching the same fd",
+	  bench_epoll_herd },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite pipe_suites[] = {
+	{ "throughput",
+	  "Pipe throughput between two processes",
+	  bench_pipe_throughput },
+	{ "splice",
+	  "Splice throughput from a file through a pipe",
+	  bench_pipe_splice },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite binder_suites[] = {
+	{ "transaction",
+	  "Binder transaction round trip between two processes",
+	  bench_binder_transaction },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite unix_suites[] = {
+	{ "dgram",
+	  "Datagram throughput between two processes",
+	  bench_unix_dgram },
+	{ NULL, NULL, NULL }
+};
+
+static struct bench_suite net_suites[] = {
+	{ "rps",
+	  "Receive packet steering with pktgen over a veth pair",
+	  bench_net_rps },
+	{ "fastopen",
+	  "Request/response latency with TCP fast open on and off",
+	  bench_net_fastopen },
+	{ NULL, NULL, NULL }
+};
+
+struct bench_subsys {
+	const char *name;
+	const char *summary;
+	struct bench_suite *suites;
+};
+
+static struct bench_subsys subsystems[] = {
+	{ "sched",
+	  "scheduler and IPC mechanism",
+	  sched_suites },
+	{ "mem",
+	  "memory access performance",
+	  mem_suites },
+	{ "futex",
+	  "futex hashing, wakeup and requeue",
+	  futex_suites },
+	{ "epoll",
+	  "epoll scalability with many file descriptors",
+	  epoll_suites },
+	{ "pipe",
+	  "pipe and splice throughput",
+	  pipe_suites },
+	{ "binder",
+	  "Android binder IPC",
+	  binder_suites },
+	{ "unix",
+	  "AF_UNIX socket throughput",
+	  unix_suites },
+	{ "net",
+	  "network receive scaling and TCP connection latency",
+	  net_suites },
+	{ NULL, NULL, NULL }
+};
+
+static void dump_suites(int subsys_index)
+{
+	int i;
+
+	printf("# List of available suites for %s...\n\n",
+	       subsystems[subsys_index].name);
+
+	for (i = 0; subsystems[subsys_index].suites[i].name; i++)
+		printf("%14s: %s\n",
+		       subsystems[subsys_index].suites[i].name,
+		       subsystems[subsys_index].suites[i].summary);
+
+	printf("\n");
+	return;
+}
+
+static const char *bench_format_str;
+int bench_format = BENCH_FORMAT_DEFAULT;
+
+static const struct option bench_options[] = {
+	OPT_STRING('f', "format", &bench_format_str, "default",
+		    "Specify format style"),
+	OPT_END()
+};
+
+static const char * const bench_usage[] = {
+	"perf bench [<common options>] <subsystem> <suite> [<options>]",
+	"perf bench [<common options>] <subsystem> all",
+	"perf bench [<common options>] all",
+	NULL
+};
+
+static void print_usage(void)
+{
+	int i;
+
+	printf("Usage: \n");
+	for (i = 0; bench_usage[i]; i++)
+		printf("\t%s\n", bench_usage[i]);
+	printf("\n");
+
+	printf("# List of available subsystems...\n\n");
+
+	for (i = 0; subsystems[i].name; i++)
+		printf("%14s: %s\n",
+		       subsystems[i].name, subsystems[i].summary);
+	printf("\n");
+}
+
+static int bench_str2int(const char *str)
+{
+	if (!str)
+		return BENCH_FORMAT_DEFAULT;
+
+	if (!strcmp(str, BENCH_FORMAT_DEFAULT_STR))
+		return BENCH_FORMAT_DEFAULT;
+	else if (!strcmp(str, BENCH_FORMAT_SIMPLE_STR))
+		return BENCH_FORMAT_SIMPLE;
+
+	return BENCH_FORMAT_UNKNOWN;
+}
+
+/* the benchmark running, for bench_print() */
+static const char *cur_subsys, *cur_suite;
+
+void bench_print(const char *metric, double value, const char *unit)
+{
+	if (bench_format == BENCH_FORMAT_SIMPLE)
+		printf("%s %s %s %.3f %s\n", cur_subsys, cur_suite, metric,
+		       value, unit);
+	else
+		printf(" %-24s %16.3f %s\n", metric, value, unit);
+}
+
+void bench_info(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (bench_format != BENCH_FORMAT_DEFAULT)
+		return;
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+static int run_suite(struct bench_subsys *subsys, struct bench_suite *suite,
+		     int argc, const char **argv, const char *prefix)
+{
+	int ret;
+
+	cur_subsys = subsys->name;
+	cur_suite = suite->name;
+
+	bench_info("# Running %s/%s benchmark...\n", subsys->name,
+		   suite->name);
+	fflush(stdout);
+
+	ret = suite->fn(argc, argv, prefix);
+	if (ret)
+		fprintf(stderr, "# %s/%s failed\n", subsys->name, suite->name);
+
+	bench_info("\n");
+	fflush(stdout);
+	return ret;
+}
+
+/* Run all suites of a subsystem with their default options */
+static int run_all_suites(struct bench_subsys *subsys, const char *prefix)
+{
+	int i, ret = 0;
+
+	for (i = 0; subsys->suites[i].name; i++) {
+		const char *argv[] = { subsys->suites[i].name, NULL };
+
+		if (run_suite(subsys, &subsys->suites[i], 1, argv, prefix))
+			ret = 1;
+	}
+	return ret;
+}
+
+int cmd_bench(int argc, const char **argv, const char *prefix __used)
+{
+	int i, j, ret = 0;
+
+	/* the options after the subsystem name belong to the suite */
+	argc = parse_options(argc, argv, bench_options, bench_usage,
+			     PARSE_OPT_STOP_AT_NON_OPTION);
+
+	bench_format = bench_str2int(bench_format_str);
+	if (bench_format == BENCH_FORMAT_UNKNOWN) {
+		printf("Unknown format descriptor:%s\n", bench_format_str);
+		ret = 1;
+		goto end;
+	}
+
+	if (argc < 1) {
+		print_usage();
+		goto end;
+	}
+
+	if (!strcmp(argv[0], "all")) {
+		for (i = 0; subsystems[i].name; i++)
+			if (run_all_suites(&subsystems[i], prefix))
+				ret = 1;
+		goto end;
+	}
+
+	for (i = 0; subsystems[i].name; i++) {
+		if (strcmp(subsystems[i].name, argv[0]))
+			continue;
+
+		if (argc < 2) {
+			/* No suite is specified, print list of suites */
+			dump_suites(i);
+			goto end;
+		}
+
+		if (!strcmp(argv[1], "all")) {
+			ret = run_all_suites(&subsystems[i], prefix);
+			goto end;
+		}
+
+		for (j = 0; subsystems[i].suites[j].name; j++) {
+			if (strcmp(subsystems[i].suites[j].name, argv[1]))
+				continue;
+
+			ret = run_suite(&subsystems[i],
+					&subsystems[i].suites[j],
+					argc - 1, argv + 1, prefix);
+			goto end;
+		}
+
+		if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+			dump_suites(i);
+			goto end;
+		}
+
+		printf("Unknown suite:%s for %s\n", argv[1], argv[0]);
+		ret = 1;
+		goto end;
+	}
+
+	printf("Unknown subsystem:%s\n", argv[0]);
+	ret = 1;
+
+end:
+	return ret;
+}
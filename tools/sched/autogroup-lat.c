@@ -0,0 +1,327 @@
+/*
+ * autogroup-lat.c - latency of an interactive task next to a parallel build
+ *
+ * Starts a session of CPU hogs, like a "make -j" in one terminal, and a
+ * periodic task in a session of its own, like the shell or the UI in
+ * another, and measures
+ *
+ *  - the wakeup latency of the periodic task: how late it gets to run
+ *    after its timer expired, average, 99th percentile and maximum,
+ *  - the wait times the scheduler itself accounts for it, se.wait_max
+ *    and se.wait_sum / se.wait_count from /proc/<pid>/sched, which needs
+ *    CONFIG_SCHED_DEBUG and CONFIG_SCHEDSTATS,
+ *  - its group, from /proc/<pid>/autogroup.
+ *
+ * This is done with kernel.sched_autogroup_enabled at 0 and at 1, or once
+ * as the system is when the sysctl is missing or not writable.  The
+ * setting is restored afterwards.  The numbers come from a real system
+ * and vary from run to run: use a few seconds and at least twice as many
+ * hogs as CPUs, the default.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define ENABLED	"/proc/sys/kernel/sched_autogroup_enabled"
+
+static unsigned int hogs;
+static unsigned int seconds = 5;
+static unsigned int period_ms = 10;
+static unsigned int run_us = 1000;
+
+struct result {
+	unsigned int samples;
+	unsigned long long lat_sum, lat_p99, lat_max;	/* us */
+	double wait_max, wait_avg;			/* ms, < 0 if unknown */
+	char group[64];
+};
+
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int read_enabled(void)
+{
+	FILE *f = fopen(ENABLED, "r");
+	int v = -1;
+
+	if (f) {
+		if (fscanf(f, "%d", &v) != 1)
+			v = -1;
+		fclose(f);
+	}
+	return v;
+}
+
+static int write_enabled(int v)
+{
+	FILE *f = fopen(ENABLED, "w");
+
+	if (!f)
+		return -1;
+	fprintf(f, "%d\n", v);
+	return fclose(f) ? -1 : 0;
+}
+
+/* The session of CPU hogs.  Returns its process group. */
+static pid_t start_hogs(void)
+{
+	pid_t pid = fork();
+	unsigned int i;
+
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid)
+		return pid;
+
+	setsid();
+	for (i = 1; i < hogs; i++)
+		if (fork() == 0)
+			break;
+	for (;;)
+		;
+}
+
+/* Look up the scheduler's wait statistics in /proc/self/sched. */
+static void read_sched(struct result *r)
+{
+	double wait_max = -1, wait_sum = -1, wait_count = -1;
+	char line[256];
+	FILE *f;
+
+	r->wait_max = r->wait_avg = -1;
+	f = fopen("/proc/self/sched", "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f)) {
+		char *colon = strchr(line, ':');
+		double v;
+
+		if (!colon || sscanf(colon + 1, "%lf", &v) != 1)
+			continue;
+		if (!strncmp(line, "se.wait_max ", 12))
+			wait_max = v;
+		else if (!strncmp(line, "se.wait_sum ", 12))
+			wait_sum = v;
+		else if (!strncmp(line, "se.wait_count ", 14))
+			wait_count = v;
+	}
+	fclose(f);
+
+	r->wait_max = wait_max;
+	if (wait_sum >= 0 && wait_count > 0)
+		r->wait_avg = wait_sum / wait_count;
+}
+
+static void read_group(struct result *r)
+{
+	FILE *f = fopen("/proc/self/autogroup", "r");
+
+	strcpy(r->group, "-");
+	if (!f)
+		return;
+	if (fgets(r->group, sizeof(r->group), f))
+		r->group[strcspn(r->group, " \n")] = 0;
+	else
+		strcpy(r->group, "/");
+	fclose(f);
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* The periodic task, in a session of its own; reports through @fd. */
+static void probe(int fd)
+{
+	unsigned int n = seconds * 1000 / period_ms, i;
+	unsigned long long *lat, next, t;
+	struct result r;
+	FILE *f;
+
+	setsid();
+	memset(&r, 0, sizeof(r));
+	lat = calloc(n, sizeof(*lat));
+	if (!lat)
+		exit(1);
+
+	/* start the scheduler's statistics afresh */
+	f = fopen("/proc/self/sched", "w");
+	if (f) {
+		fputs("0\n", f);
+		fclose(f);
+	}
+
+	next = now_us();
+	for (i = 0; i < n; i++) {
+		struct timespec ts;
+
+		next += period_ms * 1000;
+		ts.tv_sec = next / 1000000;
+		ts.tv_nsec = next % 1000000 * 1000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &ts, NULL) == EINTR)
+			;
+		t = now_us();
+		lat[i] = t > next ? t - next : 0;
+		r.lat_sum += lat[i];
+		if (lat[i] > r.lat_max)
+			r.lat_max = lat[i];
+
+		/* a bit of work, like redrawing after input */
+		while (now_us() < t + run_us)
+			;
+		/* don't try to catch up on missed periods */
+		if (now_us() > next + period_ms * 1000)
+			next = now_us();
+	}
+
+	qsort(lat, n, sizeof(*lat), cmp_ull);
+	r.samples = n;
+	r.lat_p99 = lat[n * 99 / 100];
+	read_sched(&r);
+	read_group(&r);
+
+	if (write(fd, &r, sizeof(r)) != sizeof(r))
+		exit(1);
+	exit(0);
+}
+
+static void measure(struct result *r)
+{
+	pid_t hog, pid;
+	int fds[2];
+
+	/* don't let the children print our buffered output again */
+	fflush(stdout);
+	hog = start_hogs();
+	/* let the hogs spread over the CPUs */
+	usleep(200000);
+
+	if (pipe(fds)) {
+		perror("pipe");
+		exit(1);
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (!pid) {
+		close(fds[0]);
+		probe(fds[1]);
+	}
+	close(fds[1]);
+
+	if (read(fds[0], r, sizeof(*r)) != sizeof(*r)) {
+		fprintf(stderr, "probe failed\n");
+		r->samples = 0;
+	}
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+
+	kill(-hog, SIGKILL);
+	waitpid(hog, NULL, 0);
+}
+
+static void print(const char *mode, const struct result *r)
+{
+	printf("%-10s %-16s %8llu %8llu %8llu", mode, r->group,
+	       r->samples ? r->lat_sum / r->samples : 0, r->lat_p99,
+	       r->lat_max);
+	if (r->wait_max >= 0)
+		printf(" %10.3f", r->wait_max);
+	else
+		printf(" %10s", "-");
+	if (r->wait_avg >= 0)
+		printf(" %10.3f\n", r->wait_avg);
+	else
+		printf(" %10s\n", "-");
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: autogroup-lat [-j hogs] [-t seconds] "
+		"[-p period_ms] [-r run_us]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct result off, on;
+	int opt, old;
+
+	while ((opt = getopt(argc, argv, "j:t:p:r:")) != -1) {
+		switch (opt) {
+		case 'j':
+			hogs = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			run_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!seconds || !period_ms || run_us >= period_ms * 1000 ||
+	    seconds * 1000 / period_ms == 0)
+		usage();
+	if (!hogs) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		hogs = 2 * (cpus > 0 ? cpus : 1);
+	}
+
+	printf("%u hogs, %ums period, %uus of work per period, %us\n",
+	       hogs, period_ms, run_us, seconds);
+	printf("%-10s %-16s %8s %8s %8s %10s %10s\n", "autogroup", "group",
+	       "lat_avg", "lat_p99", "lat_max", "wait_max", "wait_avg");
+	printf("%-10s %-16s %8s %8s %8s %10s %10s\n", "", "",
+	       "us", "us", "us", "ms", "ms");
+
+	old = read_enabled();
+	if (old < 0 || write_enabled(!old)) {
+		measure(&on);
+		print(old < 0 ? "n/a" : old ? "on" : "off", &on);
+		return on.samples ? 0 : 1;
+	}
+
+	write_enabled(0);
+	measure(&off);
+	print("off", &off);
+
+	write_enabled(1);
+	measure(&on);
+	print("on", &on);
+
+	write_enabled(old);
+
+	return off.samples && on.samples ? 0 : 1;
+}
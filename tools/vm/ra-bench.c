@@ -0,0 +1,266 @@
+/*
+ * ra-bench.c - cold cache sequential read throughput of a file
+ *
+ * Reads a file from start to end with read(2), after dropping its pages
+ * from the page cache with POSIX_FADV_DONTNEED, so that every page goes
+ * through readahead: page allocation, insertion into the page cache and
+ * the read itself.  Run it on a file on a loop device backed by tmpfs,
+ * or on zram, to take the storage out of the picture, e.g.
+ *
+ *   dd if=/dev/zero of=/dev/shm/img bs=1M count=512
+ *   mkfs.ext2 -F /dev/shm/img && mount -o loop /dev/shm/img /mnt
+ *   ra-bench -s 384 /mnt/file
+ *
+ * and compare kernels.  It reports, per run and as the median,
+ *
+ *  - MB/s and the system time per MB, which is where allocation and page
+ *    cache insertion show up,
+ *  - acquisitions of the page cache tree_lock per MB, from /proc/lock_stat
+ *    when the kernel has CONFIG_LOCK_STAT; the statistics are reset, so
+ *    other activity during the run counts too.
+ *
+ * The file is created, filled with non-zero data, when it is missing or
+ * shorter than -s megabytes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define LOCK_STAT	"/proc/lock_stat"
+#define TREE_LOCK	"&mapping->tree_lock"
+#define MB		(1024 * 1024)
+
+static unsigned int size_mb = 256;
+static unsigned int runs = 5;
+static unsigned int bufsize = 128 * 1024;
+
+struct result {
+	double mbps, sys_us_per_mb, locks_per_mb;	/* < 0 if unknown */
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double sys_time(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static int lock_stat_reset(void)
+{
+	FILE *f = fopen(LOCK_STAT, "w");
+
+	if (!f)
+		return -1;
+	fputs("0\n", f);
+	return fclose(f) ? -1 : 0;
+}
+
+/*
+ * Sum the acquisitions of all tree_lock classes: name, con-bounces,
+ * contentions, waittime-min, -max, -total, acq-bounces, acquisitions.
+ */
+static double lock_stat_read(void)
+{
+	double sum = -1;
+	char line[512];
+	FILE *f;
+
+	f = fopen(LOCK_STAT, "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line + strspn(line, " ");
+		double v = 0;
+		int i;
+
+		if (strncmp(p, TREE_LOCK, strlen(TREE_LOCK)))
+			continue;
+		p = strchr(p, ':');
+		if (!p)
+			continue;
+		p++;
+		for (i = 0; i < 7; i++) {
+			char *end;
+
+			v = strtod(p, &end);
+			if (end == p)
+				break;
+			p = end;
+		}
+		if (i == 7)
+			sum = (sum < 0 ? 0 : sum) + v;
+	}
+	fclose(f);
+	return sum;
+}
+
+static void prepare(const char *path)
+{
+	unsigned long long size = (unsigned long long)size_mb * MB;
+	struct stat st;
+	char *buf;
+	int fd;
+
+	if (!stat(path, &st) && (unsigned long long)st.st_size >= size)
+		return;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	buf = malloc(MB);
+	if (!buf)
+		exit(1);
+	memset(buf, 0x5a, MB);
+	while (size) {
+		if (write(fd, buf, MB) != MB) {
+			perror("write");
+			exit(1);
+		}
+		size -= MB;
+	}
+	fsync(fd);
+	close(fd);
+	free(buf);
+}
+
+static int run(const char *path, char *buf, struct result *r)
+{
+	unsigned long long total = 0;
+	double t, s, locks;
+	ssize_t n;
+	int fd, have_locks;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	/* drop the file's pages, so that readahead reads all of them */
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	have_locks = !lock_stat_reset();
+	t = now();
+	s = sys_time();
+	while ((n = read(fd, buf, bufsize)) > 0)
+		total += n;
+	t = now() - t;
+	s = sys_time() - s;
+	locks = have_locks ? lock_stat_read() : -1;
+	close(fd);
+
+	if (n < 0 || !total) {
+		perror("read");
+		return -1;
+	}
+	r->mbps = total / t / MB;
+	r->sys_us_per_mb = s * 1e6 / ((double)total / MB);
+	r->locks_per_mb = locks < 0 ? -1 : locks / ((double)total / MB);
+	return 0;
+}
+
+static void print(const char *what, const struct result *r)
+{
+	printf("%-8s %10.1f %12.1f", what, r->mbps, r->sys_us_per_mb);
+	if (r->locks_per_mb >= 0)
+		printf(" %12.1f\n", r->locks_per_mb);
+	else
+		printf(" %12s\n", "-");
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double median(double *v, unsigned int n)
+{
+	qsort(v, n, sizeof(*v), cmp_double);
+	return v[n / 2];
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: ra-bench [-s size_mb] [-n runs] "
+		"[-b read_size_kb] file\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	double *mbps, *sys, *locks;
+	struct result r, med;
+	unsigned int i;
+	char *buf;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:b:")) != -1) {
+		switch (opt) {
+		case 's':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			runs = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			bufsize = strtoul(optarg, NULL, 0) * 1024;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || !size_mb || !runs || !bufsize)
+		usage();
+
+	prepare(argv[optind]);
+	buf = malloc(bufsize);
+	mbps = calloc(runs, sizeof(*mbps));
+	sys = calloc(runs, sizeof(*sys));
+	locks = calloc(runs, sizeof(*locks));
+	if (!buf || !mbps || !sys || !locks)
+		return 1;
+
+	printf("%-8s %10s %12s %12s\n", "run", "MB/s", "sys us/MB",
+	       "tree_lock/MB");
+	for (i = 0; i < runs; i++) {
+		char name[16];
+
+		if (run(argv[optind], buf, &r))
+			return 1;
+		snprintf(name, sizeof(name), "%u", i + 1);
+		print(name, &r);
+		mbps[i] = r.mbps;
+		sys[i] = r.sys_us_per_mb;
+		locks[i] = r.locks_per_mb;
+	}
+	med.mbps = median(mbps, runs);
+	med.sys_us_per_mb = median(sys, runs);
+	med.locks_per_mb = median(locks, runs);
+	print("median", &med);
+	return 0;
+}